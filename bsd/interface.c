@@ -22,6 +22,7 @@ static void bsd_close(iface_handle_t *handle);
 static void bsd_read_packet_zbuf(iface_handle_t *handle);
 static void bsd_read_packet_buffer(iface_handle_t *handle);
 static void bsd_set_promiscuous(iface_handle_t *handle, char *dev, bool enable);
+static void bsd_get_stat(iface_handle_t *handle, struct iface_stat *stat);
 
 static unsigned char buffers[NUM_BUFS][BUFSIZE];
 
@@ -30,6 +31,7 @@ static struct iface_operations bsd_op = {
     .close = bsd_close,
     .read_packet = bsd_read_packet_zbuf,
     .set_promiscuous = bsd_set_promiscuous,
+    .get_stat = bsd_get_stat
 };
 
 /*
@@ -58,15 +60,24 @@ iface_handle_t *iface_handle_create(unsigned char *buf, size_t len, packet_handl
     handle->buf = buf;
     handle->len = len;
     handle->on_packet = fn;
+    handle->fanout = -1;
     return handle;
 }
 
+void iface_use_xdp(iface_handle_t *handle UNUSED)
+{
+    err_quit("AF_XDP is only supported on Linux");
+}
+
 void bsd_activate(iface_handle_t *handle, char *dev, struct bpf_prog *bpf UNUSED)
 {
     struct ifreq ifr;
     struct bpf_zbuf zbuf;
     unsigned int mode, imm;
 
+    if (handle->fanout >= 0)
+        err_quit("Capturing with several workers is not supported");
+    memset(&handle->stat, 0, sizeof(handle->stat));
     if ((handle->fd = open("/dev/bpf", O_RDONLY)) < 0)
         err_sys("%s: open error", __func__);
 
@@ -121,6 +132,7 @@ void bsd_read_packet_zbuf(iface_handle_t *handle)
     struct bpf_zbuf_header *zhdr;
     unsigned char *p;
     struct bpf_hdr *hdr;
+    struct timespec t;
 
     for (int i = 0; i < NUM_BUFS; i++) {
         if (buffer_check((struct bpf_zbuf_header *) buffers[i])) {
@@ -129,7 +141,9 @@ void bsd_read_packet_zbuf(iface_handle_t *handle)
             while (p < buffers[i] + zhdr->bzh_kernel_len) {
                 hdr = (struct bpf_hdr *) p;
                 handle->buf = p + hdr->bh_hdrlen;
-                handle->on_packet(handle, handle->buf, hdr->bh_caplen, &hdr->bh_tstamp);
+                t.tv_sec = hdr->bh_tstamp.tv_sec;
+                t.tv_nsec = hdr->bh_tstamp.tv_usec * 1000;
+                handle->on_packet(handle, handle->buf, hdr->bh_caplen, hdr->bh_datalen, &t, 0);
                 p += BPF_WORDALIGN(hdr->bh_hdrlen + hdr->bh_caplen);
             }
             buffer_acknowledge((struct bpf_zbuf_header *) buffers[i]);
@@ -140,6 +154,7 @@ void bsd_read_packet_zbuf(iface_handle_t *handle)
 void bsd_read_packet_buffer(iface_handle_t *handle)
 {
     struct bpf_hdr *hdr;
+    struct timespec t;
     ssize_t n;
     unsigned char *p;
 
@@ -148,7 +163,9 @@ void bsd_read_packet_buffer(iface_handle_t *handle)
     p = handle->buf;
     while (p < handle->buf + n) {
         hdr = (struct bpf_hdr *) p;
-        handle->on_packet(handle, p + hdr->bh_hdrlen, hdr->bh_caplen, &hdr->bh_tstamp);
+        t.tv_sec = hdr->bh_tstamp.tv_sec;
+        t.tv_nsec = hdr->bh_tstamp.tv_usec * 1000;
+        handle->on_packet(handle, p + hdr->bh_hdrlen, hdr->bh_caplen, hdr->bh_datalen, &t, 0);
         p += BPF_WORDALIGN(hdr->bh_hdrlen + hdr->bh_caplen);
     }
 }
@@ -188,3 +205,15 @@ bool is_wireless(char *dev UNUSED)
 {
     return false;
 }
+
+void bsd_get_stat(iface_handle_t *handle, struct iface_stat *stat)
+{
+    struct bpf_stat bs;
+
+    /* the BPF counters are not reset when read */
+    if (ioctl(handle->fd, BIOCGSTATS, &bs) == 0) {
+        handle->stat.packets = bs.bs_recv;
+        handle->stat.drops = bs.bs_drop;
+    }
+    *stat = handle->stat;
+}
@@ -118,6 +118,21 @@ static void update_cache(struct tcp_connection_v4 *conn, bool new_conn)
     }
 }
 
+static void remove_conn(struct tcp_connection_v4 *conn)
+{
+    const hashmap_iterator *it;
+
+    if (conn->endp->src != ctx.local_addr->sin_addr.s_addr &&
+        conn->endp->dst != ctx.local_addr->sin_addr.s_addr)
+        return;
+    HASHMAP_FOREACH(data_cache, it) {
+        struct process *p = it->data;
+
+        if (p->conn)
+            list_remove(p->conn, conn, NULL);
+    }
+}
+
 void process_init(void)
 {
     data_cache = hashmap_init(SIZE, hashfnv_uint64, compare_uint);
@@ -128,6 +143,7 @@ void process_init(void)
     hashmap_set_free_key(tcp_cache, free);
     hashmap_set_free_key(string_table, free);
     tcp_analyzer_subscribe(update_cache);
+    tcp_analyzer_subscribe_remove(remove_conn);
 }
 
 void process_free(void)
@@ -137,6 +153,7 @@ void process_free(void)
     hashmap_free(string_table);
     hashmap_free(proc_conn);
     tcp_analyzer_unsubscribe(update_cache);
+    tcp_analyzer_unsubscribe_remove(remove_conn);
 }
 
 void process_load_cache(void)
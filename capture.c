@@ -0,0 +1,358 @@
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <limits.h>
+#include "capture.h"
+#include "misc.h"
+#include "error.h"
+#include "interface.h"
+#include "queue.h"
+#include "vector.h"
+#include "mempool.h"
+#include "retention.h"
+#include "store.h"
+#include "decoder/packet.h"
+#include "bpf/bpf.h"
+
+#define QUEUE_SIZE 4096
+#define READ_BUDGET 256 /* packets passed on by capture_read before returning */
+#define BACKLOG_SIZE 1024
+#define MAX_BACKLOG (64 * 1024) /* packets are dropped when the backlog is this large */
+
+struct worker {
+    pthread_t thread;
+    iface_handle_t *handle;
+    unsigned char *buf;
+    queue_t *queue;      /* decoded packets, consumed by the main thread */
+    vector_t *backlog;   /* decoded packets that did not fit in the queue */
+    int backlog_head;    /* next packet in the backlog to be queued */
+    struct bpf_prog bpf; /* cleared if the filter is run by the kernel */
+    char *device;
+    unsigned int iface;  /* index of the device in the list given to capture_init */
+    uint64_t dropped;    /* packets dropped because the backlog was full */
+};
+
+static struct worker *workers;
+static unsigned int num_workers;
+static unsigned int workers_per_device;
+static capture_handler handler;
+static bool running;
+static int notify_fd[2] = { -1, -1 }; /* wakes up the main thread */
+static int stop_fd[2] = { -1, -1 };   /* tells the workers to stop */
+static atomic_bool pending;
+static __thread struct worker *self;
+
+static bool handle_packet(iface_handle_t *handle, unsigned char *buffer,
+                          uint32_t n, uint32_t wirelen, struct timespec *t,
+                          uint32_t rxhash);
+static unsigned int merge(unsigned int budget);
+
+static void set_nonblocking(int fd)
+{
+    int flag;
+
+    if ((flag = fcntl(fd, F_GETFL, 0)) == -1)
+        err_sys("fcntl error");
+    if (fcntl(fd, F_SETFL, flag | O_NONBLOCK) == -1)
+        err_sys("fcntl error");
+}
+
+static void create_pipe(int fd[2])
+{
+    if (pipe(fd) == -1)
+        err_sys("pipe error");
+    set_nonblocking(fd[0]);
+    set_nonblocking(fd[1]);
+}
+
+static void drain_pipe(int fd)
+{
+    char buf[64];
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+void capture_init(unsigned int n, char **devices, unsigned int num_devices,
+                  capture_handler fn)
+{
+    workers_per_device = n;
+    num_workers = n * num_devices;
+    handler = fn;
+    workers = calloc(num_workers, sizeof(*workers));
+    for (unsigned int i = 0; i < num_workers; i++) {
+        workers[i].iface = i / n;
+        workers[i].device = devices[i / n];
+        workers[i].buf = malloc(SNAPLEN);
+        workers[i].handle = iface_handle_create(workers[i].buf, SNAPLEN, handle_packet);
+        workers[i].queue = queue_init(QUEUE_SIZE);
+        workers[i].backlog = vector_init(BACKLOG_SIZE);
+    }
+    create_pipe(notify_fd);
+    create_pipe(stop_fd);
+    atomic_init(&pending, false);
+}
+
+void capture_free(void)
+{
+    if (!workers)
+        return;
+    capture_stop();
+    for (unsigned int i = 0; i < num_workers; i++) {
+        free(workers[i].handle);
+        free(workers[i].buf);
+        queue_free(workers[i].queue);
+        vector_free(workers[i].backlog, NULL);
+    }
+    free(workers);
+    workers = NULL;
+    close(notify_fd[0]);
+    close(notify_fd[1]);
+    close(stop_fd[0]);
+    close(stop_fd[1]);
+}
+
+static void notify(void)
+{
+    if (!atomic_exchange(&pending, true)) {
+        if (write(notify_fd[1], "", 1) == -1 && errno != EAGAIN)
+            err_sys("write error");
+    }
+}
+
+/* Move as many packets as possible from the backlog to the queue */
+static bool flush_backlog(struct worker *w)
+{
+    int n = vector_size(w->backlog);
+
+    while (w->backlog_head < n) {
+        if (!queue_push(w->queue, vector_get(w->backlog, w->backlog_head)))
+            return false;
+        w->backlog_head++;
+    }
+    if (n > 0) {
+        vector_clear(w->backlog, NULL);
+        w->backlog_head = 0;
+    }
+    return true;
+}
+
+static inline bool has_backlog(struct worker *w)
+{
+    return w->backlog_head < vector_size(w->backlog);
+}
+
+static void *worker_run(void *arg)
+{
+    struct worker *w = arg;
+    struct pollfd fds[] = {
+        { w->handle->fd, POLLIN, 0 },
+        { stop_fd[0], POLLIN, 0 }
+    };
+    int timeout;
+
+    self = w;
+    retention_thread_init();
+    store_thread_init();
+    while (!(fds[1].revents & POLLIN)) {
+        /* retry the backlog regularly even if no new packets arrive */
+        if (w->handle->busy_poll)
+            timeout = 0;
+        else
+            timeout = has_backlog(w) ? 1 : -1;
+        if (poll(fds, 2, timeout) == -1) {
+            if (errno == EINTR)
+                continue;
+            err_sys("poll error");
+        }
+        if ((fds[0].revents & POLLIN) || w->handle->busy_poll)
+            iface_read_packet(w->handle);
+        if (has_backlog(w)) {
+            flush_backlog(w);
+            notify();
+        }
+    }
+    store_thread_exit();
+    retention_thread_exit();
+    return NULL;
+}
+
+void capture_start(struct bpf_prog *bpf)
+{
+    sigset_t set, oset;
+    int err;
+
+    if (running)
+        return;
+    for (unsigned int i = 0; i < num_workers; i++) {
+        /* a fanout group can only contain sockets bound to the same device */
+        workers[i].handle->fanout = (workers_per_device > 1) ?
+            (int) ((getpid() + workers[i].iface) & 0xffff) : -1;
+        workers[i].handle->fanout_size = workers_per_device;
+        workers[i].handle->num_handles = num_workers;
+        workers[i].handle->busy_poll = ctx.opt.busy_poll;
+        if (ctx.opt.xdp)
+            iface_use_xdp(workers[i].handle);
+        workers[i].bpf = *bpf;
+        iface_activate(workers[i].handle, workers[i].device, &workers[i].bpf);
+    }
+
+    /* signals are handled by the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_SETMASK, &set, &oset);
+    for (unsigned int i = 0; i < num_workers; i++) {
+        if ((err = pthread_create(&workers[i].thread, NULL, worker_run, &workers[i])) != 0) {
+            errno = err;
+            err_sys("pthread_create error");
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oset, NULL);
+    running = true;
+}
+
+void capture_stop(void)
+{
+    if (!running)
+        return;
+    running = false;
+    if (write(stop_fd[1], "", 1) == -1)
+        err_sys("write error");
+    for (unsigned int i = 0; i < num_workers; i++) {
+        if (!pthread_equal(workers[i].thread, pthread_self()))
+            pthread_join(workers[i].thread, NULL);
+        iface_close(workers[i].handle);
+    }
+    drain_pipe(stop_fd[0]);
+
+    /* the workers have exited, so the main thread can empty their backlogs */
+    for (;;) {
+        bool done = true;
+
+        for (unsigned int i = 0; i < num_workers; i++)
+            done &= flush_backlog(&workers[i]);
+        merge(UINT_MAX);
+        if (done)
+            break;
+    }
+    drain_pipe(notify_fd[0]);
+    atomic_store(&pending, false);
+}
+
+int capture_get_fd(void)
+{
+    return notify_fd[0];
+}
+
+static inline bool time_before(struct timespec *t1, struct timespec *t2)
+{
+    return t1->tv_sec < t2->tv_sec || (t1->tv_sec == t2->tv_sec && t1->tv_nsec < t2->tv_nsec);
+}
+
+/*
+ * Every queue is in timestamp order, so the next packet is the earliest one at
+ * the front of the queues (k-way merge). A packet that is queued while merging
+ * can be older than the packets already passed on, but as the queues are
+ * emptied often this is rare. Returns the number of packets passed on.
+ */
+static unsigned int merge(unsigned int budget)
+{
+    struct packet *p, *next;
+    struct worker *w;
+    unsigned int n = 0;
+
+    while (n < budget) {
+        next = NULL;
+        w = NULL;
+        for (unsigned int i = 0; i < num_workers; i++) {
+            if ((p = queue_front(workers[i].queue)) != NULL &&
+                (!next || time_before(&p->time, &next->time))) {
+                next = p;
+                w = &workers[i];
+            }
+        }
+        if (!next)
+            break;
+        queue_pop(w->queue);
+        handler(next);
+        n++;
+    }
+    return n;
+}
+
+void capture_read(void)
+{
+    drain_pipe(notify_fd[0]);
+
+    /* the workers will signal again on the next packet */
+    atomic_store(&pending, false);
+    if (merge(READ_BUDGET) == READ_BUDGET) {
+        /* there may be more packets, make sure the descriptor stays readable */
+        notify();
+    }
+}
+
+void capture_get_stat(struct iface_stat *stat)
+{
+    struct iface_stat s;
+
+    memset(stat, 0, sizeof(*stat));
+    for (unsigned int i = 0; i < num_workers; i++) {
+        iface_get_stat(workers[i].handle, &s);
+        stat->packets += s.packets;
+        stat->drops += s.drops;
+        stat->freeze_q += s.freeze_q;
+        stat->lost_blocks += s.lost_blocks;
+        stat->backlog_drops += __atomic_load_n(&workers[i].dropped, __ATOMIC_RELAXED);
+        stat->ring_fill += s.ring_fill;
+        stat->ring_size += s.ring_size;
+    }
+}
+
+unsigned int capture_num_workers(void)
+{
+    return num_workers;
+}
+
+static bool handle_packet(iface_handle_t *handle, unsigned char *buffer,
+                          uint32_t n, uint32_t wirelen, struct timespec *t,
+                          uint32_t rxhash)
+{
+    struct packet *p;
+
+    if (self->bpf.size > 0) {
+        if (bpf_run_filter(self->bpf, buffer, n) == 0)
+            return true;
+    }
+
+    /* a stalled main thread must not make the backlog grow without bound */
+    if (vector_size(self->backlog) - self->backlog_head >= MAX_BACKLOG && !flush_backlog(self)) {
+        __atomic_fetch_add(&self->dropped, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    retention_prepare(t);
+    store_prepare(n);
+    if (!decode_packet(handle, buffer, n, &p))
+        return false;
+    p->time.tv_sec = t->tv_sec;
+    p->time.tv_nsec = t->tv_nsec;
+    p->wirelen = wirelen;
+    p->rxhash = rxhash;
+    retention_add(p);
+    p->iface = self->iface;
+    store_commit(p);
+
+    /*
+     * Never wait for the main thread. If the queue is full the packet is kept
+     * in the backlog until there is room, so that the kernel ring is emptied
+     * at the rate the packets arrive.
+     */
+    if (!flush_backlog(self) || !queue_push(self->queue, p))
+        vector_push_back(self->backlog, p);
+    notify();
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+
+struct packet;
+struct bpf_prog;
+struct iface_stat;
+
+/*
+ * Function that is called by the main thread for every packet decoded by the
+ * capture workers.
+ */
+typedef void (*capture_handler)(struct packet *p);
+
+/*
+ * Initialize num_workers capture workers for each of the devices. The workers
+ * are not started until capture_start is called.
+ */
+void capture_init(unsigned int num_workers, char **devices, unsigned int num_devices,
+                  capture_handler fn);
+
+/* Stop the workers and free all resources */
+void capture_free(void);
+
+/*
+ * Start capturing. Every worker opens its own socket, and the packets on a
+ * device are distributed between its workers by the kernel.
+ */
+void capture_start(struct bpf_prog *bpf);
+
+/*
+ * Stop the workers. All packets that have been decoded, but not yet read, will
+ * be passed to the capture handler.
+ */
+void capture_stop(void);
+
+/*
+ * Return the file descriptor that becomes readable when the workers have
+ * decoded packets
+ */
+int capture_get_fd(void);
+
+/*
+ * Pass the decoded packets to the capture handler in the calling thread. The
+ * packets from the different workers are merged in timestamp order. At most a
+ * fixed number of packets is handled per call; if there are more the file
+ * descriptor returned by capture_get_fd stays readable.
+ */
+void capture_read(void);
+
+/* Get the capture statistics summed over all workers */
+void capture_get_stat(struct iface_stat *stat);
+
+/* Return the total number of capture workers */
+unsigned int capture_num_workers(void);
+
+#endif
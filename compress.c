@@ -0,0 +1,325 @@
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "compress.h"
+#include "lz.h"
+#include "retention.h"
+#include "decoder/packet.h"
+
+#define CHUNK_PACKETS 256
+#define CHUNK_BYTES (256 * 1024) /* a chunk is closed when its frames reach this size */
+#define CACHE_SIZE 8
+#define FRAME_GAP 16 /* frames closer than this are only separated by alignment */
+
+struct chunk {
+    uint32_t first;       /* number of the first packet */
+    uint32_t npackets;
+    size_t bytes;         /* size of the frames */
+    time_t last;          /* timestamp of the last packet */
+    uint32_t *offsets;    /* offset of every frame in the decompressed data */
+    unsigned char *data;  /* the compressed frames */
+    size_t size;          /* size of the compressed frames */
+};
+
+/* the decompressed chunks, the most recently used first */
+static struct cache_entry {
+    struct chunk *chunk;
+    unsigned char *buf;
+    size_t cap;
+} cache[CACHE_SIZE];
+
+static svector_t *packets;
+static vector_t *chunks = NULL;  /* the compressed chunks in packet number order */
+static vector_t *pending = NULL; /* closed chunks that are not old enough */
+static struct chunk *open = NULL;
+static unsigned int max_age = 0;
+static size_t total_size = 0;
+static unsigned char *scratch = NULL;
+static size_t scratch_size = 0;
+static uintptr_t page_size;
+
+static void free_chunk(void *data)
+{
+    struct chunk *c = data;
+
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        if (cache[i].chunk == c)
+            cache[i].chunk = NULL;
+    }
+    total_size -= c->size;
+    free(c->offsets);
+    free(c->data);
+    free(c);
+}
+
+void compress_init(svector_t *p, unsigned int age)
+{
+    packets = p;
+    max_age = age;
+    if (age == 0)
+        return;
+    chunks = vector_init(1024);
+    pending = vector_init(64);
+    page_size = sysconf(_SC_PAGESIZE);
+}
+
+void compress_free(void)
+{
+    if (!compress_enabled())
+        return;
+    compress_clear();
+    vector_free(chunks, NULL);
+    vector_free(pending, NULL);
+    chunks = pending = NULL;
+    for (int i = 0; i < CACHE_SIZE; i++) {
+        free(cache[i].buf);
+        cache[i].buf = NULL;
+        cache[i].cap = 0;
+    }
+    free(scratch);
+    scratch = NULL;
+    scratch_size = 0;
+}
+
+bool compress_enabled(void)
+{
+    return max_age > 0;
+}
+
+/* Return the stored packet with number 'num', or NULL if it has been removed */
+static struct packet *get_packet(uint32_t num)
+{
+    struct packet *front;
+
+    if (svector_size(packets) == 0)
+        return NULL;
+    front = svector_get(packets, 0);
+    if (num < front->num || num - front->num >= (uint32_t) svector_size(packets))
+        return NULL;
+    return svector_get(packets, num - front->num);
+}
+
+/*
+ * A packet whose decoded data points into the frame needs to be decoded again
+ * when the frame is decompressed, see get_full_packet. That is not possible if
+ * an eager protocol keeps state, so those frames are never compressed.
+ */
+static inline bool is_compressible(struct packet *p)
+{
+    return p && p->buf && p->len > 0 && !(p->frame_ref && p->eager);
+}
+
+struct frame {
+    unsigned char *start;
+    unsigned char *end;
+};
+
+static int compare_frame(const void *f1, const void *f2)
+{
+    const struct frame *a = f1;
+    const struct frame *b = f2;
+
+    return (a->start > b->start) - (a->start < b->start);
+}
+
+/*
+ * The frames are allocated from pools of their own, so frames of consecutive
+ * packets are mostly adjacent in memory. The pages that only contain frames
+ * that have been compressed can be given back to the system, while the memory
+ * itself stays allocated until the pool is deallocated.
+ */
+static size_t release_frames(struct chunk *c)
+{
+    struct frame frames[CHUNK_PACKETS];
+    size_t released = 0;
+    int n = 0;
+
+    for (uint32_t i = 0; i < c->npackets; i++) {
+        struct packet *p = get_packet(c->first + i);
+
+        if (p && p->compressed) {
+            frames[n].start = p->buf;
+            frames[n++].end = p->buf + p->len;
+        }
+    }
+    qsort(frames, n, sizeof(struct frame), compare_frame);
+    for (int i = 0; i < n;) {
+        unsigned char *start = frames[i].start;
+        unsigned char *end = frames[i].end;
+        uintptr_t first, last;
+
+        for (i++; i < n && frames[i].start >= end && frames[i].start - end < FRAME_GAP; i++)
+            end = frames[i].end;
+        first = ((uintptr_t) start + page_size - 1) & ~(page_size - 1);
+        last = (uintptr_t) end & ~(page_size - 1);
+#ifdef MADV_DONTNEED
+        if (last > first && madvise((void *) first, last - first, MADV_DONTNEED) == 0)
+            released += last - first;
+#endif
+    }
+    return released;
+}
+
+static void compress_chunk(struct chunk *c)
+{
+    struct packet *p;
+    size_t len = 0;
+    size_t compressible = 0;
+    size_t released;
+    size_t n;
+
+    if (scratch_size < 2 * c->bytes) {
+        scratch_size = 2 * c->bytes;
+        scratch = realloc(scratch, scratch_size);
+    }
+    c->offsets = malloc(c->npackets * sizeof(*c->offsets));
+    for (uint32_t i = 0; i < c->npackets; i++) {
+        c->offsets[i] = len;
+        if (is_compressible(p = get_packet(c->first + i))) {
+            memcpy(scratch + len, p->buf, p->len);
+            len += p->len;
+        }
+    }
+
+    /* not worth it unless it saves at least an eighth */
+    if ((n = lz_compress(scratch, len, scratch + len, len - len / 8)) == 0) {
+        free_chunk(c);
+        return;
+    }
+    c->data = malloc(n);
+    memcpy(c->data, scratch + len, n);
+    c->bytes = len;
+    c->size = n;
+    total_size += n;
+    for (uint32_t i = 0; i < c->npackets; i++) {
+        if (is_compressible(p = get_packet(c->first + i))) {
+            p->compressed = true;
+            compressible += p->len;
+        }
+    }
+    vector_push_back(chunks, c);
+
+    /* the memory given back is divided between the packets' retention segments */
+    if ((released = release_frames(c)) == 0)
+        return;
+    for (uint32_t i = 0; i < c->npackets; i++) {
+        if ((p = get_packet(c->first + i)) && p->compressed)
+            retention_release(p, (uint64_t) released * p->len / compressible);
+    }
+}
+
+void compress_add(struct packet *p)
+{
+    struct chunk *c;
+
+    if (!compress_enabled())
+        return;
+    if (!open) {
+        open = calloc(1, sizeof(*open));
+        open->first = p->num;
+    }
+    open->npackets++;
+    open->bytes += p->buf ? p->len : 0;
+    if (open->npackets == CHUNK_PACKETS || open->bytes >= CHUNK_BYTES) {
+        open->last = p->time.tv_sec;
+        vector_push_back(pending, open);
+        open = NULL;
+    }
+    while (vector_size(pending) > 0) {
+        c = vector_get(pending, 0);
+        if (c->last + (time_t) max_age > p->time.tv_sec)
+            break;
+        vector_erase_front(pending, 1, NULL);
+        compress_chunk(c);
+    }
+}
+
+static struct chunk *find_chunk(uint32_t num)
+{
+    int low = 0;
+    int high = vector_size(chunks) - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        struct chunk *c = vector_get(chunks, mid);
+
+        if (num < c->first)
+            high = mid - 1;
+        else if (num >= c->first + c->npackets)
+            low = mid + 1;
+        else
+            return c;
+    }
+    return NULL;
+}
+
+unsigned char *compress_frame(struct packet *p)
+{
+    struct cache_entry entry;
+    struct chunk *c;
+    int i;
+
+    if (!p->compressed || (c = find_chunk(p->num)) == NULL)
+        return p->buf;
+    for (i = 0; i < CACHE_SIZE; i++) {
+        if (cache[i].chunk == c)
+            break;
+    }
+    if (i == CACHE_SIZE) {
+        /* reuse the least recently used buffer */
+        i = CACHE_SIZE - 1;
+        entry = cache[i];
+        if (entry.cap < c->bytes) {
+            entry.cap = c->bytes;
+            entry.buf = realloc(entry.buf, entry.cap);
+        }
+        lz_decompress(c->data, c->size, entry.buf, c->bytes);
+        entry.chunk = c;
+    } else {
+        entry = cache[i];
+    }
+    memmove(cache + 1, cache, i * sizeof(entry));
+    cache[0] = entry;
+    return entry.buf + c->offsets[p->num - c->first];
+}
+
+static int count_evicted(vector_t *v, uint32_t num)
+{
+    int n = 0;
+
+    while (n < vector_size(v)) {
+        struct chunk *c = vector_get(v, n);
+
+        if (c->first + c->npackets - 1 > num)
+            break;
+        n++;
+    }
+    return n;
+}
+
+void compress_evict(uint32_t num)
+{
+    if (!compress_enabled())
+        return;
+    vector_erase_front(chunks, count_evicted(chunks, num), free_chunk);
+    vector_erase_front(pending, count_evicted(pending, num), free_chunk);
+}
+
+void compress_clear(void)
+{
+    if (!compress_enabled())
+        return;
+    vector_clear(chunks, free_chunk);
+    vector_clear(pending, free_chunk);
+    if (open) {
+        free_chunk(open);
+        open = NULL;
+    }
+}
+
+size_t compress_size(void)
+{
+    return total_size;
+}
@@ -0,0 +1,51 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "svector.h"
+
+/*
+ * Compression of the frames of old packets. The stored packets are divided
+ * into chunks of a fixed number of packets, and when all packets in a chunk are
+ * older than the threshold set by compress_init, their frames are compressed
+ * together and the memory they used is given back to the system. A compressed
+ * frame is decompressed on access into a small cache of chunks.
+ *
+ * Only the main thread may use these functions.
+ */
+
+struct packet;
+
+/*
+ * Compress the frames of the packets that are 'age' seconds older than the
+ * newest packet. 'packets' is the vector of stored packets. Compression is
+ * disabled if age is 0.
+ */
+void compress_init(svector_t *packets, unsigned int age);
+
+void compress_free(void);
+
+bool compress_enabled(void);
+
+/* Called when a packet has been stored */
+void compress_add(struct packet *p);
+
+/*
+ * Return the frame of the packet. If the frame is compressed the returned
+ * pointer is only valid until the frames of a few other chunks have been
+ * decompressed.
+ */
+unsigned char *compress_frame(struct packet *p);
+
+/* Called when the packets up to and including 'num' are removed */
+void compress_evict(uint32_t num);
+
+/* Remove all chunks */
+void compress_clear(void);
+
+/* Return the number of bytes used by the compressed frames */
+size_t compress_size(void);
+
+#endif
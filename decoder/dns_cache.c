@@ -1,29 +1,28 @@
 #include <stddef.h>
 #include "dns_cache.h"
-#include "../hashmap.h"
+#include "../hashmap_gen.h"
 #include "../signal.h"
-#include "../hash.h"
 
 #define CACHE_SIZE 1024
 
-static hashmap_t *dns_cache;
+static u32map_t *dns_cache;
 static publisher_t *dns_cache_publisher;
 
 void dns_cache_init()
 {
-    dns_cache = hashmap_init(CACHE_SIZE, hashdjb_uint32, compare_uint);
+    dns_cache = u32map_init(CACHE_SIZE);
     dns_cache_publisher = publisher_init();
 }
 
 void dns_cache_free()
 {
-    hashmap_free(dns_cache);
+    u32map_free(dns_cache);
     publisher_free(dns_cache_publisher);
 }
 
 void dns_cache_insert(uint32_t addr, char *name)
 {
-    if (dns_cache && hashmap_insert(dns_cache, UINT_TO_PTR(addr), name)) {
+    if (dns_cache && u32map_insert(dns_cache, addr, name)) {
         publish2(dns_cache_publisher, UINT_TO_PTR(addr), name);
     }
 }
@@ -31,19 +30,23 @@ void dns_cache_insert(uint32_t addr, char *name)
 void dns_cache_remove(uint32_t addr)
 {
     if (dns_cache) {
-        hashmap_remove(dns_cache, UINT_TO_PTR(addr));
+        u32map_remove(dns_cache, addr);
     }
 }
 
 char *dns_cache_get(uint32_t addr)
 {
-    return dns_cache ? (char *) hashmap_get(dns_cache, UINT_TO_PTR(addr)) : NULL;
+    void **name;
+
+    if (dns_cache && (name = u32map_get(dns_cache, addr)))
+        return *name;
+    return NULL;
 }
 
 void dns_cache_clear()
 {
     if (dns_cache) {
-        hashmap_clear(dns_cache);
+        u32map_clear(dns_cache);
     }
 }
 
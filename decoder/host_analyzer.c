@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include "host_analyzer.h"
 #include "packet.h"
@@ -8,14 +9,18 @@
 #include "packet_dns.h"
 #include "dns_cache.h"
 #include "../hash.h"
+#include "../util.h"
+#include "../vector.h"
 
 #define TBLSZ 1024
 
 static hashmap_t *local_hosts;
 static hashmap_t *remote_hosts;
 static publisher_t *host_changed_publisher;
+static vector_t *evicted; /* hosts that are removed by host_analyzer_evict */
 
 static void handle_ip4(struct packet *p);
+static void handle_dns_answer(struct packet *p);
 static void update_host(void *paddr, char *name);
 static bool local_ip4(const uint32_t addr);
 
@@ -23,6 +28,9 @@ void host_analyzer_init(void)
 {
     local_hosts = hashmap_init(TBLSZ, hashdjb_uint32, compare_uint);
     remote_hosts = hashmap_init(TBLSZ, hashdjb_uint32, compare_uint);
+    hashmap_set_free_data(local_hosts, free);
+    hashmap_set_free_data(remote_hosts, free);
+    evicted = vector_init(1024);
     host_changed_publisher = publisher_init();
     dns_cache_subscribe(update_host);
 }
@@ -31,12 +39,14 @@ void host_analyzer_free(void)
 {
     hashmap_free(local_hosts);
     hashmap_free(remote_hosts);
+    vector_free(evicted, NULL);
     publisher_free(host_changed_publisher);
     dns_cache_unsubscribe(update_host);
 }
 
 void host_analyzer_investigate(struct packet *p)
 {
+    handle_dns_answer(p);
     if (!local_hosts && !remote_hosts)
         return;
 
@@ -49,6 +59,37 @@ void host_analyzer_investigate(struct packet *p)
     }
 }
 
+/*
+ * The DNS cache is updated here and not by the decoder, since the decoder can
+ * run on several capture threads
+ */
+static void handle_dns_answer(struct packet *p)
+{
+    static const uint16_t ports[] = { DNS, MDNS, LLMNR };
+    struct packet_data *pdata = NULL;
+    struct dns_info *dns;
+    unsigned int num_records = 0;
+
+    for (unsigned int i = 0; i < ARRAY_SIZE(ports) && !pdata; i++)
+        pdata = get_packet_data(p, get_protocol_id(PORT, ports[i]));
+    if (!pdata || !(dns = pdata->data) || !dns->record)
+        return;
+    for (int i = ANCOUNT; i < 4; i++)
+        num_records += dns->section_count[i];
+    for (unsigned int i = 0; i < num_records; i++) {
+        char *name;
+
+        if (dns->record[i].type != DNS_TYPE_A || !dns->record[i].rdata.address)
+            continue;
+
+        /* the packet, and the name, can be removed before the cache entry */
+        name = dns_cache_get(dns->record[i].rdata.address);
+        if (!name || strcmp(name, dns->record[i].name) != 0)
+            dns_cache_insert(dns->record[i].rdata.address,
+                             mempool_copy0(dns->record[i].name, strlen(dns->record[i].name)));
+    }
+}
+
 hashmap_t *host_analyzer_get_local(void)
 {
     return local_hosts;
@@ -75,6 +116,29 @@ void host_analyzer_clear(void)
     hashmap_clear(remote_hosts);
 }
 
+static void evict_hosts(hashmap_t *map, uint32_t num)
+{
+    const hashmap_iterator *it;
+
+    HASHMAP_FOREACH(map, it) {
+        if (((struct host_info *) it->data)->last_num <= num)
+            vector_push_back(evicted, it->key);
+    }
+
+    /* the map cannot be changed while it is iterated */
+    for (int i = 0; i < vector_size(evicted); i++)
+        hashmap_remove(map, vector_get(evicted, i));
+    vector_clear(evicted, NULL);
+}
+
+void host_analyzer_evict(uint32_t num)
+{
+    if (!local_hosts)
+        return;
+    evict_hosts(local_hosts, num);
+    evict_hosts(remote_hosts, num);
+}
+
 struct host_info *host_get_ip4host(uint32_t addr)
 {
     if (local_ip4(addr))
@@ -113,8 +177,9 @@ static bool local_ip4(const uint32_t addr)
     return false;
 }
 
-static void insert_host(uint32_t addr, const uint8_t *mac)
+static void insert_host(uint32_t addr, const uint8_t *mac, uint32_t num)
 {
+    struct host_info *host;
     hashmap_t *map;
     bool local;
 
@@ -125,11 +190,14 @@ static void insert_host(uint32_t addr, const uint8_t *mac)
         map = remote_hosts;
         local = false;
     }
-    if (!hashmap_contains(map, UINT_TO_PTR(addr))) {
-        struct host_info *host = mempool_alloc(sizeof(struct host_info));
+    if ((host = hashmap_get(map, UINT_TO_PTR(addr)))) {
+        host->last_num = num;
+    } else {
         char *name;
 
+        host = malloc(sizeof(struct host_info));
         host->ip4_addr = addr;
+        host->last_num = num;
         host->local = local;
         if ((name = dns_cache_get(host->ip4_addr))) {
             host->name = name;
@@ -159,7 +227,7 @@ static void update_host(void *paddr, char *name)
 static void handle_ip4(struct packet *p)
 {
     if (!filter_address(ipv4_src(p)))
-        insert_host(ipv4_src(p), eth_src(p));
+        insert_host(ipv4_src(p), eth_src(p), p->num);
     if (!filter_address(ipv4_dst(p)))
-        insert_host(ipv4_dst(p), eth_dst(p));
+        insert_host(ipv4_dst(p), eth_dst(p), p->num);
 }
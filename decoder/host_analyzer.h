@@ -13,6 +13,7 @@ struct host_info {
     char *name;
     char *os;
     bool local;
+    uint32_t last_num; /* number of the last packet to or from the host */
 };
 
 struct packet;
@@ -31,6 +32,9 @@ hashmap_t *host_analyzer_get_remote(void);
 void host_analyzer_subscribe(analyzer_host_fn fn);
 void host_analyzer_unsubscribe(analyzer_host_fn fn);
 void host_analyzer_clear(void);
+
+/* Remove the hosts that have not been seen after packet number num */
+void host_analyzer_evict(uint32_t num);
 struct host_info *host_get_ip4host(uint32_t addr);
 
 #endif
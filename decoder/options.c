@@ -0,0 +1,105 @@
+#include <string.h>
+#include "packet_tcp.h"
+#include "packet_dns.h"
+
+/*
+ * Parsers for the TCP options and the options in DNS OPT records. They are used
+ * by the UI whenever a packet is shown, so they only read the packet data and
+ * do not allocate anything.
+ */
+
+#define get_uint16be(p) ((p)[0] << 8 | (p)[1])
+#define get_uint32be(p) ((uint32_t) (p)[0] << 24 | (p)[1] << 16 | (p)[2] << 8 | (p)[3])
+
+void tcp_options_begin(struct tcp_option_iterator *it, unsigned char *options, int len)
+{
+    it->p = options;
+    it->len = options ? len : 0;
+}
+
+bool tcp_options_next(struct tcp_option_iterator *it, struct tcp_options *opt)
+{
+    unsigned char *p = it->p;
+
+    if (it->len <= 0)
+        return false;
+    memset(opt, 0, sizeof(*opt));
+    opt->option_kind = p[0];
+    switch (opt->option_kind) {
+    case TCP_OPT_END:
+        return false;
+    case TCP_OPT_NOP:
+        opt->option_length = 1; /* NOP only contains the kind byte */
+        it->p++;
+        it->len--;
+        return true;
+    default:
+        break;
+    }
+
+    /* the other options are based on a tag-length-value encoding scheme */
+    if (it->len < 2)
+        return false;
+    opt->option_length = p[1]; /* length of value + 1 byte tag and 1 byte length */
+    if (opt->option_length < 2 || opt->option_length > it->len)
+        return false;
+    p += 2;
+    switch (opt->option_kind) {
+    case TCP_OPT_MSS:
+        if (opt->option_length == 4)
+            opt->mss = get_uint16be(p);
+        break;
+    case TCP_OPT_WIN_SCALE:
+        if (opt->option_length == 3)
+            opt->win_scale = *p;
+        break;
+    case TCP_OPT_SAP:
+        opt->sack_permitted = true;
+        break;
+    case TCP_OPT_SACK:
+        opt->sack.num_blocks = (opt->option_length - 2) / 8;
+        if (opt->sack.num_blocks > TCP_MAX_SACK_BLOCKS)
+            opt->sack.num_blocks = TCP_MAX_SACK_BLOCKS;
+        for (int i = 0; i < opt->sack.num_blocks; i++) {
+            opt->sack.blocks[i].left_edge = get_uint32be(p);
+            opt->sack.blocks[i].right_edge = get_uint32be(p + 4);
+            p += 8; /* each block is 8 bytes */
+        }
+        break;
+    case TCP_OPT_TIMESTAMP:
+        if (opt->option_length == 10) {
+            opt->ts.ts_val = get_uint32be(p);
+            opt->ts.ts_ecr = get_uint32be(p + 4);
+        }
+        break;
+    case TCP_OPT_TFO:
+        if (opt->option_length > 2 && opt->option_length <= 18)
+            opt->cookie = p;
+        break;
+    default:
+        break;
+    }
+    it->p += opt->option_length;
+    it->len -= opt->option_length;
+    return true;
+}
+
+void dns_options_begin(struct dns_option_iterator *it, struct dns_resource_record *rr)
+{
+    it->p = rr->rdata.opt.data;
+    it->len = it->p ? rr->rdata.opt.rdlen : 0;
+}
+
+bool dns_options_next(struct dns_option_iterator *it, struct dns_opt_rr *opt)
+{
+    if (it->len < 4)
+        return false;
+    opt->option_code = get_uint16be(it->p);
+    opt->option_length = get_uint16be(it->p + 2);
+    if (opt->option_length > it->len - 4)
+        return false;
+    opt->data = it->p + 4;
+    it->p += 4 + opt->option_length;
+    it->len -= 4 + opt->option_length;
+    return true;
+}
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 #include <sys/uio.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <arpa/inet.h>
@@ -13,8 +14,13 @@
 #include "tcp_analyzer.h"
 #include "host_analyzer.h"
 #include "dns_cache.h"
+#include "packet_smtp.h"
 #include "register.h"
 #include "../hash.h"
+#include "../hashmap_gen.h"
+#include "../store.h"
+#include "../compress.h"
+#include "summary.h"
 
 allocator_t d_alloc = {
     .alloc = mempool_alloc,
@@ -24,34 +30,52 @@ allocator_t d_alloc = {
 uint32_t total_packets;
 uint64_t total_bytes;
 static hashmap_t *info;
-static hashmap_t *protocols;
+static u32map_t *protocols;
+static u32map_t *slice_rules; /* payload kept per protocol id */
+static struct slice_policy slicing = {
+    .snaplen = UINT32_MAX,
+    .headers = false,
+    .payload = SLICE_ALL
+};
+static bool lazy = false;
+__thread bool protocol_stat_enabled = true;
+
+static void clear_full_cache(void);
 
 void decoder_init(void)
 {
     info = hashmap_init(64, hashdjb_string, compare_string);
-    protocols = hashmap_init(64, hashdjb_uint16, compare_uint);
+    protocols = u32map_init(64);
+    slice_rules = u32map_init(16);
     for (unsigned int i = 0; i < ARRAY_SIZE(decoder_functions); i++) {
         decoder_functions[i]();
     }
+    summary_init();
 }
 
 void decoder_exit(void)
 {
-    hashmap_free(protocols);
+    clear_full_cache();
+    smtp_free_sessions();
+    summary_free();
+    u32map_free(slice_rules);
+    u32map_free(protocols);
     hashmap_free(info);
 }
 
 void register_protocol(struct protocol_info *pinfo, uint16_t layer, uint16_t key)
 {
     if (pinfo) {
-        hashmap_insert(protocols, UINT_TO_PTR(get_protocol_id(layer, key)), pinfo);
+        u32map_insert(protocols, get_protocol_id(layer, key), pinfo);
         hashmap_insert(info, pinfo->short_name, pinfo);
     }
 }
 
 struct protocol_info *get_protocol(uint32_t id)
 {
-    return hashmap_get(protocols, UINT_TO_PTR(id));
+    void **pinfo = u32map_get(protocols, id);
+
+    return pinfo ? *pinfo : NULL;
 }
 
 void traverse_protocols(protocol_handler fn, void *arg)
@@ -65,28 +89,243 @@ void traverse_protocols(protocol_handler fn, void *arg)
     }
 }
 
+void set_slice_policy(struct slice_policy *policy)
+{
+    slicing = *policy;
+}
+
+bool slice_protocol(char *name, uint32_t payload)
+{
+    struct u32map_slot *slot;
+    struct protocol_info *pinfo;
+    bool found = false;
+
+    /* the same protocol can be registered on several ports */
+    HASHMAP_GEN_FOREACH(u32map, protocols, slot) {
+        pinfo = slot->value;
+        if (strcasecmp(pinfo->short_name, name) == 0) {
+            u32map_insert(slice_rules, slot->key, UINT_TO_PTR(payload));
+            found = true;
+        }
+    }
+    return found;
+}
+
+/* Return the payload kept after the transport header for the application protocol */
+static uint32_t slice_payload(uint32_t id)
+{
+    void **payload;
+
+    if ((payload = u32map_get(slice_rules, id)))
+        return PTR_TO_UINT(*payload);
+    return slicing.payload;
+}
+
+static inline uint32_t slice_end(uint32_t offset, uint32_t payload)
+{
+    return (payload > UINT32_MAX - offset) ? UINT32_MAX : offset + payload;
+}
+
+/* Return the number of bytes of the decoded frame kept by the slicing policy */
+static uint32_t slice_length(struct packet *p, uint32_t len)
+{
+    struct packet_data *pdata = p->root;
+    uint32_t offset = 0;
+
+    len = MIN(len, slicing.snaplen);
+    if (!slicing.headers)
+        return len;
+    while (pdata) {
+        offset += pdata->len;
+        if (get_protocol_key(pdata->id) == IPPROTO_TCP ||
+            get_protocol_key(pdata->id) == IPPROTO_UDP) {
+            uint32_t payload = pdata->next ? slice_payload(pdata->next->id) : slicing.payload;
+
+            return MIN(len, slice_end(offset, payload));
+        }
+        pdata = pdata->next;
+    }
+    return len;
+}
+
+/* the frame being decoded and where it will be stored if the packet is kept */
+static __thread unsigned char *frame;
+static __thread unsigned char *frame_copy;
+static __thread uint32_t frame_limit; /* the bytes of the frame that will be kept */
+static __thread bool spooled;         /* the frame is stored in the spool file */
+static __thread uint32_t skipped;     /* the application protocol not decoded if lazy */
+static __thread bool referenced;      /* frame_ptr has returned a pointer into the frame */
+static __thread bool eager;           /* an eager application protocol has been decoded */
+
+static unsigned char *frame_reserve(size_t len)
+{
+    unsigned char *buf;
+
+    if ((buf = store_frame_reserve(len)) != NULL) {
+        spooled = true;
+        return buf;
+    }
+    spooled = false;
+    return mempool_frame_reserve(len);
+}
+
+static unsigned char *frame_finish(size_t len)
+{
+    return spooled ? store_frame_finish(len) : mempool_frame_finish(len);
+}
+
 bool decode_packet(iface_handle_t *h, unsigned char *buffer, size_t len, struct packet **p)
 {
     struct protocol_info *pinfo;
 
+    /*
+     * The frame is decoded where it is, e.g. in the capture ring buffer, and
+     * only copied to the space reserved here if the packet is kept. The space
+     * not needed by the slicing policy is given back after decoding.
+     */
     *p = mempool_alloc(sizeof(struct packet));
-    (*p)->buf = mempool_copy(buffer, len); /* store the original frame in buf */
     (*p)->len = len;
+    (*p)->wirelen = len;
+    (*p)->iface = 0;
+    (*p)->rxhash = 0;
+    (*p)->seg = NULL;
+    (*p)->partial = false;
+    (*p)->compressed = false;
     (*p)->root = mempool_calloc(struct packet_data);
     (*p)->root->id = get_protocol_id(DATALINK, h->linktype);
-    if ((pinfo = get_protocol((*p)->root->id)) == NULL)
+    if ((pinfo = get_protocol((*p)->root->id)) == NULL) {
+        free_packets(*p);
         return false;
-    if (((*p)->perr = pinfo->decode(pinfo, (*p)->buf, len, (*p)->root)) == DATALINK_ERR) {
+    }
+    frame = buffer;
+    frame_copy = frame_reserve(len);
+    frame_limit = MIN(len, slicing.snaplen);
+    skipped = 0;
+    referenced = false;
+    eager = false;
+    (*p)->perr = pinfo->decode(pinfo, buffer, len, (*p)->root);
+    (*p)->partial = skipped != 0;
+    (*p)->frame_ref = referenced;
+    (*p)->eager = eager;
+    (*p)->spooled = spooled;
+    frame = NULL;
+    if ((*p)->perr == DATALINK_ERR) {
+        frame_finish(0);
         free_packets(*p);
         return false;
     }
-    (*p)->num = ++total_packets;
-    total_bytes += len;
+    (*p)->len = slice_length(*p, len);
+    memcpy(frame_copy, buffer, (*p)->len);
+    (*p)->buf = frame_finish((*p)->len);
+    frame_copy = NULL;
     return true;
 }
 
+unsigned char *frame_ptr(unsigned char *ptr, unsigned int len)
+{
+    if (!frame)
+        return ptr;
+    if (ptr - frame + len > frame_limit)
+        return NULL;
+    referenced = true;
+    return frame_copy + (ptr - frame);
+}
+
+void count_packet(struct packet *p)
+{
+    p->num = ++total_packets;
+    total_bytes += p->wirelen;
+    summary_add(p);
+}
+
+void set_lazy_decoding(bool enable)
+{
+    lazy = enable;
+}
+
+#define FULL_CACHE_SIZE 128 /* needs to be larger than the number of lines on screen */
+
+/* The packets decoded by get_full_packet, the most recently used first */
+static struct full_packet {
+    struct packet *orig;
+    uint32_t num;
+    bool compressed; /* the frame of orig was compressed when it was decoded */
+    struct packet *p;
+    mempool_ctx_t *mempool;
+} full_cache[FULL_CACHE_SIZE];
+static unsigned int full_cache_size = 0;
+
+static void clear_full_cache(void)
+{
+    for (unsigned int i = 0; i < full_cache_size; i++)
+        mempool_ctx_free(full_cache[i].mempool);
+    full_cache_size = 0;
+}
+
+/*
+ * The frame is decoded where it is stored, so frame_ptr does not need to
+ * translate the pointers. A compressed frame is copied, and the packet is
+ * decoded again if the decoded data points into the frame. The protocol
+ * statistics were updated when the packet was stored.
+ */
+static struct packet *decode_again(struct packet *p)
+{
+    struct protocol_info *pinfo = get_protocol(p->root->id);
+    struct packet *full;
+
+    full = mempool_alloc(sizeof(struct packet));
+    *full = *p;
+    if (p->compressed) {
+        full->buf = mempool_copy(compress_frame(p), p->len);
+        full->compressed = false;
+    }
+    if (!p->partial && !(p->compressed && p->frame_ref))
+        return full;
+    full->partial = false;
+    full->root = mempool_calloc(struct packet_data);
+    full->root->id = p->root->id;
+    protocol_stat_enabled = false;
+    full->perr = pinfo->decode(pinfo, full->buf, full->len, full->root);
+    protocol_stat_enabled = true;
+    return full;
+}
+
+struct packet *get_full_packet(struct packet *p)
+{
+    struct full_packet entry;
+    mempool_ctx_t *prev;
+    unsigned int i;
+
+    if (!p->partial && !p->compressed)
+        return p;
+    for (i = 0; i < full_cache_size; i++) {
+        if (full_cache[i].orig == p && full_cache[i].num == p->num &&
+            full_cache[i].compressed == p->compressed)
+            break;
+    }
+    if (i == full_cache_size) {
+        if (full_cache_size == FULL_CACHE_SIZE)
+            mempool_ctx_free(full_cache[--full_cache_size].mempool);
+        i = full_cache_size++;
+        entry.orig = p;
+        entry.num = p->num;
+        entry.compressed = p->compressed;
+        entry.mempool = mempool_ctx_create();
+        prev = mempool_ctx_set(entry.mempool);
+        entry.p = decode_again(p);
+        mempool_ctx_set(prev);
+    } else {
+        entry = full_cache[i];
+    }
+    memmove(full_cache + 1, full_cache, i * sizeof(entry));
+    full_cache[0] = entry;
+    return entry.p;
+}
+
 void free_packets(void *data)
 {
+    if (!data)
+        clear_full_cache();
     mempool_free(data);
 }
 
@@ -98,15 +337,44 @@ packet_error call_data_decoder(uint32_t id, struct packet_data *p, uint8_t trans
     struct packet_data *pdata;
 
     if ((pinfo = get_protocol(id))) {
+        /*
+         * The application layer is decoded when the packet is looked at. The
+         * protocol is skipped as if it were unknown, so that an eager protocol
+         * on the other port is still decoded.
+         */
+        if (frame && lazy && get_protocol_layer(id) == PORT && !pinfo->eager) {
+            if (!skipped)
+                skipped = id;
+            return UNK_PROTOCOL;
+        }
+        if (frame && pinfo->eager)
+            eager = true;
         pdata = mempool_alloc(sizeof(struct packet_data));
         memset(pdata, 0, sizeof(struct packet_data));
         pdata->transport = transport;
         pdata->id = id;
         pdata->prev = p;
         p->next = pdata;
+
+        /* the payload kept by the slicing policy depends on the application protocol */
+        if (frame && slicing.headers && get_protocol_layer(id) == PORT) {
+            uint32_t limit = frame_limit;
+
+            frame_limit = MIN(limit, slice_end(buf - frame, slice_payload(id)));
+            if ((err = pinfo->decode(pinfo, buf, n, pdata)) != NO_ERR) {
+                frame_limit = limit;
+                mempool_free(pdata);
+                p->next = NULL;
+            }
+            return err;
+        }
         if ((err = pinfo->decode(pinfo, buf, n, pdata)) != NO_ERR) {
             mempool_free(pdata);
             p->next = NULL;
+
+            /* a full decode would use the skipped protocol on the first port */
+            if (skipped && get_protocol_layer(id) == PORT)
+                err = UNK_PROTOCOL;
         }
     }
     return err;
@@ -120,7 +388,7 @@ unsigned char *get_adu_payload(struct packet *p)
     while (pdata) {
         if (get_protocol_key(pdata->id) == IPPROTO_TCP ||
             get_protocol_key(pdata->id) == IPPROTO_UDP)
-            return p->buf + i + pdata->len;
+            return compress_frame(p) + i + pdata->len;
         i += pdata->len;
         pdata = pdata->next;
     }
@@ -152,10 +420,12 @@ void clear_statistics(void)
 {
     total_bytes = 0;
     total_packets = 0;
+    summary_clear();
     traverse_protocols(clear_packet, NULL);
     tcp_analyzer_clear();
     host_analyzer_clear();
     dns_cache_clear();
+    smtp_clear_sessions();
 }
 
 bool is_tcp(struct packet *p)
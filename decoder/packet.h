@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <time.h>
 #include "../list.h"
 #include "packet_ethernet.h"
 #include "../mempool.h"
@@ -76,19 +77,41 @@ struct protocol_info {
                            struct packet_data *p);
     void (*print_pdu)(char *buf, int n, void *data);
     void (*add_pdu)(void *w, void *sw, void *data);
+    bool eager; /* needed by the analyzers or keeps state, so never decoded lazily */
 };
 
 typedef void (*protocol_handler)(struct protocol_info *pinfo, void *arg);
 
+/* cleared while a packet is decoded again, see get_full_packet */
+extern __thread bool protocol_stat_enabled;
+
+/* Update the protocol statistics. Decoders may run concurrently on several threads */
+static inline void update_protocol_stat(struct protocol_info *pinfo, unsigned int n)
+{
+    if (!protocol_stat_enabled)
+        return;
+    __atomic_fetch_add(&pinfo->num_packets, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pinfo->num_bytes, n, __ATOMIC_RELAXED);
+}
+
 /*
  * Generic packet structure that can be used for every type of packet.
  */
 struct packet {
     uint32_t num;
     packet_error perr;
-    struct timeval time;
-    unsigned char *buf; /* contains the frame as seen on the network */
-    unsigned int len;
+    struct timespec time;
+    unsigned char *buf; /* contains the frame, or the start of it if sliced */
+    unsigned int len;     /* number of bytes stored in buf */
+    unsigned int wirelen; /* length of the frame on the network */
+    uint16_t iface;       /* index of the interface the frame was captured on */
+    uint32_t rxhash;      /* flow hash computed by the kernel, 0 if not available */
+    struct retention_segment *seg; /* where the packet is stored, see retention.h */
+    bool partial;         /* not all layers are decoded, see get_full_packet */
+    bool compressed;      /* the frame is compressed, see compress.h */
+    bool frame_ref;       /* the decoded data points into the frame, see frame_ptr */
+    bool eager;           /* decoded by an eager protocol, see protocol_info */
+    bool spooled;         /* the frame is stored in the spool file, see store.h */
     struct packet_data *root;
 };
 
@@ -101,6 +124,21 @@ struct packet_data {
     struct packet_data *next;
 };
 
+/* Payload length that keeps the whole payload when slicing */
+#define SLICE_ALL UINT32_MAX
+
+/*
+ * Capture-time slicing policy. Only the start of a frame is stored with the
+ * packet: at most snaplen bytes, and if headers is set, the headers up to and
+ * including the transport layer followed by 'payload' bytes of the payload.
+ * The payload kept can be set per application protocol with slice_protocol.
+ */
+struct slice_policy {
+    uint32_t snaplen;
+    bool headers;
+    uint32_t payload;
+};
+
 /* TODO: move this */
 void decoder_init(void);
 void decoder_exit(void);
@@ -108,22 +146,64 @@ void register_protocol(struct protocol_info *pinfo, uint16_t layer, uint16_t key
 struct protocol_info *get_protocol(uint32_t id);
 void traverse_protocols(protocol_handler fn, void *arg);
 
+/* Set the slicing policy. By default the whole frame is stored */
+void set_slice_policy(struct slice_policy *policy);
+
+/*
+ * Set the number of payload bytes kept for the application protocol with the
+ * given short name, e.g. SLICE_ALL for DNS and 0 for TLS. Only used if the
+ * policy keeps the headers. Returns false if the protocol is unknown.
+ */
+bool slice_protocol(char *name, uint32_t payload);
+
+/*
+ * If lazy decoding is enabled, only the protocols up to the transport layer,
+ * and the application protocols that are marked as eager, are decoded when a
+ * packet is stored. The statistics of the other application protocols are then
+ * not updated. Cannot be combined with a slicing policy, since the whole frame
+ * is needed to decode the packet again.
+ */
+void set_lazy_decoding(bool enable);
+
+/*
+ * Return the packet with all protocol layers decoded and its frame in buf. A
+ * packet that was stored with lazy decoding, whose decoded data has been
+ * deallocated (see store.h), or whose frame is compressed, is decoded again
+ * into a small cache of recently used packets, and the returned packet is only
+ * valid until the cache is updated, i.e. it should not be kept.
+ * Must be called by the main thread.
+ */
+struct packet *get_full_packet(struct packet *p);
+
 /*
  * Decodes the data in buffer and stores it in struct packet, which has to be
- * freed by calling free_packets.
+ * freed by calling free_packets. The packet is not numbered until it is passed
+ * to count_packet. The frame is stored according to the slicing policy, in the
+ * spool file if the calling thread uses one (see store.h), and wirelen is set
+ * to n.
  *
  * Returns true if decoding succeeded, else false.
  */
 bool decode_packet(iface_handle_t *handle, unsigned char *buffer, size_t n,
                    struct packet **p);
 
+/*
+ * Assigns the packet number and adds the packet to the totals and the packet
+ * summary. Needs to be called in the order the packets are stored, after the
+ * timestamp and wirelen have been set.
+ */
+void count_packet(struct packet *p);
+
 /*
  * Frees data and everything allocated more recently than data. To free the
  * whole pool, i.e. all the packets, use NULL as argument.
  */
 void free_packets(void *data);
 
-/* Return a pointer to the application payload */
+/*
+ * Return a pointer to the application payload. If the frame is compressed the
+ * pointer is only valid for a short while, see compress_frame.
+ */
 unsigned char *get_adu_payload(struct packet *p);
 
 /* Return the application payload length */
@@ -140,6 +220,15 @@ struct packet_data *get_packet_data(const struct packet *p, uint32_t id);
 packet_error call_data_decoder(uint32_t id, struct packet_data *pdata,
                                uint8_t transport, unsigned char *buf, int n);
 
+/*
+ * The frame is decoded in the capture buffer, which is only valid during
+ * decoding. A pointer to 'len' bytes of the frame that is stored in the decoded
+ * data needs to be translated with frame_ptr to point into the frame kept with
+ * the packet. Returns NULL if the data is sliced off. The returned pointer must
+ * not be dereferenced before decoding is finished.
+ */
+unsigned char *frame_ptr(unsigned char *ptr, unsigned int len);
+
 static inline uint32_t get_protocol_id(uint16_t layer, uint16_t key)
 {
     return (layer << 16) | key;
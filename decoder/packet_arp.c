@@ -59,8 +59,7 @@ packet_error handle_arp(struct protocol_info *pinfo, unsigned char *buffer, int
     struct ether_arp *arp_header;
     struct arp_info *arp;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     arp_header = (struct ether_arp *) buffer;
     arp = mempool_alloc(sizeof(struct arp_info));
     memcpy(arp->sip, arp_header->arp_spa, 4); /* sender protocol address */
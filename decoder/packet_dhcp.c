@@ -150,8 +150,7 @@ packet_error handle_dhcp(struct protocol_info *pinfo, unsigned char *buffer, int
     ptr += 128;
     len -= DHCP_FIXED_SIZE;
     if ((err = parse_dhcp_options(ptr, len, dhcp)) == NO_ERR) {
-        pinfo->num_packets++;
-        pinfo->num_bytes += n;
+        update_protocol_stat(pinfo, n);
     }
     return err;
 }
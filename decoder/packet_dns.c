@@ -5,7 +5,6 @@
 #include "packet_dns.h"
 #include "packet.h"
 #include "../util.h"
-#include "dns_cache.h"
 
 #define DNS_PTR_LEN 2
 
@@ -33,7 +32,6 @@ static int parse_dns_record(int i, unsigned char *buffer, int n, unsigned char *
 static int parse_dns_question(unsigned char *buffer, int n, unsigned char **data,
                               int dlen, struct dns_info *dns);
 static uint8_t parse_dns_txt(unsigned char **data, unsigned int dlen, char **txt);
-static void free_opt_rr(void *data);
 static bool parse_type_bitmaps(unsigned char **data, uint16_t rdlen,
                                struct dns_resource_record *record);
 
@@ -42,7 +40,8 @@ static struct protocol_info dns_prot = {
     .long_name = "Domain Name System",
     .decode = handle_dns,
     .print_pdu = print_dns,
-    .add_pdu = add_dns_information
+    .add_pdu = add_dns_information,
+    .eager = true /* the answers are used by the host analyzer */
 };
 
 static struct protocol_info mdns_prot = {
@@ -50,7 +49,8 @@ static struct protocol_info mdns_prot = {
     .long_name = "Multicast DNS",
     .decode = handle_dns,
     .print_pdu = print_dns,
-    .add_pdu = add_dns_information
+    .add_pdu = add_dns_information,
+    .eager = true /* the answers are used by the host analyzer */
 };
 
 static struct protocol_info llmnr_prot = {
@@ -58,7 +58,8 @@ static struct protocol_info llmnr_prot = {
     .long_name = "Link-Local Multicast Name Resolution",
     .decode = handle_dns,
     .print_pdu = print_dns,
-    .add_pdu = add_dns_information
+    .add_pdu = add_dns_information,
+    .eager = true /* the answers are used by the host analyzer */
 };
 
 void register_dns(void)
@@ -198,8 +199,7 @@ packet_error handle_dns(struct protocol_info *pinfo, unsigned char *buffer, int
             plen -= len;
         }
     }
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     return NO_ERR;
 
 error:
@@ -267,10 +267,7 @@ int parse_dns_record(int i, unsigned char *buffer, int n, unsigned char **data,
     len += 10 + rdlen;
     switch (dns->record[i].type) {
     case DNS_TYPE_A:
-        if (rdlen == 4) {
-            dns->record[i].rdata.address = get_uint32le(ptr);
-            dns_cache_insert(dns->record[i].rdata.address, dns->record[i].name);
-        }
+        dns->record[i].rdata.address = (rdlen == 4) ? get_uint32le(ptr) : 0;
         ptr += rdlen;
         break;
     case DNS_TYPE_NS:
@@ -504,45 +501,6 @@ uint8_t parse_dns_txt(unsigned char **data, unsigned int dlen, char **txt)
     return len;
 }
 
-list_t *parse_dns_options(struct dns_resource_record *rr)
-{
-    list_t *opt;
-    int length;
-    unsigned char *ptr;
-
-    opt = list_init(NULL);
-    length = rr->rdata.opt.rdlen;
-    ptr = rr->rdata.opt.data;
-    while (length > 0) {
-        struct dns_opt_rr *opt_rr;
-
-        opt_rr = malloc(sizeof(struct dns_opt_rr));
-        opt_rr->option_code = ptr[0] << 8 | ptr[1];
-        opt_rr->option_length = ptr[2] << 8 | ptr[3];
-        ptr += 4;
-        length -= 4;
-        opt_rr->data = malloc(opt_rr->option_length);
-        memcpy(opt_rr->data, ptr, opt_rr->option_length);
-        length -= opt_rr->option_length;
-        ptr += opt_rr->option_length;
-        list_push_back(opt, opt_rr);
-    }
-    return opt;
-}
-
-void free_dns_options(list_t *opt)
-{
-    list_free(opt, free_opt_rr);
-}
-
-void free_opt_rr(void *data)
-{
-    struct dns_opt_rr *rr = (struct dns_opt_rr *) data;
-
-    free(rr->data);
-    free(rr);
-}
-
 /*
  * The RR type space is split into 256 window blocks, each representing
  * the low-order 8 bits of the 16-bit RR type space. Each block that
@@ -124,7 +124,13 @@ struct dns_txt_rr {
 struct dns_opt_rr {
     uint16_t option_code;
     uint16_t option_length;
-    unsigned char *data;
+    unsigned char *data; /* points into the OPT record */
+};
+
+/* Iterator over the options in an OPT record */
+struct dns_option_iterator {
+    unsigned char *p;
+    int len;
 };
 
 struct dns_flags {
@@ -294,12 +300,14 @@ int get_dns_flags_size(void);
 struct packet_flags *get_llmnr_flags(void);
 int get_llmnr_flags_size(void);
 
+/* Start iterating over the options in the DNS pseudo OPT resource record */
+void dns_options_begin(struct dns_option_iterator *it, struct dns_resource_record *rr);
+
 /*
- * Parse the DNS pseudo opt resource record. The list needs to be freed with
- * free_dns_option
+ * Parse the next option into 'opt'. Returns false when there are no more
+ * options or the option is malformed. Nothing is allocated.
  */
-list_t *parse_dns_options(struct dns_resource_record *rr);
-void free_dns_options(list_t *opt);
+bool dns_options_next(struct dns_option_iterator *it, struct dns_opt_rr *opt);
 
 /* internal to the decoder */
 void register_dns(void);
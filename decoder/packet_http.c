@@ -66,8 +66,7 @@ packet_error handle_http(struct protocol_info *pinfo, unsigned char *buffer,
     if (!parse_http(buffer, len, http)) {
         return UNK_PROTOCOL;
     }
-    pinfo->num_packets++;
-    pinfo->num_bytes += len;
+    update_protocol_stat(pinfo, len);
     return NO_ERR;
 }
 
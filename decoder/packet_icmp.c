@@ -39,8 +39,7 @@ packet_error handle_icmp(struct protocol_info *pinfo, unsigned char *buffer, int
     info = mempool_alloc(sizeof(struct icmp_info));
     pdata->data = info;
     pdata->len = n;
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     info->type = icmp->icmp_type;
     info->code = icmp->icmp_code;
     info->checksum = htons(icmp->icmp_cksum);
@@ -156,8 +156,7 @@ packet_error handle_icmp6(struct protocol_info *pinfo, unsigned char *buf, int n
     icmp6->option = NULL;
     pdata->data = icmp6;
     pdata->len = n;
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     icmp6->type = buf[0];
     icmp6->code = buf[1];
     icmp6->checksum = get_uint16be(buf + 2);
@@ -189,7 +188,7 @@ packet_error handle_icmp6(struct protocol_info *pinfo, unsigned char *buf, int n
         icmp6->echo.seq = read_uint16be(&buf);
         n -= 4;
         if (n > 0)
-            icmp6->echo.data = buf;
+            icmp6->echo.data = frame_ptr(buf, n);
         icmp6->echo.len = n;
         break;
     case ND_ROUTER_SOLICIT:
@@ -94,8 +94,7 @@ packet_error handle_igmp(struct protocol_info *pinfo, unsigned char *buffer, int
     igmp = mempool_calloc(struct igmp_info);
     pdata->data = igmp;
     pdata->len = n;
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     igmp->type = buffer[0];
     igmp->max_resp_time = buffer[1];
     igmp->checksum = get_uint16be(&buffer[2]);
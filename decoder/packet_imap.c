@@ -50,8 +50,7 @@ packet_error handle_imap(struct protocol_info *pinfo, unsigned char *buf, int n,
         i++;
     }
     if (i > 1) {
-        pinfo->num_packets++;
-        pinfo->num_bytes += n;
+        update_protocol_stat(pinfo, n);
         return NO_ERR;
     }
     mempool_free(imap->lines);
@@ -94,8 +94,7 @@ packet_error handle_ipv4(struct protocol_info *pinfo, unsigned char *buffer, int
     ip = (struct ip *) buffer;
     if (n < ip->ip_hl * 4 || ip->ip_hl < 5) return DECODE_ERR;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     ipv4 = mempool_alloc(sizeof(struct ipv4_info));
     pdata->data = ipv4;
     ipv4->src = ip->ip_src.s_addr;
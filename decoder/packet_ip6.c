@@ -74,8 +74,7 @@ packet_error handle_ipv6(struct protocol_info *pinfo, unsigned char *buffer, int
     if ((unsigned int) n < header_len)
         return DECODE_ERR;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     ip6 = (struct ip6_hdr *) buffer;
     ipv6 = mempool_alloc(sizeof(struct ipv6_info));
     pdata->data = ipv6;
@@ -30,8 +30,7 @@ packet_error handle_llc(struct protocol_info *pinfo, unsigned char *buffer, int
     struct protocol_info *psub;
     uint32_t id;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     llc = mempool_alloc(sizeof(struct eth_802_llc));
     pdata->data = llc;
     llc->dsap = buffer[0];
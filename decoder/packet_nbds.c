@@ -97,8 +97,7 @@ packet_error handle_nbds(struct protocol_info *pinfo, unsigned char *buffer, int
     default:
         break;
     }
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     return NO_ERR;
 }
 
@@ -159,8 +159,7 @@ packet_error handle_nbns(struct protocol_info *pinfo, unsigned char *buffer, int
             }
         }
     }
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     return NO_ERR;
 
 error:
@@ -63,8 +63,7 @@ packet_error handle_pim(struct protocol_info *pinfo, unsigned char *buffer, int
     pim = mempool_alloc(sizeof(struct pim_info));
     pdata->data = pim;
     pdata->len = n;
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     pim->version = (buffer[0] >> 4) & 0xf;
     pim->type = buffer[0] & 0xf;
     pim->checksum = buffer[1] << 8 | buffer[2];
@@ -67,8 +67,7 @@ packet_error handle_smb(struct protocol_info *pinfo, unsigned char *buffer, int
 
     struct smb_info *smb;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     smb = mempool_alloc(sizeof(struct smb_info));
     pdata->data = smb;
     pdata->len = n;
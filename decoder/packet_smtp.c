@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <errno.h>
+#include <pthread.h>
 #include "packet.h"
 #include "packet_smtp.h"
 #include "packet_imap.h"
@@ -16,6 +17,7 @@
  */
 #define MAXLENGTH 2048
 #define REPLY_CODE_DIGITS 3
+#define TBLSZ 64
 
 extern void print_smtp(char *buf, int n, void *data);
 extern void add_smtp_information(void *widget, void *subwidget, void *data);
@@ -96,12 +98,20 @@ struct smtp_data {
     struct smtp_rsp *rsp;
 };
 
+/*
+ * The SMTP state of the sessions. This is kept by the decoder itself, and not
+ * by the TCP analyzer, since decoding can be done by several capture threads.
+ */
+static hashmap_t *sessions;
+static pthread_mutex_t sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static struct protocol_info smtp_prot = {
     .short_name = "SMTP",
     .long_name = "Simple Mail Transfer Protocol",
     .decode = handle_smtp,
     .print_pdu = print_smtp,
-    .add_pdu = add_smtp_information
+    .add_pdu = add_smtp_information,
+    .eager = true /* the session state depends on every packet */
 };
 
 void register_smtp(void)
@@ -109,6 +119,64 @@ void register_smtp(void)
     register_protocol(&smtp_prot, PORT, SMTP);
     register_protocol(&smtp_prot, PORT, SMTP_EMS);
     register_protocol(&smtp_prot, PORT, SMTP_ALT);
+    sessions = hashmap_init(TBLSZ, hash_tcp_v4, compare_tcp_v4);
+    hashmap_set_free_key(sessions, free);
+    hashmap_set_free_data(sessions, free);
+}
+
+void smtp_clear_sessions(void)
+{
+    pthread_mutex_lock(&sessions_lock);
+    hashmap_clear(sessions);
+    pthread_mutex_unlock(&sessions_lock);
+}
+
+void smtp_free_sessions(void)
+{
+    pthread_mutex_lock(&sessions_lock);
+    hashmap_free(sessions);
+    sessions = NULL;
+    pthread_mutex_unlock(&sessions_lock);
+}
+
+/* Return a copy of the session state, creating the session if necessary */
+static struct smtp_conn_state get_session(struct tcp_endpoint_v4 *endp, bool *created)
+{
+    struct smtp_conn_state *state;
+    struct smtp_conn_state ret;
+
+    *created = false;
+    pthread_mutex_lock(&sessions_lock);
+    if ((state = hashmap_get(sessions, endp)) == NULL) {
+        struct tcp_endpoint_v4 *key;
+
+        key = malloc(sizeof(*key));
+        *key = *endp;
+        state = calloc(1, sizeof(*state));
+        state->state = NORMAL;
+        hashmap_insert(sessions, key, state);
+        *created = true;
+    }
+    ret = *state;
+    pthread_mutex_unlock(&sessions_lock);
+    return ret;
+}
+
+static void update_session(struct tcp_endpoint_v4 *endp, struct smtp_conn_state *state)
+{
+    struct smtp_conn_state *s;
+
+    pthread_mutex_lock(&sessions_lock);
+    if ((s = hashmap_get(sessions, endp)) != NULL)
+        *s = *state;
+    pthread_mutex_unlock(&sessions_lock);
+}
+
+static void remove_session(struct tcp_endpoint_v4 *endp)
+{
+    pthread_mutex_lock(&sessions_lock);
+    hashmap_remove(sessions, endp);
+    pthread_mutex_unlock(&sessions_lock);
 }
 
 static int cmp_code(const void *c1, const void *c2)
@@ -164,13 +232,13 @@ static packet_error handle_smtp(struct protocol_info *pinfo, unsigned char *buf,
     struct smtp_info *smtp;
     unsigned char *p;
     int i = 0;
-    struct smtp_conn_state *smtp_state;
+    struct smtp_conn_state state;
+    struct smtp_conn_state *smtp_state = &state;
     struct packet_data *root;
     struct tcp *tcp;
     struct tcp_endpoint_v4 endp;
     struct ipv4_info *ipv4;
-    struct tcp_connection_v4 *conn;
-    bool conn_created = false;
+    bool conn_created;
 
      /* only support for TCP and IPv4 */
     if (pdata->transport != IPPROTO_TCP)
@@ -187,18 +255,9 @@ static packet_error handle_smtp(struct protocol_info *pinfo, unsigned char *buf,
     endp.dport = tcp->dport;
     endp.src = ipv4->src;
     endp.dst = ipv4->dst;
-    if ((conn = tcp_analyzer_get_connection(&endp)) == NULL) {
-        conn = tcp_analyzer_create_connection(&endp);
-        conn->state = ESTABLISHED;
-        conn_created = true;
-    }
-    if (!conn->data) {
-        smtp_state = mempool_alloc(sizeof(*smtp_state));
-        smtp_state->state = NORMAL;
-        conn->data = smtp_state;
-    } else {
-        smtp_state = conn->data;
-    }
+    state = get_session(&endp, &conn_created);
+    if (tcp->fin || tcp->rst)
+        remove_session(&endp);
     if (smtp_state->state == TLS) {
         pdata->id = get_protocol_id(PORT, SMTPS);
         pinfo = get_protocol(pdata->id);
@@ -210,9 +269,14 @@ static packet_error handle_smtp(struct protocol_info *pinfo, unsigned char *buf,
     pdata->data = smtp;
     pdata->len = n;
     if (smtp_state->state == DATA || smtp_state->state == BDAT) {
-        smtp->data = (char *) buf;
+        smtp->data = (char *) frame_ptr(buf, n);
         smtp->len = n;
-        if (smtp_state->state == DATA && strncmp(smtp->data, "\r\n.\r\n", 5) == 0) {
+        if (!smtp->data) {
+            /* the mail data is sliced off */
+            smtp->data = "";
+            smtp->len = 0;
+        }
+        if (smtp_state->state == DATA && strncmp((char *) buf, "\r\n.\r\n", 5) == 0) {
             smtp_state->state = NORMAL;
         } else if (smtp_state->state == BDAT) {
             smtp_state->chunk_size -= n;
@@ -329,13 +393,14 @@ static packet_error handle_smtp(struct protocol_info *pinfo, unsigned char *buf,
         }
     }
 ok:
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    if (!tcp->fin && !tcp->rst)
+        update_session(&endp, smtp_state);
+    update_protocol_stat(pinfo, n);
     return NO_ERR;
 
 error:
     if (conn_created)
-        tcp_analyzer_remove_connection(&endp);
+        remove_session(&endp);
     mempool_free(smtp);
     return DECODE_ERR;
 }
@@ -22,6 +22,10 @@ struct smtp_info {
 };
 
 void register_smtp(void);
+
+/* Forget the state of all SMTP sessions */
+void smtp_clear_sessions(void);
+void smtp_free_sessions(void);
 char *get_smtp_code(int code);
 
 #endif
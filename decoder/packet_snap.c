@@ -23,8 +23,7 @@ packet_error handle_snap(struct protocol_info *pinfo, unsigned char *buffer, int
 {
     struct snap_info *snap;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     snap = mempool_alloc(sizeof(struct snap_info));
     pdata->data = snap;
     pdata->len = n;
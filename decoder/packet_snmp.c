@@ -78,8 +78,7 @@ packet_error handle_snmp(struct protocol_info *pinfo, unsigned char *buffer, int
         return DECODE_ERR;
     }
     if (tag == SNMP_SEQUENCE_TAG) {
-        pinfo->num_packets++;
-        pinfo->num_bytes += n;
+        update_protocol_stat(pinfo, n);
         return parse_pdu(ptr, msg_len, snmp);
     }
     return DECODE_ERR;
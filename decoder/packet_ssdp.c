@@ -41,8 +41,7 @@ packet_error handle_ssdp(struct protocol_info *pinfo, unsigned char *buffer, int
     ssdp = mempool_alloc(sizeof(struct ssdp_info));
     pdata->data = ssdp;
     pdata->len = n;
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     ssdp->fields = list_init(&d_alloc);
     return parse_ssdp((char *) buffer, n, ssdp->fields);
 }
@@ -57,12 +56,13 @@ packet_error handle_ssdp(struct protocol_info *pinfo, unsigned char *buffer, int
 packet_error parse_ssdp(char *str, int n, list_t *msg_header)
 {
     char *token;
+    char *saveptr;
     char cstr[n + 1];
     size_t len = 0;
 
     strncpy(cstr, str, n);
     cstr[n] = '\0';
-    token = strtok(cstr, "\r\n");
+    token = strtok_r(cstr, "\r\n", &saveptr);
     len += 2;
     while (token) {
         char *field;
@@ -72,7 +72,7 @@ packet_error parse_ssdp(char *str, int n, list_t *msg_header)
         len += toklen + 2;
         field = mempool_copy0(token, toklen);
         list_push_back(msg_header, field);
-        token = strtok(NULL, "\r\n");
+        token = strtok_r(NULL, "\r\n", &saveptr);
     }
     if ((size_t) n != len)
         return DECODE_ERR;
@@ -51,8 +51,7 @@ packet_error handle_stp(struct protocol_info *pinfo, unsigned char *buffer, int
     /* protocol id 0x00 identifies the (Rapid) Spanning Tree Protocol */
     if (protocol_id != 0x0) return DECODE_ERR;
 
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     bpdu = mempool_alloc(sizeof(struct stp_info));
     pdata->data = bpdu;
     pdata->len = n;
@@ -17,7 +17,6 @@ static struct packet_flags tcp_flags[] = {
     { "FIN: No more data", 1, NULL}
 };
 
-static void free_options(void *data);
 extern void add_tcp_information(void *w, void *sw, void *data);
 extern void print_tcp(char *buf, int n, void *data);
 
@@ -112,8 +111,7 @@ packet_error handle_tcp(struct protocol_info *pinfo, unsigned char *buffer, int
 
     info = mempool_alloc(sizeof(struct tcp));
     pdata->data = info;
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     info->sport = ntohs(tcp->th_sport);
     info->dport = ntohs(tcp->th_dport);
     info->seq_num = ntohl(tcp->th_seq);
@@ -156,100 +154,6 @@ packet_error handle_tcp(struct protocol_info *pinfo, unsigned char *buffer, int
     return error;
 }
 
-list_t *parse_tcp_options(unsigned char **data, int len)
-{
-    list_t *options;
-    unsigned char *p = *data;
-
-    options = list_init(NULL);
-
-    /* the data is based on a tag-length-value encoding scheme */
-    while (len > 0) {
-        struct tcp_options *opt = calloc(1, sizeof(struct tcp_options));
-
-        opt->option_kind = *p;
-        opt->option_length = *++p; /* length of value + 1 byte tag and 1 byte length */
-        if (opt->option_kind != TCP_OPT_NOP && opt->option_length == 0) {
-            free(opt);
-            return options;
-        }
-        switch (opt->option_kind) {
-        case TCP_OPT_END:
-            free(opt);
-            return options;
-        case TCP_OPT_NOP:
-            opt->option_length = 1; /* NOP only contains the kind byte */
-            break;
-        case TCP_OPT_MSS:
-            p++; /* skip length field */
-            if (opt->option_length == 4) {
-                opt->mss = p[0] << 8 | p[1];
-            }
-            p += opt->option_length - 2;
-            break;
-        case TCP_OPT_WIN_SCALE:
-            p++; /* skip length field */
-            if (opt->option_length == 3) {
-                opt->win_scale = *p;
-            }
-            p += opt->option_length - 2;
-            break;
-        case TCP_OPT_SAP: /* 2 bytes */
-            p++; /* skip length field */
-            opt->sack_permitted = true;
-            break;
-        case TCP_OPT_SACK:
-        {
-            int num_blocks = (opt->option_length - 2) / 8;
-            struct tcp_sack_block *b;
-
-            p++; /* skip length field */
-            opt->sack = list_init(NULL);
-            while (num_blocks--) {
-                b = malloc(sizeof(struct tcp_sack_block));
-                b->left_edge = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
-                b->right_edge = p[4] << 24 | p[5] << 16 | p[6] << 8 | p[7];
-                list_push_back(opt->sack, b);
-                p += 8; /* each block is 8 bytes */
-            }
-            break;
-        }
-        case TCP_OPT_TIMESTAMP:
-            p++; /* skip length field */
-            if (opt->option_length == 10) {
-                opt->ts.ts_val = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
-                opt->ts.ts_ecr = p[4] << 24 | p[5] << 16 | p[6] << 8 | p[7];
-            }
-            p += opt->option_length - 2;
-            break;
-        case TCP_OPT_TFO:
-            p++; /* skip length field */
-            if (opt->option_length > 2 && opt->option_length <= 16)
-                opt->cookie = *data + (p - *data);
-            p += opt->option_length - 2;
-            break;
-        }
-        list_push_back(options, opt);
-        len -= opt->option_length;
-    }
-    return options;
-}
-
-void free_tcp_options(list_t *list)
-{
-    list_free(list, free_options);
-}
-
-void free_options(void *data)
-{
-    struct tcp_options *opt = data;
-
-    if (opt->option_kind == TCP_OPT_SACK) {
-        list_free(opt->sack, free);
-    }
-    free(opt);
-}
-
 struct packet_flags *get_tcp_flags(void)
 {
     return tcp_flags;
@@ -39,6 +39,13 @@ struct tcp {
     unsigned char *options;
 };
 
+#define TCP_MAX_SACK_BLOCKS 4 /* the options are at most 40 bytes */
+
+struct tcp_sack_block {
+    uint32_t left_edge;
+    uint32_t right_edge;
+};
+
 struct tcp_options {
     uint8_t option_kind;
     uint8_t option_length;
@@ -48,26 +55,33 @@ struct tcp_options {
         uint8_t win_scale;
         bool sack_permitted; /* may be sent in a SYN by a TCP that has been extended to
                               * receive the SACK option once the connection has opened */
-        list_t *sack;    /* list of sack blocks */
+        struct {
+            uint8_t num_blocks;
+            struct tcp_sack_block blocks[TCP_MAX_SACK_BLOCKS];
+        } sack;
         struct {
             uint32_t ts_val; /* timestamp value */
             uint32_t ts_ecr; /* timestamp echo reply */
         } ts;
-        unsigned char *cookie;
+        unsigned char *cookie; /* points into the TCP header */
     };
 };
 
-struct tcp_sack_block {
-    uint32_t left_edge;
-    uint32_t right_edge;
+/* Iterator over the options in the TCP header */
+struct tcp_option_iterator {
+    unsigned char *p;
+    int len;
 };
 
+/* Start iterating over the 'len' bytes of options in the TCP header */
+void tcp_options_begin(struct tcp_option_iterator *it, unsigned char *options, int len);
+
 /*
- * Parses and returns the TCP options in the TCP header.
- * The list needs to be freed with 'free_tcp_options' after use.
+ * Parse the next TCP option into 'opt'. Returns false when there are no more
+ * options or the option is malformed. Nothing is allocated, so the options can
+ * be parsed for every packet.
  */
-list_t *parse_tcp_options(unsigned char **data, int len);
-void free_tcp_options(list_t *options);
+bool tcp_options_next(struct tcp_option_iterator *it, struct tcp_options *opt);
 
 struct packet_flags *get_tcp_flags(void);
 int get_tcp_flags_size(void);
@@ -431,7 +431,7 @@ packet_error handle_tls(struct protocol_info *pinfo, unsigned char *buf, int n,
             buf += record_len;
             break;
         case TLS_APPLICATION_DATA:
-            (*pptr)->data = buf;
+            (*pptr)->data = frame_ptr(buf, record_len);
             buf += record_len;
             break;
         case TLS_HANDSHAKE:
@@ -454,8 +454,7 @@ packet_error handle_tls(struct protocol_info *pinfo, unsigned char *buf, int n,
     }
 
 done:
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     pdata->data = tls;
     pdata->len = n;
     return NO_ERR;
@@ -43,8 +43,7 @@ packet_error handle_udp(struct protocol_info *pinfo, unsigned char *buffer, int
     struct udp_info *info;
 
     info = mempool_alloc(sizeof(struct udp_info));
-    pinfo->num_packets++;
-    pinfo->num_bytes += n;
+    update_protocol_stat(pinfo, n);
     udp = (struct udphdr *) buffer;
     info->sport = ntohs(udp->uh_sport);
     info->dport = ntohs(udp->uh_dport);
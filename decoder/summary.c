@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "summary.h"
+#include "packet.h"
+#include "packet_ip.h"
+#include "../hash.h"
+#include "../util.h"
+
+#define INIT_SIZE 4096
+
+/* offsets in an Ethernet frame of the fields a packet filter can read here */
+#define ETHERTYPE_OFFSET 12
+#define IPV4_OFFSET 14
+#define FOFFSET_OFFSET 20
+#define PROTOCOL_OFFSET 23
+#define SRC_OFFSET 26
+#define DST_OFFSET 30
+#define SPORT_OFFSET 14 /* relative to the IPv4 header length */
+#define DPORT_OFFSET 16
+
+/* applies 'op' to every array in struct packet_summary */
+#define FOREACH_COLUMN(op) \
+    op(time) op(len) op(ethertype) op(protocol) op(foffset) op(src) op(dst) op(sport) op(dport) \
+    op(flow) op(top)
+
+struct packet_summary summary;
+
+/*
+ * The arrays as allocated. The packets are stored from index 'base', which is
+ * advanced when packets are evicted, so that the arrays in summary start with
+ * the first packet.
+ */
+static struct packet_summary buffers;
+static uint32_t base;
+static uint32_t capacity;
+
+static void update_columns(void)
+{
+#define UPDATE(c) summary.c = buffers.c + base;
+    FOREACH_COLUMN(UPDATE)
+#undef UPDATE
+}
+
+void summary_init(void)
+{
+    capacity = INIT_SIZE;
+#define ALLOC(c) buffers.c = malloc(capacity * sizeof(*buffers.c));
+    FOREACH_COLUMN(ALLOC)
+#undef ALLOC
+    summary_clear();
+}
+
+void summary_free(void)
+{
+#define FREE(c) free(buffers.c);
+    FOREACH_COLUMN(FREE)
+#undef FREE
+    memset(&buffers, 0, sizeof(buffers));
+    memset(&summary, 0, sizeof(summary));
+}
+
+/* Make room for one more packet */
+static void grow(void)
+{
+    if (base > 0 && base >= capacity / 2) {
+        /* the space freed by eviction is enough */
+#define MOVE(c) memmove(buffers.c, buffers.c + base, summary.size * sizeof(*buffers.c));
+        FOREACH_COLUMN(MOVE)
+#undef MOVE
+        base = 0;
+    } else {
+        capacity *= 2;
+#define REALLOC(c) buffers.c = realloc(buffers.c, capacity * sizeof(*buffers.c));
+        FOREACH_COLUMN(REALLOC)
+#undef REALLOC
+    }
+    update_columns();
+}
+
+/* A flow id that does not depend on the direction of the packet */
+static uint32_t flow_id(uint8_t protocol, uint32_t src, uint16_t sport, uint32_t dst,
+                        uint16_t dport)
+{
+    uint64_t a = ((uint64_t) src << 16) | sport;
+    uint64_t b = ((uint64_t) dst << 16) | dport;
+    uint32_t hash;
+
+    if (a > b) {
+        uint64_t tmp = a;
+
+        a = b;
+        b = tmp;
+    }
+    hash = hashfnv_uint64(UINT_TO_PTR(a)) * 31 + hashfnv_uint64(UINT_TO_PTR(b)) + protocol;
+    return hash ? hash : 1;
+}
+
+void summary_add(struct packet *p)
+{
+    struct packet_data *pdata;
+    bool ipv4 = false;
+    bool transport = false;
+    uint32_t i;
+
+    if (base + summary.size == capacity)
+        grow();
+    if (summary.size == 0)
+        summary.first = p->num;
+    i = summary.size++;
+    summary.time[i] = p->time;
+    summary.len[i] = p->wirelen;
+    summary.ethertype[i] = 0;
+    summary.protocol[i] = 0;
+    summary.foffset[i] = 0;
+    summary.src[i] = 0;
+    summary.dst[i] = 0;
+    summary.sport[i] = 0;
+    summary.dport[i] = 0;
+    summary.flow[i] = 0;
+    summary.top[i] = p->root->id;
+    if (p->root->id == get_protocol_id(DATALINK, LINKTYPE_ETHERNET) && p->root->data)
+        summary.ethertype[i] = ethertype(p);
+
+    /*
+     * The decoded data is followed once, and only here. The outer IPv4 header
+     * and transport header are kept, as they are what a packet filter sees.
+     */
+    for (pdata = p->root->next; pdata; pdata = pdata->next) {
+        if (!pdata->data)
+            break;
+        summary.top[i] = pdata->id;
+        if (pdata->id == get_protocol_id(ETHERNET_II, ETHERTYPE_IP) && !ipv4) {
+            struct ipv4_info *ip = pdata->data;
+
+            summary.protocol[i] = ip->protocol;
+            summary.foffset[i] = ip->foffset;
+            summary.src[i] = ip->src;
+            summary.dst[i] = ip->dst;
+            ipv4 = true;
+        } else if (pdata->id == get_protocol_id(IP_PROTOCOL, IPPROTO_TCP) && !transport) {
+            struct tcp *tcp = pdata->data;
+
+            summary.sport[i] = tcp->sport;
+            summary.dport[i] = tcp->dport;
+            transport = true;
+        } else if (pdata->id == get_protocol_id(IP_PROTOCOL, IPPROTO_UDP) && !transport) {
+            struct udp_info *udp = pdata->data;
+
+            summary.sport[i] = udp->sport;
+            summary.dport[i] = udp->dport;
+            transport = true;
+        }
+    }
+    if (ipv4)
+        summary.flow[i] = flow_id(summary.protocol[i], summary.src[i], summary.sport[i],
+                                  summary.dst[i], summary.dport[i]);
+}
+
+void summary_evict(uint32_t num)
+{
+    uint32_t n;
+
+    if (summary.size == 0 || num < summary.first)
+        return;
+    n = MIN(num - summary.first + 1, summary.size);
+    base += n;
+    summary.size -= n;
+    summary.first += n;
+    if (summary.size == 0)
+        base = 0;
+    update_columns();
+}
+
+void summary_clear(void)
+{
+    base = 0;
+    summary.size = 0;
+    summary.first = 0;
+    update_columns();
+}
+
+/*
+ * The filter is run on the values in the summary instead of the bytes of the
+ * frame, which is possible for filters on the ethertype, the IPv4 protocol,
+ * fragment offset and addresses, and the TCP and UDP ports. The ports are only
+ * read relative to the IPv4 header length, as their offset in the frame is not
+ * known. Anything else, e.g. a load from another offset, ends the run.
+ */
+bool summary_run_filter(struct bpf_prog bpf, uint32_t i, uint32_t *res)
+{
+    uint32_t a = 0;
+    uint32_t M[BPF_MEMWORDS];
+    bool ipv4 = summary.ethertype[i] == ETHERTYPE_IP && summary.flow[i] != 0;
+    bool ports = ipv4 && summary.top[i] != get_protocol_id(ETHERNET_II, ETHERTYPE_IP) &&
+        (summary.protocol[i] == IPPROTO_TCP || summary.protocol[i] == IPPROTO_UDP);
+    bool msh = false; /* the index register holds the IPv4 header length */
+
+    memset(M, 0, sizeof(M));
+    for (uint32_t pc = 0; pc < bpf.size; pc++) {
+        struct bpf_insn *insn = &bpf.bytecode[pc];
+
+        switch (insn->code) {
+        case BPF_LD | BPF_H | BPF_ABS:
+            if (insn->k == ETHERTYPE_OFFSET && summary.ethertype[i])
+                a = summary.ethertype[i];
+            else if (insn->k == FOFFSET_OFFSET && ipv4)
+                a = summary.foffset[i];
+            else
+                return false;
+            break;
+        case BPF_LD | BPF_B | BPF_ABS:
+            if (insn->k != PROTOCOL_OFFSET || !ipv4)
+                return false;
+            a = summary.protocol[i];
+            break;
+        case BPF_LD | BPF_W | BPF_ABS:
+            if (insn->k == SRC_OFFSET && ipv4)
+                a = ntohl(summary.src[i]);
+            else if (insn->k == DST_OFFSET && ipv4)
+                a = ntohl(summary.dst[i]);
+            else
+                return false;
+            break;
+        case BPF_LDX | BPF_B | BPF_MSH:
+            if (insn->k != IPV4_OFFSET || !ipv4)
+                return false;
+            msh = true;
+            break;
+        case BPF_LD | BPF_H | BPF_IND:
+            if (!msh || !ports)
+                return false;
+            if (insn->k == SPORT_OFFSET)
+                a = summary.sport[i];
+            else if (insn->k == DPORT_OFFSET)
+                a = summary.dport[i];
+            else
+                return false;
+            break;
+        case BPF_LD | BPF_W | BPF_IND:
+            if (!msh || !ports || insn->k != SPORT_OFFSET)
+                return false;
+            a = (uint32_t) summary.sport[i] << 16 | summary.dport[i];
+            break;
+        case BPF_LD | BPF_IMM:
+            a = insn->k;
+            break;
+        case BPF_LD | BPF_MEM:
+            a = M[insn->k];
+            break;
+        case BPF_ST:
+            M[insn->k] = a;
+            break;
+        case BPF_ALU | BPF_ADD | BPF_K:
+            a += insn->k;
+            break;
+        case BPF_ALU | BPF_SUB | BPF_K:
+            a -= insn->k;
+            break;
+        case BPF_ALU | BPF_MUL | BPF_K:
+            a *= insn->k;
+            break;
+        case BPF_ALU | BPF_DIV | BPF_K:
+        case BPF_ALU | BPF_MOD | BPF_K:
+            if (insn->k == 0) {
+                *res = 0;
+                return true;
+            }
+            a = BPF_OP(insn->code) == BPF_DIV ? a / insn->k : a % insn->k;
+            break;
+        case BPF_ALU | BPF_AND | BPF_K:
+            a &= insn->k;
+            break;
+        case BPF_ALU | BPF_OR | BPF_K:
+            a |= insn->k;
+            break;
+        case BPF_ALU | BPF_XOR | BPF_K:
+            a ^= insn->k;
+            break;
+        case BPF_ALU | BPF_LSH | BPF_K:
+            a <<= insn->k;
+            break;
+        case BPF_ALU | BPF_RSH | BPF_K:
+            a >>= insn->k;
+            break;
+        case BPF_ALU | BPF_NEG:
+            a = -a;
+            break;
+        case BPF_JMP | BPF_JA:
+            pc += insn->k;
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += a == insn->k ? insn->jt : insn->jf;
+            break;
+        case BPF_JMP | BPF_JGT | BPF_K:
+            pc += a > insn->k ? insn->jt : insn->jf;
+            break;
+        case BPF_JMP | BPF_JGE | BPF_K:
+            pc += a >= insn->k ? insn->jt : insn->jf;
+            break;
+        case BPF_JMP | BPF_JSET | BPF_K:
+            pc += a & insn->k ? insn->jt : insn->jf;
+            break;
+        case BPF_RET | BPF_K:
+            *res = insn->k;
+            return true;
+        case BPF_RET | BPF_A:
+            *res = a;
+            return true;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
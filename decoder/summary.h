@@ -0,0 +1,60 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "../bpf/bpf.h"
+
+struct packet;
+
+/*
+ * Summary of the stored packets, built when a packet is counted. Every field is
+ * kept in an array of its own indexed by packet number, so code that looks at
+ * one or two fields of many packets reads contiguous memory instead of
+ * following the decoded packet data.
+ */
+struct packet_summary {
+    uint32_t first;           /* number of the packet at index 0 */
+    uint32_t size;            /* number of packets */
+    struct timespec *time;
+    uint32_t *len;            /* length of the frame on the network */
+    uint16_t *ethertype;      /* 0 if not Ethernet */
+    uint8_t *protocol;        /* IPv4 transport protocol, 0 if not IPv4 */
+    uint16_t *foffset;        /* IPv4 flags and fragment offset, 0 if not IPv4 */
+    uint32_t *src;            /* IPv4 addresses in network byte order, or 0 */
+    uint32_t *dst;
+    uint16_t *sport;          /* TCP and UDP ports, or 0 */
+    uint16_t *dport;
+    uint32_t *flow;           /* the same in both directions of a flow, 0 if not IPv4 */
+    uint32_t *top;            /* protocol id of the innermost protocol decoded */
+};
+
+extern struct packet_summary summary;
+
+void summary_init(void);
+void summary_free(void);
+
+/* Add the packet. The packets need to be added in packet number order */
+void summary_add(struct packet *p);
+
+/* Remove all packets with a number less than or equal to num */
+void summary_evict(uint32_t num);
+
+/* Remove all packets */
+void summary_clear(void);
+
+/*
+ * Run the packet filter on the summary of the packet at index i and store the
+ * result in res. Returns false if the filter reads a field that is not in the
+ * summary, and the filter then needs to be run on the frame.
+ */
+bool summary_run_filter(struct bpf_prog bpf, uint32_t i, uint32_t *res);
+
+/* Return the index of packet number 'num' in the arrays */
+static inline uint32_t summary_index(uint32_t num)
+{
+    return num - summary.first;
+}
+
+#endif
@@ -1,17 +1,104 @@
 #include <stdlib.h>
 #include "tcp_analyzer.h"
 #include "packet_ip.h"
+#include "../util.h"
+#include "../retention.h"
+#include "../vector.h"
 
 #define TBLSZ 64 * 1024
 
-static hashmap_t *connection_table = NULL;
+static flowmap_t *connection_table = NULL;
+static hashmap_t *flow_cache = NULL; /* kernel flow hash -> connection */
 static publisher_t *conn_changed_publisher;
+static publisher_t *conn_removed_publisher;
+static vector_t *empty; /* connections without packets after an eviction */
 static int nconnections = 0;
+static allocator_t list_alloc; /* allocator for the packet lists */
+
+static void free_connection(void *data)
+{
+    struct tcp_connection_v4 *conn = data;
+
+    if (list_alloc.dealloc)
+        list_free(conn->packets, NULL);
+    free(conn);
+}
 
 void tcp_analyzer_init(void)
 {
-    connection_table = hashmap_init(TBLSZ, hash_tcp_v4, compare_tcp_v4);
+    connection_table = flowmap_init(TBLSZ);
+    flow_cache = hashmap_init(TBLSZ, NULL, NULL);
+    empty = vector_init(1024);
+
+    /* with limited retention the list nodes are freed when packets are removed */
+    if (retention_enabled())
+        allocator_init(&list_alloc);
+    else
+        list_alloc = d_alloc;
     conn_changed_publisher = publisher_init();
+    conn_removed_publisher = publisher_init();
+}
+
+/*
+ * The flow hash computed by the kernel is not the same in both directions of a
+ * connection, e.g. it is random for locally generated TCP packets. The
+ * connection is therefore found through a cache indexed by the flow hash of
+ * each direction, and the endpoint only needs to be hashed on a cache miss or
+ * when the packet has no flow hash, e.g. when reading a pcap file. A cache hit
+ * is about twice as fast as a lookup in the connection table, see
+ * tests/bench/hashmap_bench.c.
+ *
+ * A connection has at most two entries in the cache, and they are removed
+ * together with the connection.
+ */
+static void cache_insert(struct tcp_connection_v4 *conn, uint32_t rxhash)
+{
+    /* the entry may have been taken over by a connection with the same flow hash */
+    if (conn->rxhash[0] == rxhash || conn->rxhash[1] == rxhash) {
+        hashmap_insert_hash(flow_cache, UINT_TO_PTR(rxhash), conn, rxhash);
+        return;
+    }
+
+    /* the flow hash of a direction can change, e.g. when the route changes */
+    if (conn->rxhash[1] != 0 &&
+        hashmap_get_hash(flow_cache, UINT_TO_PTR(conn->rxhash[1]), conn->rxhash[1]) == conn)
+        hashmap_remove_hash(flow_cache, UINT_TO_PTR(conn->rxhash[1]), conn->rxhash[1]);
+    if (conn->rxhash[0] != 0)
+        conn->rxhash[1] = conn->rxhash[0];
+    conn->rxhash[0] = rxhash;
+    hashmap_insert_hash(flow_cache, UINT_TO_PTR(rxhash), conn, rxhash);
+}
+
+static void cache_remove(struct tcp_connection_v4 *conn)
+{
+    for (int i = 0; i < 2; i++) {
+        uint32_t rxhash = conn->rxhash[i];
+
+        /* the entry is reused if another connection has the same flow hash */
+        if (rxhash != 0 && hashmap_get_hash(flow_cache, UINT_TO_PTR(rxhash), rxhash) == conn)
+            hashmap_remove_hash(flow_cache, UINT_TO_PTR(rxhash), rxhash);
+    }
+}
+
+static struct tcp_connection_v4 *get_connection(struct tcp_endpoint_v4 *endp)
+{
+    void **conn = flowmap_get(connection_table, tcp_flow_key(endp));
+
+    return conn ? *conn : NULL;
+}
+
+static struct tcp_connection_v4 *lookup(struct tcp_endpoint_v4 *endp, uint32_t rxhash)
+{
+    struct tcp_connection_v4 *conn;
+
+    if (rxhash == 0)
+        return get_connection(endp);
+    conn = hashmap_get_hash(flow_cache, UINT_TO_PTR(rxhash), rxhash);
+    if (conn && compare_tcp_v4(conn->endp, endp) == 0)
+        return conn;
+    if ((conn = get_connection(endp)) != NULL)
+        cache_insert(conn, rxhash);
+    return conn;
 }
 
 void tcp_analyzer_check_stream(const struct packet *p)
@@ -31,7 +118,7 @@ void tcp_analyzer_check_stream(const struct packet *p)
         endp.dst = ipv4_dst(p);
         endp.sport = tcp_member(p, sport);
         endp.dport = tcp_member(p, dport);
-        conn = hashmap_get(connection_table, &endp);
+        conn = lookup(&endp, p->rxhash);
         if (conn) {
             bool is_new = list_size(conn->packets) == 0;
 
@@ -75,6 +162,8 @@ void tcp_analyzer_check_stream(const struct packet *p)
             else /* already established session */
                 new_conn->state = ESTABLISHED;
             list_push_back(new_conn->packets, (void *) p);
+            if (p->rxhash != 0)
+                cache_insert(new_conn, p->rxhash);
             publish2(conn_changed_publisher, new_conn, (void *) 0x1);
         }
     }
@@ -83,36 +172,84 @@ void tcp_analyzer_check_stream(const struct packet *p)
 struct tcp_connection_v4 *tcp_analyzer_create_connection(struct tcp_endpoint_v4 *endp)
 {
     struct tcp_connection_v4 *new_conn;
-    struct tcp_endpoint_v4 *new_endp;
 
-    new_endp = mempool_copy(endp, sizeof(struct tcp_endpoint_v4));
-    new_conn = mempool_alloc(sizeof(struct tcp_connection_v4));
-    new_conn->endp = new_endp;
-    new_conn->packets = list_init(&d_alloc);
+    /* the endpoint is stored after the connection */
+    new_conn = malloc(sizeof(struct tcp_connection_v4) + sizeof(struct tcp_endpoint_v4));
+    new_conn->endp = (struct tcp_endpoint_v4 *) (new_conn + 1);
+    *new_conn->endp = *endp;
+    new_conn->packets = list_init(&list_alloc);
     new_conn->num = nconnections++;
+    new_conn->rxhash[0] = 0;
+    new_conn->rxhash[1] = 0;
+    new_conn->refs = 0;
     new_conn->data = NULL;
-    hashmap_insert(connection_table, new_endp, new_conn);
+    flowmap_insert(connection_table, tcp_flow_key(endp), new_conn);
     return new_conn;
 }
 
 struct tcp_connection_v4 *tcp_analyzer_get_connection(struct tcp_endpoint_v4 *endp)
 {
     if (connection_table)
-        return hashmap_get(connection_table, endp);
+        return get_connection(endp);
     return NULL;
 }
 
+static void remove_connection(struct tcp_connection_v4 *conn)
+{
+    cache_remove(conn);
+    publish1(conn_removed_publisher, conn);
+    flowmap_remove(connection_table, tcp_flow_key(conn->endp));
+    free_connection(conn);
+}
+
 void tcp_analyzer_remove_connection(struct tcp_endpoint_v4 *endp)
 {
-    if (connection_table)
-        hashmap_remove(connection_table, endp);
+    if (connection_table) {
+        struct tcp_connection_v4 *conn;
+
+        if ((conn = get_connection(endp)))
+            remove_connection(conn);
+    }
 }
 
-hashmap_t *tcp_analyzer_get_sessions(void)
+flowmap_t *tcp_analyzer_get_sessions(void)
 {
     return connection_table;
 }
 
+void tcp_analyzer_evict(uint32_t num)
+{
+    struct flowmap_slot *slot;
+
+    if (!connection_table)
+        return;
+    HASHMAP_GEN_FOREACH(flowmap, connection_table, slot) {
+        struct tcp_connection_v4 *conn = slot->value;
+        struct packet *p;
+
+        /* the packets are stored in packet number order */
+        while ((p = list_front(conn->packets)) && p->num <= num)
+            list_pop_front(conn->packets, NULL);
+        if (list_size(conn->packets) == 0 && conn->refs == 0)
+            vector_push_back(empty, conn);
+    }
+
+    /* the table cannot be changed while it is iterated */
+    for (int i = 0; i < vector_size(empty); i++)
+        remove_connection(vector_get(empty, i));
+    vector_clear(empty, NULL);
+}
+
+void tcp_analyzer_ref(struct tcp_connection_v4 *conn)
+{
+    conn->refs++;
+}
+
+void tcp_analyzer_unref(struct tcp_connection_v4 *conn)
+{
+    conn->refs--;
+}
+
 void tcp_analyzer_subscribe(analyzer_conn_fn fn)
 {
     if (conn_changed_publisher)
@@ -125,6 +262,18 @@ void tcp_analyzer_unsubscribe(analyzer_conn_fn fn)
         remove_subscription2(conn_changed_publisher, (publisher_fn2) (void *) fn);
 }
 
+void tcp_analyzer_subscribe_remove(analyzer_remove_fn fn)
+{
+    if (conn_removed_publisher)
+        add_subscription1(conn_removed_publisher, (publisher_fn1) (void *) fn);
+}
+
+void tcp_analyzer_unsubscribe_remove(analyzer_remove_fn fn)
+{
+    if (conn_removed_publisher)
+        remove_subscription1(conn_removed_publisher, (publisher_fn1) (void *) fn);
+}
+
 char *tcp_analyzer_get_connection_state(enum connection_state state)
 {
     switch (state) {
@@ -144,17 +293,36 @@ char *tcp_analyzer_get_connection_state(enum connection_state state)
     }
 }
 
+static void free_connections(void)
+{
+    struct flowmap_slot *slot;
+
+    HASHMAP_GEN_FOREACH(flowmap, connection_table, slot)
+        free_connection(slot->value);
+}
+
 void tcp_analyzer_clear(void)
 {
-    if (connection_table)
-        hashmap_clear(connection_table);
+    if (connection_table) {
+        free_connections();
+        flowmap_clear(connection_table);
+        hashmap_clear(flow_cache);
+    }
     nconnections = 0;
 }
 
 void tcp_analyzer_free(void)
 {
-    hashmap_free(connection_table);
+    if (connection_table)
+        free_connections();
+    flowmap_free(connection_table);
+    hashmap_free(flow_cache);
+    vector_free(empty, NULL);
     publisher_free(conn_changed_publisher);
+    publisher_free(conn_removed_publisher);
     connection_table = NULL;
+    flow_cache = NULL;
+    empty = NULL;
     conn_changed_publisher = NULL;
+    conn_removed_publisher = NULL;
 }
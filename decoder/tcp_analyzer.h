@@ -2,7 +2,10 @@
 #define TCP_ANALYZER_H
 
 #include "packet_ethernet.h"
+#include <netinet/in.h>
 #include "../hashmap.h"
+#include "../hashmap_gen.h"
+#include "../hash.h"
 #include "../signal.h"
 #include "../list.h"
 
@@ -27,6 +30,8 @@ struct tcp_connection_v4 {
     enum connection_state state;
     list_t *packets;
     uint32_t num;
+    uint32_t rxhash[2]; /* kernel flow hash of each direction, 0 if unknown */
+    unsigned int refs; /* the connection is not evicted while it is referenced */
     void *data; /* Protocol related meta-data. Can be NULL */
 };
 
@@ -36,31 +41,65 @@ struct tcp_connection_v4 {
  */
 typedef void (*analyzer_conn_fn)(struct tcp_connection_v4 *, bool);
 
-static inline unsigned int hash_tcp_v4(const void *key)
-{
-    struct tcp_endpoint_v4 *endp = (struct tcp_endpoint_v4 *) key;
-    unsigned int hash = 2166136261;
-    unsigned int val = endp->src + endp->dst + endp->sport + endp->dport;
+/* Function that will be called before a connection is removed and deallocated */
+typedef void (*analyzer_remove_fn)(struct tcp_connection_v4 *);
 
-    for (int i = 0; i < 4; i++) {
-        hash = (hash ^ ((val >> (8 * i)) & 0xff)) * 16777619;
+/*
+ * A connection's endpoints in canonical order: the endpoint with the lowest
+ * address, or port if the addresses are equal, comes first. Both directions of
+ * a connection have the same flow key.
+ */
+struct tcp_flow_key {
+    uint64_t addrs; /* first address in the upper 32 bits */
+    uint32_t ports; /* first port in the upper 16 bits */
+};
+
+static inline struct tcp_flow_key tcp_flow_key(const struct tcp_endpoint_v4 *endp)
+{
+    struct tcp_flow_key key;
+
+    if (endp->src < endp->dst || (endp->src == endp->dst && endp->sport <= endp->dport)) {
+        key.addrs = (uint64_t) endp->src << 32 | endp->dst;
+        key.ports = (uint32_t) endp->sport << 16 | endp->dport;
+    } else {
+        key.addrs = (uint64_t) endp->dst << 32 | endp->src;
+        key.ports = (uint32_t) endp->dport << 16 | endp->sport;
     }
-    return hash;
+    return key;
+}
+
+/*
+ * The hash is keyed with a random key, see hash_siphash, so the distribution
+ * over the table cannot be predicted from the traffic.
+ */
+static inline uint32_t hash_flow_key(struct tcp_flow_key key)
+{
+    return hash_siphash(key.addrs, (uint64_t) IPPROTO_TCP << 32 | key.ports);
+}
+
+static inline bool equal_flow_key(struct tcp_flow_key k1, struct tcp_flow_key k2)
+{
+    return k1.addrs == k2.addrs && k1.ports == k2.ports;
+}
+
+/* Map keyed on the flow key, e.g. the connection table */
+HASHMAP_GENERATE(flowmap, struct tcp_flow_key, void *, hash_flow_key, equal_flow_key)
+
+static inline unsigned int hash_tcp_v4(const void *key)
+{
+    return hash_flow_key(tcp_flow_key(key));
 }
 
 static inline int compare_tcp_v4(const void *t1, const void *t2)
 {
-    struct tcp_endpoint_v4 *endp1 = (struct tcp_endpoint_v4 *) t1;
-    struct tcp_endpoint_v4 *endp2 = (struct tcp_endpoint_v4 *) t2;
-
-    if ((endp1->src == endp2->src && endp1->dst == endp2->dst &&
-         endp1->sport == endp2->sport && endp1->dport == endp2->dport)
-        || (endp1->src == endp2->dst && endp1->sport == endp2->dport &&
-            endp1->dst == endp2->src && endp1->dport == endp2->sport)) {
-        return 0;
-    }
-    return (endp1->src + endp1->dst + endp1->sport + endp1->dport) -
-        (endp2->src + endp2->dst + endp2->sport + endp2->dport);
+    struct tcp_flow_key k1 = tcp_flow_key(t1);
+    struct tcp_flow_key k2 = tcp_flow_key(t2);
+
+    if (k1.addrs != k2.addrs)
+        return k1.addrs < k2.addrs ? -1 : 1;
+    if (k1.ports != k2.ports)
+        return k1.ports < k2.ports ? -1 : 1;
+    return 0;
 }
 
 /* Initialize the TCP analyzer */
@@ -69,8 +108,8 @@ void tcp_analyzer_init(void);
 /* Analyze the packet and if TCP store the connection in a table */
 void tcp_analyzer_check_stream(const struct packet *p);
 
-/* Return the connection table */
-hashmap_t *tcp_analyzer_get_sessions(void);
+/* Return the connection table. The values are struct tcp_connection_v4 */
+flowmap_t *tcp_analyzer_get_sessions(void);
 
 /* Return the connection based on the given endpoint, or NULL if not found */
 struct tcp_connection_v4 *tcp_analyzer_get_connection(struct tcp_endpoint_v4 *endp);
@@ -81,12 +120,30 @@ struct tcp_connection_v4 *tcp_analyzer_create_connection(struct tcp_endpoint_v4
 /* Remove a connection */
 void tcp_analyzer_remove_connection(struct tcp_endpoint_v4 *endp);
 
+/*
+ * Remove the packets with a number less than or equal to num from the
+ * connections, and remove the connections that no longer have any packets
+ */
+void tcp_analyzer_evict(uint32_t num);
+
+/* Keep the connection when its packets are evicted, e.g. while it is shown */
+void tcp_analyzer_ref(struct tcp_connection_v4 *conn);
+
+/* Release a reference taken with tcp_analyzer_ref */
+void tcp_analyzer_unref(struct tcp_connection_v4 *conn);
+
 /* Subscribe to connection changes, e.g. more data or state changes */
 void tcp_analyzer_subscribe(analyzer_conn_fn fn);
 
 /* Unsubscribe to TCP connection changes */
 void tcp_analyzer_unsubscribe(analyzer_conn_fn fn);
 
+/* Subscribe to removed connections */
+void tcp_analyzer_subscribe_remove(analyzer_remove_fn fn);
+
+/* Unsubscribe to removed connections */
+void tcp_analyzer_unsubscribe_remove(analyzer_remove_fn fn);
+
 /* Return the connection state */
 char *tcp_analyzer_get_connection_state(enum connection_state);
 
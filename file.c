@@ -8,10 +8,13 @@
 #include <ctype.h>
 #include "file.h"
 #include "misc.h"
+#include "util.h"
 #include "decoder/decoder.h"
+#include "compress.h"
 
 #define BUFSIZE 128 * 1024
-#define MAGIC_NUMBER 0xa1b2c3d4
+#define MAGIC_NUMBER 0xa1b2c3d4    /* microsecond timestamps */
+#define MAGIC_NUMBER_NS 0xa1b23c4d /* nanosecond timestamps */
 #define MAJOR_VERSION 2
 #define MINOR_VERSION 4
 #define TZ 0
@@ -31,12 +34,13 @@ typedef struct pcap_hdr_s {
 /* header for each captured packet */
 typedef struct pcaprec_hdr_s {
     uint32_t ts_sec;         /* timestamp seconds */
-    uint32_t ts_usec;        /* timestamp microseconds */
+    uint32_t ts_frac;        /* timestamp microseconds or nanoseconds */
     uint32_t incl_len;       /* number of octets of packet saved in file */
     uint32_t orig_len;       /* actual length of packet */
 } pcaprec_hdr_t;
 
 static bool swap_bytes = false;
+static bool nsec_resolution = false;
 static packet_handler pkt_handler;
 
 static int read_buf(iface_handle_t *handle, unsigned char *buf, size_t len);
@@ -95,11 +99,24 @@ enum file_error read_header(iface_handle_t *handle, unsigned char *buf, size_t l
     if (len < sizeof(pcap_hdr_t)) return FORMAT_ERROR;
 
     file_header = (pcap_hdr_t *) buf;
-    if (file_header->magic_number == 0xa1b2c3d4) {
+    switch (file_header->magic_number) {
+    case MAGIC_NUMBER:
         swap_bytes = false;
-    } else if (file_header->magic_number == 0xd4c3b2a1) {
+        nsec_resolution = false;
+        break;
+    case 0xd4c3b2a1:
         swap_bytes = true;
-    } else {
+        nsec_resolution = false;
+        break;
+    case MAGIC_NUMBER_NS:
+        swap_bytes = false;
+        nsec_resolution = true;
+        break;
+    case 0x4d3cb2a1:
+        swap_bytes = true;
+        nsec_resolution = true;
+        break;
+    default:
         return FORMAT_ERROR;
     }
     if ((handle->linktype = get_linktype(file_header)) != LINKTYPE_ETHERNET) {
@@ -118,8 +135,9 @@ int read_buf(iface_handle_t *handle, unsigned char *buf, size_t len)
 
     while (n > 0) {
         uint32_t pkt_len;
+        uint32_t orig_len;
         pcaprec_hdr_t *pkt_hdr;
-        struct timeval t;
+        struct timespec t;
 
         if (n < sizeof(pcaprec_hdr_t)) {
             return n;
@@ -135,8 +153,11 @@ int read_buf(iface_handle_t *handle, unsigned char *buf, size_t len)
         buf += sizeof(pcaprec_hdr_t);
         n -= sizeof(pcaprec_hdr_t);
         t.tv_sec = swap_bytes ? ntohl(pkt_hdr->ts_sec) : pkt_hdr->ts_sec;
-        t.tv_usec = swap_bytes ? ntohl(pkt_hdr->ts_usec) : pkt_hdr->ts_usec;
-        if (!pkt_handler(handle, buf, pkt_len, &t)) {
+        t.tv_nsec = swap_bytes ? ntohl(pkt_hdr->ts_frac) : pkt_hdr->ts_frac;
+        if (!nsec_resolution)
+            t.tv_nsec *= 1000;
+        orig_len = swap_bytes ? ntohl(pkt_hdr->orig_len) : pkt_hdr->orig_len;
+        if (!pkt_handler(handle, buf, pkt_len, MAX(orig_len, pkt_len), &t, 0)) {
             return -1;
         }
         n -= pkt_len;
@@ -146,18 +167,18 @@ int read_buf(iface_handle_t *handle, unsigned char *buf, size_t len)
     return 0;
 }
 
-void file_write_pcap(FILE *fp, vector_t *packets, progress_update fn)
+void file_write_pcap(FILE *fp, svector_t *packets, progress_update fn)
 {
     int bufidx = 0;
     unsigned char buf[BUFSIZE];
 
     write_header(buf);
     bufidx += sizeof(pcap_hdr_t);
-    for (int i = 0; i < vector_size(packets); i++) {
+    for (int i = 0; i < svector_size(packets); i++) {
         struct packet *p;
         int n;
 
-        p = (struct packet *) vector_get(packets, i);
+        p = (struct packet *) svector_get(packets, i);
         n = write_data(buf + bufidx, BUFSIZE - bufidx, p);
         if (!n) { /* write buf to file */
             fwrite(buf, sizeof(unsigned char), bufidx, fp);
@@ -180,7 +201,7 @@ void write_header(unsigned char *buf)
 {
     static pcap_hdr_t header;
 
-    header.magic_number = MAGIC_NUMBER;
+    header.magic_number = MAGIC_NUMBER_NS;
     header.version_major = MAJOR_VERSION;
     header.version_minor = MINOR_VERSION;
     header.thiszone = 0;
@@ -200,13 +221,13 @@ int write_data(unsigned char *buf, unsigned int len, struct packet *p)
 
     /* write pcap header */
     pcap_hdr.ts_sec = p->time.tv_sec;
-    pcap_hdr.ts_usec = p->time.tv_usec;
+    pcap_hdr.ts_frac = p->time.tv_nsec;
     pcap_hdr.incl_len = p->len;
-    pcap_hdr.orig_len = p->len;
+    pcap_hdr.orig_len = p->wirelen;
     memcpy(buf, &pcap_hdr, sizeof(pcaprec_hdr_t));
 
     /* write packet */
-    memcpy(buf + sizeof(pcaprec_hdr_t), p->buf, p->len);
+    memcpy(buf + sizeof(pcaprec_hdr_t), compress_frame(p), p->len);
     return p->len + sizeof(pcaprec_hdr_t);
 }
 
@@ -263,10 +284,10 @@ inline uint16_t get_minor_version(pcap_hdr_t *header)
     return swap_bytes ? ntohs(header->version_minor) : header->version_minor;
 }
 
-void file_write_ascii(FILE *fp, vector_t *packets, progress_update fn)
+void file_write_ascii(FILE *fp, svector_t *packets, progress_update fn)
 {
-    for (int i = 0; i < vector_size(packets); i++) {
-        struct packet *p = vector_get(packets, i);
+    for (int i = 0; i < svector_size(packets); i++) {
+        struct packet *p = get_full_packet(svector_get(packets, i));
         unsigned char *payload = get_adu_payload(p);
         uint16_t len = get_adu_payload_len(p);
 
@@ -281,10 +302,10 @@ void file_write_ascii(FILE *fp, vector_t *packets, progress_update fn)
     }
 }
 
-void file_write_raw(FILE *fp, vector_t *packets, progress_update fn)
+void file_write_raw(FILE *fp, svector_t *packets, progress_update fn)
 {
-    for (int i = 0; i < vector_size(packets); i++) {
-        struct packet *p = vector_get(packets, i);
+    for (int i = 0; i < svector_size(packets); i++) {
+        struct packet *p = get_full_packet(svector_get(packets, i));
         unsigned char *payload = get_adu_payload(p);
         uint16_t len = get_adu_payload_len(p);
 
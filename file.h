@@ -1,7 +1,7 @@
 #ifndef FILE_PCAP_H
 #define FILE_PCAP_H
 
-#include "vector.h"
+#include "svector.h"
 #include "interface.h"
 
 typedef void (*progress_update)(int i);
@@ -39,13 +39,13 @@ char *file_error(enum file_error err);
 enum file_error file_read(iface_handle_t *handle, FILE *fp, packet_handler f);
 
 /* Write packets to file in pcap format */
-void file_write_pcap(FILE *fp, vector_t *packets, progress_update fn);
+void file_write_pcap(FILE *fp, svector_t *packets, progress_update fn);
 
 /* Write packets to file in ascii */
-void file_write_ascii(FILE *fp, vector_t *packets, progress_update fn);
+void file_write_ascii(FILE *fp, svector_t *packets, progress_update fn);
 
 /* Write the raw bytes in packets to file */
-void file_write_raw(FILE *fp, vector_t *packets, progress_update fn);
+void file_write_raw(FILE *fp, svector_t *packets, progress_update fn);
 
 
 #endif
@@ -83,6 +83,68 @@ static inline unsigned int hashfnv_uint64(const void *key)
     return hash;
 }
 
+/*
+ * The key of hash_siphash. It is set to a random value when the first hash map
+ * is created.
+ */
+extern uint64_t hash_key[2];
+
+static inline uint64_t hash_rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+#define SIPROUND                                                        \
+    do {                                                                \
+        v0 += v1; v1 = hash_rotl(v1, 13); v1 ^= v0; v0 = hash_rotl(v0, 32); \
+        v2 += v3; v3 = hash_rotl(v3, 16); v3 ^= v2;                     \
+        v0 += v3; v3 = hash_rotl(v3, 21); v3 ^= v0;                     \
+        v2 += v1; v1 = hash_rotl(v1, 17); v1 ^= v2; v2 = hash_rotl(v2, 32); \
+    } while (0)
+
+/*
+ * SipHash-1-3 of the 16 bytes in m0 and m1, keyed with hash_key. Unlike the
+ * other hash functions here, collisions cannot be produced without knowing the
+ * key, so it is used for keys that come from the network.
+ */
+static inline unsigned int hash_siphash(uint64_t m0, uint64_t m1)
+{
+    uint64_t v0 = hash_key[0] ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = hash_key[1] ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = hash_key[0] ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = hash_key[1] ^ 0x7465646279746573ULL;
+    uint64_t b = (uint64_t) 16 << 56;
+
+    v3 ^= m0;
+    SIPROUND;
+    v0 ^= m0;
+    v3 ^= m1;
+    SIPROUND;
+    v0 ^= m1;
+    v3 ^= b;
+    SIPROUND;
+    v0 ^= b;
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    b = v0 ^ v1 ^ v2 ^ v3;
+    return b ^ (b >> 32);
+}
+
+#undef SIPROUND
+
+/* The finalizer of MurmurHash3. All bits of the input affect all bits of the hash */
+static inline uint32_t hash_mix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
 static inline int compare_uint(const void *e1, const void *e2)
 {
     return PTR_TO_UINT(e1) - PTR_TO_UINT(e2);
@@ -1,6 +1,10 @@
+#include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#include <unistd.h>
 #include "hashmap.h"
 #include "hash.h"
 #include "util.h"
@@ -20,18 +24,58 @@ struct hashmap {
     hashmap_deallocate free_data;
     unsigned int count;
     unsigned int buckets;
+
+    /*
+     * When the table is resized, the elements are moved from the old table a
+     * few buckets at a time, see move_buckets. Until then both tables are
+     * searched.
+     */
+    struct hash_elem *old;
+    unsigned int old_buckets;
+    unsigned int moved; /* the buckets of the old table before this are empty */
 };
 
+#define MOVE_STEPS 8 /* buckets or elements moved by every operation on the map */
+
 static bool insert_elem(hashmap_t *map, struct hash_elem *tbl, unsigned int size,
                         unsigned int hash_val, void *key, void *data, bool update);
-static struct hash_elem *find_elem(hashmap_t *map, void *key);
+static struct hash_elem *find_elem(hashmap_t *map, void *key, unsigned int hash);
+static struct hash_elem *find_in_table(hashmap_t *map, struct hash_elem *tbl,
+                                       unsigned int size, void *key, unsigned int hash);
+static void remove_elem(struct hash_elem *tbl, unsigned int size, unsigned int i);
+static void move_buckets(hashmap_t *map, unsigned int steps);
 static inline const hashmap_iterator *get_next_iterator(hashmap_t *map, int i);
 static inline const hashmap_iterator *get_prev_iterator(hashmap_t *map, int i);
 
+uint64_t hash_key[2];
+
+static void init_hash_key(void)
+{
+    struct timespec t;
+    int fd;
+
+    if ((fd = open("/dev/urandom", O_RDONLY)) >= 0) {
+        if (read(fd, hash_key, sizeof(hash_key)) == sizeof(hash_key)) {
+            close(fd);
+            return;
+        }
+        close(fd);
+    }
+    clock_gettime(CLOCK_REALTIME, &t);
+    hash_key[0] = (uint64_t) t.tv_sec << 32 ^ t.tv_nsec;
+    hash_key[1] = (uint64_t) getpid() << 32 ^ (uintptr_t) &t;
+}
+
 hashmap_t *hashmap_init(unsigned int size, hash_fn h, hashmap_compare fn)
 {
+    static bool seeded = false;
     hashmap_t *map;
 
+    /* the maps are created by the main thread before any other thread starts */
+    if (!seeded) {
+        init_hash_key();
+        seeded = true;
+    }
     map = malloc(sizeof(hashmap_t));
     map->buckets = clp2(size); /* set the size to a power of 2 */
     map->table = calloc(map->buckets, sizeof(struct hash_elem));
@@ -40,29 +84,57 @@ hashmap_t *hashmap_init(unsigned int size, hash_fn h, hashmap_compare fn)
     map->free_key = NULL;
     map->free_data = NULL;
     map->count = 0;
+    map->old = NULL;
+    map->old_buckets = 0;
+    map->moved = 0;
     return map;
 }
 
 bool hashmap_insert(hashmap_t *map, void *key, void *data)
 {
+    return hashmap_insert_hash(map, key, data, map->hash(key));
+}
+
+/*
+ * Instead of rehashing every element at once when the table grows, which
+ * stalls the caller for milliseconds on large tables, a new table twice the
+ * size is allocated and every following operation moves a few buckets of the
+ * old table to it. The old table is empty before the new one needs to grow.
+ */
+bool hashmap_insert_hash(hashmap_t *map, void *key, void *data, unsigned int hash)
+{
+    struct hash_elem *elem = NULL;
+
+    if (map->old)
+        move_buckets(map, MOVE_STEPS);
+
     /* resize the table if the load factor is greater than 0.8 */
     if ((map->count + 1) > map->buckets / 1.25) {
-        struct hash_elem *tbl;
-        unsigned int capacity;
-
-        capacity = map->buckets * 2;
-        tbl = calloc(capacity, sizeof(struct hash_elem));
-        for (unsigned int j = 0; j < map->buckets; j++) {
-            if (map->table[j].probe_count != 0) {
-                insert_elem(map, tbl, capacity, map->table[j].hash_val,
-                            map->table[j].key, map->table[j].data, false);
-            }
-        }
-        map->buckets = capacity;
-        free(map->table);
-        map->table = tbl;
+        elem = find_elem(map, key, hash);
+    } else if (map->old) {
+        elem = find_in_table(map, map->old, map->old_buckets, key, hash);
+    }
+
+    /* an element in the new table is updated by insert_elem */
+    if (elem) {
+        if (map->free_key)
+            map->free_key(elem->key);
+        if (map->free_data)
+            map->free_data(elem->data);
+        elem->key = key;
+        elem->data = data;
+        return false;
+    }
+    if ((map->count + 1) > map->buckets / 1.25) {
+        if (map->old)
+            move_buckets(map, UINT_MAX);
+        map->old = map->table;
+        map->old_buckets = map->buckets;
+        map->moved = 0;
+        map->buckets *= 2;
+        map->table = calloc(map->buckets, sizeof(struct hash_elem));
     }
-    if (insert_elem(map, map->table, map->buckets, map->hash(key), key, data, true)) {
+    if (insert_elem(map, map->table, map->buckets, hash, key, data, true)) {
         map->count++;
         return true;
     }
@@ -71,47 +143,40 @@ bool hashmap_insert(hashmap_t *map, void *key, void *data)
 
 void hashmap_remove(hashmap_t *map, void *key)
 {
-    struct hash_elem *elem = NULL;
-    unsigned int hash = map->hash(key);
-    unsigned int i;
+    hashmap_remove_hash(map, key, map->hash(key));
+}
 
-    i = hash & (map->buckets - 1);
-    while (map->table[i].probe_count != 0) {
-        if (map->comp(map->table[i].key, key) == 0) {
-            elem = &map->table[i];
-            break;
-        }
-        i = (i + 1) & (map->buckets - 1);
-    }
-    if (elem) {
-        unsigned int free_slot = i;
-        unsigned int pc = 1;
+void hashmap_remove_hash(hashmap_t *map, void *key, unsigned int hash)
+{
+    struct hash_elem *elem;
 
-        if (map->free_key)
-            map->free_key(elem->key);
-        if (map->free_data)
-            map->free_data(elem->data);
-        elem->probe_count = 0;
-        map->count--;
-        i = (i + 1) & (map->buckets - 1);
-        while (map->table[i].probe_count != 0) {
-            if (map->table[i].probe_count > pc) {
-                map->table[free_slot] = map->table[i];
-                map->table[free_slot].probe_count = map->table[i].probe_count - pc;
-                map->table[i].probe_count = 0;
-                free_slot = i;
-                pc = 1;
-            } else {
-                pc++;
-            }
-            i = (i + 1) & (map->buckets - 1);
-        }
-    }
+    if (map->old)
+        move_buckets(map, MOVE_STEPS);
+    if ((elem = find_elem(map, key, hash)) == NULL)
+        return;
+    if (map->free_key)
+        map->free_key(elem->key);
+    if (map->free_data)
+        map->free_data(elem->data);
+    if (map->old && elem >= map->old && elem < map->old + map->old_buckets)
+        remove_elem(map->old, map->old_buckets, elem - map->old);
+    else
+        remove_elem(map->table, map->buckets, elem - map->table);
+    map->count--;
 }
 
 void *hashmap_get(hashmap_t *map, void *key)
 {
-    struct hash_elem *elem = find_elem(map, key);
+    return hashmap_get_hash(map, key, map->hash(key));
+}
+
+void *hashmap_get_hash(hashmap_t *map, void *key, unsigned int hash)
+{
+    struct hash_elem *elem;
+
+    if (map->old)
+        move_buckets(map, MOVE_STEPS);
+    elem = find_elem(map, key, hash);
 
     if (elem)
         return elem->data;
@@ -120,7 +185,7 @@ void *hashmap_get(hashmap_t *map, void *key)
 
 void *hashmap_get_key(hashmap_t *map, void *key)
 {
-    struct hash_elem *elem = find_elem(map, key);
+    struct hash_elem *elem = find_elem(map, key, map->hash(key));
 
     if (elem)
         return elem->key;
@@ -129,7 +194,7 @@ void *hashmap_get_key(hashmap_t *map, void *key)
 
 bool hashmap_contains(hashmap_t *map, void *key)
 {
-    return find_elem(map, key);
+    return find_elem(map, key, map->hash(key));
 }
 
 unsigned int hashmap_size(hashmap_t *map)
@@ -137,8 +202,11 @@ unsigned int hashmap_size(hashmap_t *map)
     return map->count;
 }
 
+/* The iterators are only valid for a single table, so the resize is finished first */
 const hashmap_iterator *hashmap_first(hashmap_t *map)
 {
+    if (map->old)
+        move_buckets(map, UINT_MAX);
     return get_next_iterator(map, 0);
 }
 
@@ -168,7 +236,11 @@ const hashmap_iterator *hashmap_prev(hashmap_t *map, const hashmap_iterator *it)
 
 const hashmap_iterator *hashmap_get_it(hashmap_t *map, void *key)
 {
-    struct hash_elem *elem = find_elem(map, key);
+    struct hash_elem *elem;
+
+    if (map->old)
+        move_buckets(map, UINT_MAX);
+    elem = find_elem(map, key, map->hash(key));
 
     if (elem) {
         return (const hashmap_iterator *) elem;
@@ -178,6 +250,8 @@ const hashmap_iterator *hashmap_get_it(hashmap_t *map, void *key)
 
 void hashmap_clear(hashmap_t *map)
 {
+    if (map->old)
+        move_buckets(map, UINT_MAX);
     for (unsigned int i = 0; i < map->buckets; i++) {
         if (map->table[i].probe_count != 0) {
             if (map->free_key)
@@ -204,7 +278,8 @@ void hashmap_free(hashmap_t *map)
 {
     if (!map)
         return;
-
+    if (map->old)
+        move_buckets(map, UINT_MAX);
     for (unsigned int i = 0; i < map->buckets; i++) {
         if (map->table[i].probe_count != 0) {
             if (map->free_key)
@@ -217,25 +292,84 @@ void hashmap_free(hashmap_t *map)
     free(map);
 }
 
-struct hash_elem *find_elem(hashmap_t *map, void *key)
+struct hash_elem *find_in_table(hashmap_t *map, struct hash_elem *tbl,
+                                unsigned int size, void *key, unsigned int hash)
 {
     unsigned int i;
-    uint32_t hash;
     unsigned int pc = 1;
 
-    hash = map->hash(key);
-    i = hash & (map->buckets - 1);
-    while (map->table[i].probe_count != 0) {
-        if (pc > map->table[i].probe_count)
+    i = hash & (size - 1);
+    while (tbl[i].probe_count != 0) {
+        if (pc > tbl[i].probe_count)
             return NULL;
-        if (map->comp(map->table[i].key, key) == 0)
-            return &map->table[i];
-        i = (i + 1) & (map->buckets - 1);
+        if (map->comp(tbl[i].key, key) == 0)
+            return &tbl[i];
+        i = (i + 1) & (size - 1);
         pc++;
     }
     return NULL;
 }
 
+struct hash_elem *find_elem(hashmap_t *map, void *key, unsigned int hash)
+{
+    struct hash_elem *elem;
+
+    if ((elem = find_in_table(map, map->table, map->buckets, key, hash)) || !map->old)
+        return elem;
+    return find_in_table(map, map->old, map->old_buckets, key, hash);
+}
+
+/* Remove the element in bucket i and shift the following elements back */
+void remove_elem(struct hash_elem *tbl, unsigned int size, unsigned int i)
+{
+    unsigned int free_slot = i;
+    unsigned int pc = 1;
+
+    tbl[i].probe_count = 0;
+    i = (i + 1) & (size - 1);
+    while (tbl[i].probe_count != 0) {
+        if (tbl[i].probe_count > pc) {
+            tbl[free_slot] = tbl[i];
+            tbl[free_slot].probe_count = tbl[i].probe_count - pc;
+            tbl[i].probe_count = 0;
+            free_slot = i;
+            pc = 1;
+        } else {
+            pc++;
+        }
+        i = (i + 1) & (size - 1);
+    }
+}
+
+/*
+ * Move elements from the old table to the new table, in bucket order. Every
+ * step either moves an element or passes an empty bucket. The element in the
+ * first bucket that has not been moved is removed from the old table until
+ * the bucket is empty, so the elements left in the old table can still be found
+ * from their first bucket.
+ */
+void move_buckets(hashmap_t *map, unsigned int steps)
+{
+    struct hash_elem *elem;
+
+    while (steps-- > 0 && map->moved < map->old_buckets) {
+        elem = &map->old[map->moved];
+        if (elem->probe_count == 0) {
+            map->moved++;
+            continue;
+        }
+        insert_elem(map, map->table, map->buckets, elem->hash_val, elem->key,
+                    elem->data, false);
+        remove_elem(map->old, map->old_buckets, map->moved);
+    }
+    if (map->moved == map->old_buckets) {
+        free(map->old);
+        map->old = NULL;
+        map->old_buckets = 0;
+        map->moved = 0;
+    }
+}
+
 static inline void swap(struct hash_elem *elem, void **key, void **data,
                         unsigned int *hash_val, unsigned int *pc)
 {
@@ -331,6 +465,8 @@ hashmap_stat_t hashmap_get_stat(hashmap_t *map)
     hashmap_stat_t stat;
     uint64_t pcc = 0;
 
+    if (map->old)
+        move_buckets(map, UINT_MAX);
     stat.lpc = 0;
     for (unsigned int i = 0; i < map->buckets; i++) {
         if (map->table[i].probe_count != 0) {
@@ -48,6 +48,15 @@ void hashmap_remove(hashmap_t *map, void *key);
 /* Returns element with the specified key */
 void *hashmap_get(hashmap_t *map, void *key);
 
+/*
+ * The following functions take a precomputed hash of the key instead of calling
+ * the hash function, e.g. a flow hash computed by the kernel. The same hash
+ * must be used for a key every time it is inserted, looked up or removed.
+ */
+bool hashmap_insert_hash(hashmap_t *map, void *key, void *data, unsigned int hash);
+void hashmap_remove_hash(hashmap_t *map, void *key, unsigned int hash);
+void *hashmap_get_hash(hashmap_t *map, void *key, unsigned int hash);
+
 /* Returns the key stored in the hash table */
 void *hashmap_get_key(hashmap_t *map, void *key);
 
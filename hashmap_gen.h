@@ -0,0 +1,298 @@
+#ifndef HASHMAP_GEN_H
+#define HASHMAP_GEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "util.h"
+
+/*
+ * Hash maps specialized for a key and value type. Unlike hashmap_t, which
+ * stores void pointers and calls the hash and compare functions through
+ * function pointers, the keys and values are stored in the slots and the hash
+ * and equal functions are inlined.
+ *
+ * HASHMAP_GENERATE(name, key_type, value_type, hash, equal) defines name_t and
+ * the functions below. hash(key) returns a 32-bit hash and equal(k1, k2)
+ * returns true if the keys are equal. The keys are passed by value, so large
+ * keys should be small structs. The map does not free anything stored in it.
+ *
+ *   name_t *name_init(unsigned int size);
+ *   void name_free(name_t *map);
+ *   void name_clear(name_t *map);
+ *   unsigned int name_size(name_t *map);
+ *   value_type *name_get(name_t *map, key_type key);
+ *   bool name_insert(name_t *map, key_type key, value_type value);
+ *   bool name_remove(name_t *map, key_type key);
+ *   struct name_slot *name_first(name_t *map);
+ *   struct name_slot *name_next(name_t *map, struct name_slot *slot);
+ *
+ * name_get returns a pointer to the value, or NULL if the key is not found.
+ * The pointer is valid until the map is changed. name_insert returns true if
+ * the key is inserted and false if its value is updated.
+ *
+ * The slots are probed linearly. Every slot has a metadata byte that is 0 if
+ * the slot is empty and otherwise 0x80 with the upper 7 bits of the hash, and
+ * the metadata is probed 8 bytes at a time. Most slots that do not match are
+ * thereby never read, and an empty byte ends the probe. The first 7 metadata
+ * bytes are mirrored after the last, so a group never wraps around. Removed
+ * entries are filled by shifting the following entries back, so there are no
+ * tombstones.
+ */
+
+#define HASHMAP_GROUP 8
+#define HASHMAP_EMPTY 0
+
+#define HASHMAP_GEN_FOREACH(name, map, slot)                            \
+    for ((slot) = name##_first(map); (slot); (slot) = name##_next(map, (slot)))
+
+static inline uint8_t hashmap_gen_tag(uint32_t hash)
+{
+    return 0x80 | (hash >> 25);
+}
+
+/* The group is loaded in little-endian order, so byte i is bits 8i to 8i + 7 */
+static inline uint64_t hashmap_gen_group(const uint8_t *meta)
+{
+    uint64_t g;
+
+    memcpy(&g, meta, sizeof(g));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    g = __builtin_bswap64(g);
+#endif
+    return g;
+}
+
+/*
+ * Return the bytes in the group that are equal to tag with their high bit set.
+ * A byte that follows a match can be a false positive, which is harmless as the
+ * key is compared anyway.
+ */
+static inline uint64_t hashmap_gen_match(uint64_t g, uint8_t tag)
+{
+    uint64_t x = g ^ (0x0101010101010101ULL * tag);
+
+    return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+}
+
+/* Return the empty bytes in the group with their high bit set */
+static inline uint64_t hashmap_gen_match_empty(uint64_t g)
+{
+    return ~g & 0x8080808080808080ULL;
+}
+
+/* Return the index in the group of the lowest byte in the mask */
+static inline unsigned int hashmap_gen_first(uint64_t mask)
+{
+    return __builtin_ctzll(mask) / 8;
+}
+
+#define HASHMAP_GENERATE(name, key_type, value_type, hash, equal)              \
+    struct name##_slot {                                                        \
+        key_type key;                                                           \
+        value_type value;                                                       \
+    };                                                                          \
+                                                                                \
+    typedef struct name {                                                       \
+        struct name##_slot *slots;                                              \
+        uint8_t *meta;                                                          \
+        unsigned int buckets;                                                   \
+        unsigned int count;                                                     \
+    } name##_t;                                                                 \
+                                                                                \
+    static inline void name##_alloc(name##_t *map, unsigned int buckets)        \
+    {                                                                           \
+        map->buckets = buckets;                                                 \
+        map->slots = malloc(buckets * sizeof(struct name##_slot));              \
+        map->meta = calloc(buckets + HASHMAP_GROUP - 1, 1);                     \
+        map->count = 0;                                                         \
+    }                                                                           \
+                                                                                \
+    static inline name##_t *name##_init(unsigned int size)                      \
+    {                                                                           \
+        name##_t *map = malloc(sizeof(name##_t));                               \
+                                                                                \
+        name##_alloc(map, clp2(MAX(size, HASHMAP_GROUP)));                      \
+        return map;                                                             \
+    }                                                                           \
+                                                                                \
+    static inline void name##_free(name##_t *map)                               \
+    {                                                                           \
+        if (!map)                                                               \
+            return;                                                             \
+        free(map->slots);                                                       \
+        free(map->meta);                                                        \
+        free(map);                                                              \
+    }                                                                           \
+                                                                                \
+    static inline void name##_clear(name##_t *map)                              \
+    {                                                                           \
+        memset(map->meta, HASHMAP_EMPTY, map->buckets + HASHMAP_GROUP - 1);     \
+        map->count = 0;                                                         \
+    }                                                                           \
+                                                                                \
+    static inline unsigned int name##_size(name##_t *map)                       \
+    {                                                                           \
+        return map->count;                                                      \
+    }                                                                           \
+                                                                                \
+    static inline void name##_set_meta(name##_t *map, unsigned int i, uint8_t m) \
+    {                                                                           \
+        map->meta[i] = m;                                                       \
+        if (i < HASHMAP_GROUP - 1)                                              \
+            map->meta[map->buckets + i] = m;                                    \
+    }                                                                           \
+                                                                                \
+    /* Return the slot of the key, or -1 if it is not found */                  \
+    static inline int name##_find(name##_t *map, key_type key, uint32_t h)      \
+    {                                                                           \
+        unsigned int mask = map->buckets - 1;                                   \
+        unsigned int i = h & mask;                                              \
+        uint8_t tag = hashmap_gen_tag(h);                                       \
+                                                                                \
+        for (;;) {                                                              \
+            uint64_t g = hashmap_gen_group(map->meta + i);                      \
+            uint64_t m = hashmap_gen_match(g, tag);                             \
+                                                                                \
+            while (m) {                                                         \
+                unsigned int j = (i + hashmap_gen_first(m)) & mask;             \
+                                                                                \
+                if (equal(map->slots[j].key, key))                              \
+                    return j;                                                   \
+                m &= m - 1;                                                     \
+            }                                                                   \
+            if (hashmap_gen_match_empty(g))                                     \
+                return -1;                                                      \
+            i = (i + HASHMAP_GROUP) & mask;                                     \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    static inline unsigned int name##_find_empty(name##_t *map, uint32_t h)     \
+    {                                                                           \
+        unsigned int mask = map->buckets - 1;                                   \
+        unsigned int i = h & mask;                                              \
+        uint64_t m;                                                             \
+                                                                                \
+        while ((m = hashmap_gen_match_empty(hashmap_gen_group(map->meta + i))) == 0) \
+            i = (i + HASHMAP_GROUP) & mask;                                     \
+        return (i + hashmap_gen_first(m)) & mask;                               \
+    }                                                                           \
+                                                                                \
+    static inline value_type *name##_get(name##_t *map, key_type key)           \
+    {                                                                           \
+        int i = name##_find(map, key, hash(key));                               \
+                                                                                \
+        return i >= 0 ? &map->slots[i].value : NULL;                            \
+    }                                                                           \
+                                                                                \
+    static inline void name##_grow(name##_t *map)                               \
+    {                                                                           \
+        name##_t old = *map;                                                    \
+                                                                                \
+        name##_alloc(map, old.buckets * 2);                                     \
+        for (unsigned int i = 0; i < old.buckets; i++) {                        \
+            if (old.meta[i] != HASHMAP_EMPTY) {                                 \
+                uint32_t h = hash(old.slots[i].key);                            \
+                unsigned int j = name##_find_empty(map, h);                     \
+                                                                                \
+                name##_set_meta(map, j, old.meta[i]);                           \
+                map->slots[j] = old.slots[i];                                   \
+            }                                                                   \
+        }                                                                       \
+        map->count = old.count;                                                 \
+        free(old.slots);                                                        \
+        free(old.meta);                                                         \
+    }                                                                           \
+                                                                                \
+    static inline bool name##_insert(name##_t *map, key_type key, value_type value) \
+    {                                                                           \
+        uint32_t h = hash(key);                                                 \
+        int i;                                                                  \
+                                                                                \
+        if ((i = name##_find(map, key, h)) >= 0) {                              \
+            map->slots[i].value = value;                                        \
+            return false;                                                       \
+        }                                                                       \
+        /* linear probing needs a load factor below 0.75 */                     \
+        if (map->count + 1 > map->buckets / 4 * 3)                              \
+            name##_grow(map);                                                   \
+        i = name##_find_empty(map, h);                                          \
+        name##_set_meta(map, i, hashmap_gen_tag(h));                            \
+        map->slots[i].key = key;                                                \
+        map->slots[i].value = value;                                            \
+        map->count++;                                                           \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline bool name##_remove(name##_t *map, key_type key)               \
+    {                                                                           \
+        unsigned int mask = map->buckets - 1;                                   \
+        unsigned int i, j;                                                      \
+        int k;                                                                  \
+                                                                                \
+        if ((k = name##_find(map, key, hash(key))) < 0)                         \
+            return false;                                                       \
+        i = k;                                                                  \
+        j = i;                                                                  \
+        for (;;) {                                                              \
+            unsigned int home;                                                  \
+                                                                                \
+            j = (j + 1) & mask;                                                 \
+            if (map->meta[j] == HASHMAP_EMPTY)                                  \
+                break;                                                          \
+            home = hash(map->slots[j].key) & mask;                              \
+                                                                                \
+            /* move the entry back unless its home is in (i, j] */              \
+            if (((j - home) & mask) >= ((j - i) & mask)) {                      \
+                name##_set_meta(map, i, map->meta[j]);                          \
+                map->slots[i] = map->slots[j];                                  \
+                i = j;                                                          \
+            }                                                                   \
+        }                                                                       \
+        name##_set_meta(map, i, HASHMAP_EMPTY);                                 \
+        map->count--;                                                           \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline struct name##_slot *name##_next_slot(name##_t *map, unsigned int i) \
+    {                                                                           \
+        for (; i < map->buckets; i++) {                                         \
+            if (map->meta[i] != HASHMAP_EMPTY)                                  \
+                return &map->slots[i];                                          \
+        }                                                                       \
+        return NULL;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline struct name##_slot *name##_first(name##_t *map)               \
+    {                                                                           \
+        return name##_next_slot(map, 0);                                        \
+    }                                                                           \
+                                                                                \
+    static inline struct name##_slot *name##_next(name##_t *map, struct name##_slot *slot) \
+    {                                                                           \
+        return name##_next_slot(map, slot - map->slots + 1);                    \
+    }
+
+/* Maps with 32-bit integer and string keys */
+
+static inline bool equal_uint32(uint32_t k1, uint32_t k2)
+{
+    return k1 == k2;
+}
+
+static inline bool equal_string(const char *k1, const char *k2)
+{
+    return strcmp(k1, k2) == 0;
+}
+
+static inline uint32_t hashmix_string(const char *key)
+{
+    return hash_mix32(hashfnv_string(key));
+}
+
+HASHMAP_GENERATE(u32map, uint32_t, void *, hash_mix32, equal_uint32)
+HASHMAP_GENERATE(strmap, const char *, void *, hashmix_string, equal_string)
+
+#endif
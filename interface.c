@@ -54,6 +54,14 @@ void iface_read_packet(iface_handle_t *handle)
     handle->op->read_packet(handle);
 }
 
+void iface_get_stat(iface_handle_t *handle, struct iface_stat *stat)
+{
+    if (handle->active)
+        handle->op->get_stat(handle, stat);
+    else
+        *stat = handle->stat;
+}
+
 void iface_set_promiscuous(iface_handle_t *handle, char *dev, bool enable)
 {
     handle->op->set_promiscuous(handle, dev, enable);
@@ -9,11 +9,37 @@
 
 #define LINKTYPE_ETHERNET 1
 
-struct timeval;
+struct timespec;
 struct iface_handle;
 
+/*
+ * Called for every packet read from the interface. n is the number of bytes in
+ * buffer, and wirelen the length of the packet on the network, which is larger
+ * if the packet has been truncated. rxhash is the flow hash computed by the
+ * kernel or the NIC, or 0 if it is not available.
+ */
 typedef bool (*packet_handler)(struct iface_handle *handle, unsigned char *buffer,
-                               uint32_t n, struct timeval *t);
+                               uint32_t n, uint32_t wirelen, struct timespec *t,
+                               uint32_t rxhash);
+
+/* Counters for the reads from the interface */
+struct iface_read_stat {
+    uint64_t wakeups;        /* number of reads that returned data */
+    uint64_t blocks;         /* number of ring buffer blocks or recvmmsg batches read */
+    uint64_t budget_hits;    /* number of reads stopped by the read budget */
+    unsigned int max_blocks; /* most blocks/batches read in a single read */
+};
+
+/* Capture statistics */
+struct iface_stat {
+    uint64_t packets;       /* packets seen by the socket, including the dropped */
+    uint64_t drops;         /* packets dropped by the kernel */
+    uint64_t freeze_q;      /* number of times the ring was full and the queue frozen */
+    uint64_t lost_blocks;   /* ring blocks where the kernel reported packet loss */
+    uint64_t backlog_drops; /* packets dropped as the main thread did not keep up */
+    unsigned int ring_fill; /* ring blocks owned by user space at the last read */
+    unsigned int ring_size; /* number of blocks in the ring */
+};
 
 typedef struct iface_handle {
     int fd;
@@ -25,6 +51,13 @@ typedef struct iface_handle {
     unsigned int linktype;
     struct iface_operations *op;
     unsigned int block_num;
+    int fanout; /* fanout group the socket joins, -1 if none */
+    unsigned int fanout_size; /* number of sockets in the fanout group */
+    unsigned int num_handles; /* number of handles that share the memory for the rings */
+    bool busy_poll; /* spin on the ring buffer instead of sleeping in poll */
+    struct iface_read_stat rstat;
+    struct iface_stat stat;
+    void *data; /* private data of the platform implementation */
 } iface_handle_t;
 
 struct iface_operations {
@@ -32,11 +65,18 @@ struct iface_operations {
     void (*close)(iface_handle_t *handle);
     void (*read_packet)(iface_handle_t *handle);
     void (*set_promiscuous)(iface_handle_t *handle, char *device, bool enable);
+    void (*get_stat)(iface_handle_t *handle, struct iface_stat *stat);
 };
 
 /* Create a new interface handle */
 iface_handle_t *iface_handle_create(unsigned char *buf, size_t len, packet_handler fn);
 
+/*
+ * Capture with an AF_XDP socket instead of the default method. Must be called
+ * before the interface is activated. Only supported on Linux.
+ */
+void iface_use_xdp(iface_handle_t *handle);
+
 /* Activate the interface */
 void iface_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf);
 
@@ -44,11 +84,19 @@ void iface_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf);
 void iface_close(iface_handle_t *handle);
 
 /*
- * Read a packet from the network interface card. The iface_handle on_packet
- * callback is called for each packet.
+ * Read packets from the network interface card. The iface_handle on_packet
+ * callback is called for each packet. All the packets that are ready are read,
+ * up to a limit, so the caller is not blocked for too long. In busy-poll mode
+ * this can be called without waiting for the descriptor to become readable.
  */
 void iface_read_packet(iface_handle_t *handle);
 
+/*
+ * Get the capture statistics since the interface was activated. The kernel
+ * counters are read from the interface, so this should be called regularly.
+ */
+void iface_get_stat(iface_handle_t *handle, struct iface_stat *stat);
+
 /* Enable/disable promiscuous mode */
 void iface_set_promiscuous(iface_handle_t *handle, char *dev, bool enable);
 
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include <string.h>
 #include <linux/if_ether.h>
@@ -13,31 +14,85 @@
 #include <linux/if_packet.h>
 #include <linux/net_tstamp.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <stdio.h>
 #include <linux/wireless.h>
 #include "monitor.h"
 #include "interface.h"
+#include "util.h"
+#include "linux_iface.h"
 
-#define BLOCKSIZE (4 * 1024 * 1024)
 #define FRAMESIZE 65536
-#define BLOCKNUMS 64
+#define MB (1024 * 1024)
+
+/*
+ * Ring buffer geometry limits. The ring is sized to hold RING_BUFFER_MS of
+ * traffic at the link speed and grows if it is close to full for FILL_READS
+ * reads in a row.
+ */
+#define MIN_BLOCKSIZE MB
+#define MAX_BLOCKSIZE (4 * MB)
+#define MIN_RING_SIZE (8 * MB)
+#define MAX_RING_SIZE (1024 * MB)
+#define DEFAULT_RING_SIZE (16 * MB) /* used when the link speed is unknown */
+#define RING_BUFFER_MS 250
+#define FILL_THRESHOLD 75 /* percentage of blocks owned by user space */
+#define FILL_READS 8
+
+/* maximum number of blocks read before returning to the caller */
+#define READ_BUDGET 16
+
+/* number of times to check the ring buffer when busy polling */
+#define BUSY_POLL_SPINS 1024
+
+/* microseconds to busy poll the device queue on a blocking receive */
+#define BUSY_POLL_USEC 50
+
+/* number of packets read with a single recvmmsg */
+#define RECV_BATCH 64
+
+/* TPACKET_V3 ring buffer geometry */
+struct ring {
+    unsigned int block_size;
+    unsigned int block_nr;
+    unsigned int retire_tov; /* block retire timeout in ms */
+    unsigned int max_size;   /* the ring will not grow beyond this */
+    unsigned int fill;       /* blocks owned by user space at the last read */
+    unsigned int full_reads; /* consecutive reads above the fill threshold */
+};
+
+/* preallocated message headers and buffers used by recvmmsg */
+struct recv_batch {
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    unsigned char control[RECV_BATCH][CMSG_SPACE(sizeof(struct timespec))];
+    unsigned char *buf;
+};
 
 static void linux_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf);
 static void linux_close(iface_handle_t *handle);
 static void linux_read_packet_mmap(iface_handle_t *handle);
 static void linux_read_packet_recv(iface_handle_t *handle);
-static void linux_set_promiscuous(iface_handle_t *handle, char *dev, bool enable);
+static void linux_get_stat(iface_handle_t *handle, struct iface_stat *stat);
 
 static struct iface_operations linux_op = {
     .activate = linux_activate,
     .close = linux_close,
     .read_packet = linux_read_packet_mmap,
-    .set_promiscuous = linux_set_promiscuous
+    .set_promiscuous = linux_set_promiscuous,
+    .get_stat = linux_get_stat
 };
 
-static struct iovec *iov;
+/* used when PACKET_MMAP is not supported */
+static struct iface_operations linux_op_recv = {
+    .activate = linux_activate,
+    .close = linux_close,
+    .read_packet = linux_read_packet_recv,
+    .set_promiscuous = linux_set_promiscuous,
+    .get_stat = linux_get_stat
+};
 
-/* get the interface number associated with the interface (name -> if_index mapping) */
-static int get_interface_index(char *dev)
+int get_interface_index(char *dev)
 {
     int sockfd;
     struct ifreq ifr;
@@ -53,7 +108,7 @@ static int get_interface_index(char *dev)
     return ifr.ifr_ifindex;
 }
 
-static int map_linktype(unsigned int type)
+int map_linktype(unsigned int type)
 {
     switch (type) {
     case ARPHRD_ETHER:
@@ -64,7 +119,7 @@ static int map_linktype(unsigned int type)
     }
 }
 
-static unsigned int get_linktype(char *dev)
+unsigned int get_linktype(char *dev)
 {
     struct ifreq ifr;
     int sockfd;
@@ -77,38 +132,183 @@ static unsigned int get_linktype(char *dev)
     return ifr.ifr_hwaddr.sa_family;
 }
 
-static bool setup_packet_mmap(iface_handle_t *handle)
+/* Return the link speed in Mbit/s, or 0 if unknown */
+static unsigned int get_link_speed(char *dev)
+{
+    char path[64];
+    FILE *fp;
+    int speed;
+
+    snprintf(path, sizeof(path), "/sys/class/net/%s/speed", dev);
+    if ((fp = fopen(path, "r")) == NULL)
+        return 0;
+    if (fscanf(fp, "%d", &speed) != 1 || speed < 0)
+        speed = 0;
+    fclose(fp);
+    return speed;
+}
+
+/* Return the memory available for new allocations in bytes */
+static uint64_t get_available_memory(void)
+{
+    FILE *fp;
+    char line[128];
+    unsigned long kb;
+
+    if ((fp = fopen("/proc/meminfo", "r")) != NULL) {
+        while (fgets(line, sizeof(line), fp)) {
+            if (sscanf(line, "MemAvailable: %lu kB", &kb) == 1) {
+                fclose(fp);
+                return (uint64_t) kb * 1024;
+            }
+        }
+        fclose(fp);
+    }
+    return (uint64_t) sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+}
+
+/*
+ * Round the size up to a power of two in [min, max]. As max is a power of two,
+ * the result is never larger than max.
+ */
+static inline unsigned int clamp_size(uint64_t size, unsigned int min, unsigned int max)
+{
+    if (size < min)
+        return min;
+    if (size > max)
+        return max;
+    return clp2(size);
+}
+
+/*
+ * Choose the ring buffer geometry based on the link speed and the available
+ * memory. Fast links get bigger blocks and a shorter retire timeout, so that
+ * blocks are handed to user space before they get too large to process.
+ */
+static void ring_policy(iface_handle_t *handle, struct ring *ring, char *dev)
+{
+    unsigned int speed = get_link_speed(dev);
+    uint64_t size, max;
+
+    /*
+     * At most 1/8 of the available memory is shared by all rings, and the
+     * sockets in a fanout group each get their share of the link.
+     */
+    max = get_available_memory() / 8 / handle->num_handles;
+
+    /* the budget is rounded down so that it is not exceeded */
+    ring->max_size = max < MIN_RING_SIZE ? MIN_RING_SIZE :
+        max > MAX_RING_SIZE ? MAX_RING_SIZE : flp2(max);
+    if (speed == 0) {
+        size = DEFAULT_RING_SIZE;
+        ring->block_size = MIN_BLOCKSIZE;
+        ring->retire_tov = 60;
+    } else {
+        size = (uint64_t) speed * 1000000 / 8 * RING_BUFFER_MS / 1000 / handle->fanout_size;
+        ring->block_size = speed > 1000 ? MAX_BLOCKSIZE : MIN_BLOCKSIZE;
+        ring->retire_tov = speed > 1000 ? 10 : 60;
+    }
+    size = clamp_size(size, MIN_RING_SIZE, ring->max_size);
+    ring->block_nr = size / ring->block_size;
+    ring->fill = 0;
+    ring->full_reads = 0;
+    DEBUG("%s: link speed %u Mbit/s, %u sockets, ring %u x %u bytes, retire timeout %u ms",
+          dev, speed, handle->fanout_size, ring->block_nr, ring->block_size, ring->retire_tov);
+}
+
+static bool map_ring(iface_handle_t *handle, struct ring *ring)
 {
-    int val;
     struct tpacket_req3 req = {
-        .tp_block_size = BLOCKSIZE,
-        .tp_block_nr = BLOCKNUMS,
+        .tp_block_size = ring->block_size,
+        .tp_block_nr = ring->block_nr,
         .tp_frame_size = FRAMESIZE,
-        .tp_frame_nr = (BLOCKSIZE * BLOCKNUMS) / FRAMESIZE,
-        .tp_retire_blk_tov = 60, /* timeout in ms */
+        .tp_frame_nr = (ring->block_size / FRAMESIZE) * ring->block_nr,
+        .tp_retire_blk_tov = ring->retire_tov,
         .tp_feature_req_word = TP_FT_REQ_FILL_RXHASH
     };
 
+    if (setsockopt(handle->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1)
+        return false;
+    if ((handle->buf = mmap(NULL, (size_t) req.tp_block_size * req.tp_block_nr,
+                            PROT_READ | PROT_WRITE, MAP_SHARED, handle->fd, 0)) == MAP_FAILED)
+        return false;
+    handle->block_num = 0;
+    return true;
+}
+
+static void unmap_ring(iface_handle_t *handle, struct ring *ring)
+{
+    struct tpacket_req3 req;
+
+    munmap(handle->buf, (size_t) ring->block_size * ring->block_nr);
+
+    /* a request with no blocks releases the ring */
+    memset(&req, 0, sizeof(req));
+    setsockopt(handle->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+}
+
+static bool setup_packet_mmap(iface_handle_t *handle, char *device)
+{
+    int val;
+    struct ring *ring;
+
     val = TPACKET_V3;
     if (setsockopt(handle->fd, SOL_PACKET, PACKET_VERSION, &val, sizeof(val)) == -1)
         return false;
     val = SOF_TIMESTAMPING_RAW_HARDWARE;
     if (setsockopt(handle->fd, SOL_PACKET, PACKET_TIMESTAMP, &val, sizeof(val)) == -1)
         return false;
-    if (setsockopt(handle->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1)
-        return false;
-    if ((handle->buf = mmap(NULL, req.tp_block_size * req.tp_block_nr, PROT_READ | PROT_WRITE,
-                            MAP_SHARED, handle->fd, 0)) == MAP_FAILED)
+    ring = malloc(sizeof(*ring));
+    ring_policy(handle, ring, device);
+    if (!map_ring(handle, ring)) {
+        free(ring);
         return false;
-    iov = malloc(req.tp_block_nr * sizeof(*iov));
-    for (unsigned int i = 0; i < req.tp_block_nr; i++) {
-        iov[i].iov_base = handle->buf + (i * req.tp_block_size);
-        iov[i].iov_len = req.tp_block_size;
     }
+    handle->data = ring;
+    handle->stat.ring_size = ring->block_nr;
     handle->use_zerocopy = true;
     return true;
 }
 
+/*
+ * Recreate the ring with twice the number of blocks. The socket stays bound,
+ * so only the packets in the block the kernel is currently filling are lost.
+ */
+static void grow_ring(iface_handle_t *handle, struct ring *ring)
+{
+    unsigned int block_nr = ring->block_nr;
+
+    if ((uint64_t) ring->block_size * block_nr * 2 > ring->max_size)
+        return;
+    unmap_ring(handle, ring);
+    ring->block_nr = block_nr * 2;
+    if (!map_ring(handle, ring)) {
+        DEBUG("Cannot grow ring to %u blocks: %s", ring->block_nr, strerror(errno));
+        ring->block_nr = block_nr;
+        if (!map_ring(handle, ring))
+            err_sys("mmap error");
+    }
+    DEBUG("Ring resized to %u x %u bytes", ring->block_nr, ring->block_size);
+    __atomic_store_n(&handle->stat.ring_size, ring->block_nr, __ATOMIC_RELAXED);
+    ring->full_reads = 0;
+}
+
+static void setup_recv_batch(iface_handle_t *handle)
+{
+    struct recv_batch *batch;
+
+    batch = calloc(1, sizeof(*batch));
+    batch->buf = malloc(RECV_BATCH * handle->len);
+    for (int i = 0; i < RECV_BATCH; i++) {
+        batch->iov[i].iov_base = batch->buf + i * handle->len;
+        batch->iov[i].iov_len = handle->len;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+        batch->msgs[i].msg_hdr.msg_control = batch->control[i];
+    }
+    handle->data = batch;
+}
+
 iface_handle_t *iface_handle_create(unsigned char *buf, size_t len, packet_handler fn)
 {
     iface_handle_t *handle = calloc(1, sizeof(iface_handle_t));
@@ -118,6 +318,9 @@ iface_handle_t *iface_handle_create(unsigned char *buf, size_t len, packet_handl
     handle->buf = buf;
     handle->len = len;
     handle->on_packet = fn;
+    handle->fanout = -1;
+    handle->fanout_size = 1;
+    handle->num_handles = 1;
     return handle;
 }
 
@@ -131,6 +334,8 @@ void linux_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf)
     if ((type = map_linktype(get_linktype(device))) == -1)
         err_quit("Link type not supported");
     handle->linktype = type;
+    memset(&handle->rstat, 0, sizeof(handle->rstat));
+    memset(&handle->stat, 0, sizeof(handle->stat));
 
     /* SOCK_RAW packet sockets include the link level header */
     if ((handle->fd = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) == -1) {
@@ -144,13 +349,25 @@ void linux_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf)
     if (fcntl(handle->fd, F_SETFL, flag | O_NONBLOCK) == -1) {
         err_sys("fcntl error");
     }
+    if (handle->busy_poll) {
+        n = BUSY_POLL_USEC;
+
+        /* requires CAP_NET_ADMIN to raise the value above the system default */
+        if (setsockopt(handle->fd, SOL_SOCKET, SO_BUSY_POLL, &n, sizeof(n)) == -1) {
+            DEBUG("Cannot set SO_BUSY_POLL: %s", strerror(errno));
+        }
+        n = 1;
+    }
 
-    if (!setup_packet_mmap(handle)) {
+    if (setup_packet_mmap(handle, device)) {
+        handle->op = &linux_op;
+    } else {
         DEBUG("PACKET_MMAP TPACKET_V3 is not supported");
-        handle->op->read_packet = linux_read_packet_recv;
+        handle->op = &linux_op_recv;
+        setup_recv_batch(handle);
 
-        /* get timestamps */
-        if (setsockopt(handle->fd, SOL_SOCKET, SO_TIMESTAMP, &n, sizeof(n)) == -1) {
+        /* get timestamps with nanosecond resolution */
+        if (setsockopt(handle->fd, SOL_SOCKET, SO_TIMESTAMPNS, &n, sizeof(n)) == -1) {
             err_sys("setsockopt error");
         }
     }
@@ -173,65 +390,193 @@ void linux_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf)
     if (bind(handle->fd, (struct sockaddr *) &ll_addr, sizeof(ll_addr)) == -1) {
         err_sys("bind error");
     }
+
+    /*
+     * Spread the packets over all sockets in the fanout group. The hash is
+     * computed over the flow so that both directions of a connection end up
+     * on the same socket. Fragments are defragmented before hashing.
+     */
+    if (handle->fanout >= 0) {
+        int val = (handle->fanout & 0xffff) |
+            (PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16;
+
+        if (setsockopt(handle->fd, SOL_PACKET, PACKET_FANOUT, &val, sizeof(val)) == -1)
+            err_sys("setsockopt error");
+    }
 }
 
 void linux_close(iface_handle_t *handle)
 {
+    DEBUG("Reads: %lu, blocks: %lu, max blocks per read: %u, budget exhausted: %lu",
+          handle->rstat.wakeups, handle->rstat.blocks, handle->rstat.max_blocks,
+          handle->rstat.budget_hits);
     if (handle->use_zerocopy) {
-        munmap(handle->buf, BLOCKSIZE * BLOCKNUMS);
-        free(iov);
+        struct ring *ring = handle->data;
+
+        munmap(handle->buf, (size_t) ring->block_size * ring->block_nr);
+        handle->use_zerocopy = false;
+    } else if (handle->data) {
+        free(((struct recv_batch *) handle->data)->buf);
     }
+    free(handle->data);
+    handle->data = NULL;
     close(handle->fd);
     handle->fd = -1;
 }
 
+static void update_read_stat(iface_handle_t *handle, unsigned int n)
+{
+    if (n > 0) {
+        handle->rstat.wakeups++;
+        handle->rstat.blocks += n;
+        if (n > handle->rstat.max_blocks)
+            handle->rstat.max_blocks = n;
+        if (n == READ_BUDGET)
+            handle->rstat.budget_hits++;
+    }
+}
+
+/*
+ * Read up to RECV_BATCH packets with a single system call. If the batch is
+ * filled, the socket is read again until it is empty or the read budget is
+ * used.
+ */
 void linux_read_packet_recv(iface_handle_t *handle)
 {
-    struct mmsghdr msg;
-    struct iovec iov;
-    unsigned char data[64];
+    struct recv_batch *batch = handle->data;
     struct cmsghdr *cmsg;
-    struct timeval *val = NULL;
-
-    iov.iov_base = handle->buf;
-    iov.iov_len = handle->len;
-    memset(&msg, 0, sizeof(struct mmsghdr));
-    msg.msg_hdr.msg_iov = &iov;
-    msg.msg_hdr.msg_iovlen = 1;
-    msg.msg_hdr.msg_control = data;
-    msg.msg_hdr.msg_controllen = 64;
-    if (recvmmsg(handle->fd, &msg, 1, 0, NULL) == -1) {
-        err_sys("recvmmsg error");
-    }
-    for (cmsg = CMSG_FIRSTHDR(&msg.msg_hdr); cmsg != NULL;
-         cmsg = CMSG_NXTHDR(&msg.msg_hdr, cmsg)) {
-        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMP) {
-            val = (struct timeval *) CMSG_DATA(cmsg);
-            break;
+    struct timespec *val;
+    struct timespec now;
+    unsigned int nbatches = 0;
+    int n;
+
+    do {
+        for (int i = 0; i < RECV_BATCH; i++)
+            batch->msgs[i].msg_hdr.msg_controllen = sizeof(batch->control[i]);
+        if ((n = recvmmsg(handle->fd, batch->msgs, RECV_BATCH, MSG_DONTWAIT | MSG_TRUNC, NULL)) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                break;
+            err_sys("recvmmsg error");
+        }
+        for (int i = 0; i < n; i++) {
+            struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+
+            val = NULL;
+            for (cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                    val = (struct timespec *) CMSG_DATA(cmsg);
+                    break;
+                }
+            }
+            if (!val) {
+                clock_gettime(CLOCK_REALTIME, &now);
+                val = &now;
+            }
+            /* with MSG_TRUNC msg_len is the length of the packet on the network */
+            handle->on_packet(handle, batch->iov[i].iov_base,
+                              MIN(batch->msgs[i].msg_len, handle->len), batch->msgs[i].msg_len,
+                              val, 0);
+
+            /* dropped packets are counted by the kernel, see linux_get_stat */
         }
+        nbatches++;
+    } while (n == RECV_BATCH && nbatches < READ_BUDGET);
+    update_read_stat(handle, nbatches);
+}
+
+static inline struct tpacket_block_desc *get_block(iface_handle_t *handle, struct ring *ring,
+                                                   unsigned int i)
+{
+    return (struct tpacket_block_desc *) (handle->buf + (size_t) i * ring->block_size);
+}
+
+static inline bool block_ready(struct tpacket_block_desc *bd)
+{
+    return __atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER;
+}
+
+/* Return the number of blocks, starting at the current block, owned by user space */
+static unsigned int ring_fill(iface_handle_t *handle, struct ring *ring)
+{
+    unsigned int n = 0;
+    unsigned int i = handle->block_num;
+
+    while (n < ring->block_nr && block_ready(get_block(handle, ring, i))) {
+        n++;
+        i = (i + 1) & (ring->block_nr - 1);
     }
-    // TODO: Should log dropped packets
-    handle->on_packet(handle, handle->buf, msg.msg_len, val);
+    return n;
 }
 
+/*
+ * Read all blocks owned by user space, starting at the current block, until a
+ * block owned by the kernel is found or the read budget is used. The packets
+ * are decoded directly from the ring, so a block is not returned to the kernel
+ * until all its packets have been handled.
+ */
 void linux_read_packet_mmap(iface_handle_t *handle)
 {
+    struct ring *ring = handle->data;
     struct tpacket_block_desc *bd;
     struct tpacket3_hdr *hdr;
-    struct timeval val;
+    struct timespec val;
+    unsigned int nblocks = 0;
 
-    bd = (struct tpacket_block_desc *) iov[handle->block_num].iov_base;
-    if ((bd->hdr.bh1.block_status & TP_STATUS_USER) == 0)
-        return;
-    hdr = (struct tpacket3_hdr *) ((unsigned char *) bd + bd->hdr.bh1.offset_to_first_pkt);
-    for (unsigned int i = 0; i < bd->hdr.bh1.num_pkts; i++) {
-        val.tv_sec = hdr->tp_sec;
-        val.tv_usec = hdr->tp_nsec;
-        handle->on_packet(handle, (unsigned char *) hdr + hdr->tp_mac, hdr->tp_snaplen, &val);
-        hdr = (struct tpacket3_hdr *) ((unsigned char *) hdr + hdr->tp_next_offset);
+    bd = get_block(handle, ring, handle->block_num);
+    if (handle->busy_poll) {
+        for (int i = 0; i < BUSY_POLL_SPINS && !block_ready(bd); i++)
+            ;
+    }
+    ring->fill = ring_fill(handle, ring);
+    __atomic_store_n(&handle->stat.ring_fill, ring->fill, __ATOMIC_RELAXED);
+    if (ring->fill * 100 >= ring->block_nr * FILL_THRESHOLD)
+        ring->full_reads++;
+    else if (ring->fill > 0)
+        ring->full_reads = 0;
+    while (nblocks < READ_BUDGET && block_ready(bd)) {
+        if (bd->hdr.bh1.block_status & TP_STATUS_LOSING)
+            __atomic_fetch_add(&handle->stat.lost_blocks, 1, __ATOMIC_RELAXED);
+        hdr = (struct tpacket3_hdr *) ((unsigned char *) bd + bd->hdr.bh1.offset_to_first_pkt);
+        for (unsigned int i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+            val.tv_sec = hdr->tp_sec;
+            val.tv_nsec = hdr->tp_nsec;
+            handle->on_packet(handle, (unsigned char *) hdr + hdr->tp_mac, hdr->tp_snaplen,
+                              hdr->tp_len, &val, hdr->hv1.tp_rxhash);
+            hdr = (struct tpacket3_hdr *) ((unsigned char *) hdr + hdr->tp_next_offset);
+        }
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        handle->block_num = (handle->block_num + 1) & (ring->block_nr - 1);
+        bd = get_block(handle, ring, handle->block_num);
+        nblocks++;
+    }
+    update_read_stat(handle, nblocks);
+
+    /* only resize when the ring has been drained */
+    if (ring->full_reads >= FILL_READS && !block_ready(bd))
+        grow_ring(handle, ring);
+}
+
+/*
+ * The kernel resets the counters when they are read, so they are accumulated in
+ * the handle. The ring counters are updated by the thread reading the socket.
+ */
+void linux_get_stat(iface_handle_t *handle, struct iface_stat *stat)
+{
+    union tpacket_stats_u st;
+    socklen_t len = sizeof(st);
+
+    if (getsockopt(handle->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+        handle->stat.packets += st.stats1.tp_packets;
+        handle->stat.drops += st.stats1.tp_drops;
+        if (handle->use_zerocopy)
+            handle->stat.freeze_q += st.stats3.tp_freeze_q_cnt;
     }
-    bd->hdr.bh1.block_status = TP_STATUS_KERNEL;
-    handle->block_num = (handle->block_num + 1) & (BLOCKNUMS - 1);
+    stat->packets = handle->stat.packets;
+    stat->drops = handle->stat.drops;
+    stat->freeze_q = handle->stat.freeze_q;
+    stat->lost_blocks = __atomic_load_n(&handle->stat.lost_blocks, __ATOMIC_RELAXED);
+    stat->ring_fill = __atomic_load_n(&handle->stat.ring_fill, __ATOMIC_RELAXED);
+    stat->ring_size = __atomic_load_n(&handle->stat.ring_size, __ATOMIC_RELAXED);
 }
 
 void linux_set_promiscuous(iface_handle_t *handle UNUSED, char *dev, bool enable)
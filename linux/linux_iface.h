@@ -0,0 +1,24 @@
+#ifndef LINUX_IFACE_H
+#define LINUX_IFACE_H
+
+#include <stdbool.h>
+
+struct iface_handle;
+
+/*
+ * Helpers shared by the Linux capture backends, i.e. packet sockets in
+ * interface.c and AF_XDP sockets in xdp.c
+ */
+
+/* Get the interface number associated with the interface (name -> if_index mapping) */
+int get_interface_index(char *dev);
+
+/* Return the ARPHRD type of the interface, or -1 on error */
+unsigned int get_linktype(char *dev);
+
+/* Map the ARPHRD type to the pcap link type, or -1 if it's not supported */
+int map_linktype(unsigned int type);
+
+void linux_set_promiscuous(struct iface_handle *handle, char *dev, bool enable);
+
+#endif
@@ -278,6 +278,21 @@ static void update_cache(struct tcp_connection_v4 *conn, bool new_conn)
     }
 }
 
+static void remove_conn(struct tcp_connection_v4 *conn)
+{
+    const hashmap_iterator *it;
+
+    if (conn->endp->src != ctx.local_addr->sin_addr.s_addr &&
+        conn->endp->dst != ctx.local_addr->sin_addr.s_addr)
+        return;
+    HASHMAP_FOREACH(proc_cache, it) {
+        struct process *p = it->data;
+
+        if (p->conn)
+            list_remove(p->conn, conn, NULL);
+    }
+}
+
 static bool netlink_init(void)
 {
     struct sockaddr_nl nl_addr = {
@@ -324,6 +339,7 @@ void process_init(void)
     hashmap_set_free_data(proc_cache, free_process);
     hashmap_set_free_key(tcp_cache, free);
     tcp_analyzer_subscribe(update_cache);
+    tcp_analyzer_subscribe_remove(remove_conn);
     netlink_init();
 }
 
@@ -346,5 +362,6 @@ void process_free(void)
     hashmap_free(proc_cache);
     hashmap_free(proc_conn);
     tcp_analyzer_unsubscribe(update_cache);
+    tcp_analyzer_unsubscribe_remove(remove_conn);
     close(nl_sockfd);
 }
@@ -0,0 +1,414 @@
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+
+/* the kernel's eBPF instruction conflicts with the classic BPF instruction in bpf/bpf.h */
+#define bpf_insn ebpf_insn
+#include <linux/bpf.h>
+#undef bpf_insn
+
+#include "monitor.h"
+#include "interface.h"
+#include "linux_iface.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/*
+ * UMEM geometry. Every frame holds one packet, so packets larger than
+ * FRAME_SIZE are dropped by the kernel.
+ */
+#define FRAME_SIZE 4096
+#define NUM_FRAMES 4096
+#define FILL_RING_SIZE NUM_FRAMES
+#define COMP_RING_SIZE 64 /* unused, but needs to be set up to bind the socket */
+#define RX_RING_SIZE (NUM_FRAMES / 2)
+
+/* maximum number of descriptors read before returning to the caller */
+#define READ_BUDGET 1024
+
+#define MAX_QUEUES 64
+
+/* producer/consumer ring shared with the kernel */
+struct xsk_ring {
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *desc;
+    uint32_t mask;
+    void *map;
+    size_t map_len;
+};
+
+struct xsk {
+    unsigned char *umem;
+    struct xsk_ring fill;
+    struct xsk_ring comp;
+    struct xsk_ring rx;
+    unsigned int queue;
+    uint64_t received;
+};
+
+/*
+ * The XDP program and the map of AF_XDP sockets are shared by all sockets on
+ * the interface. The program redirects the packets on a queue to the socket
+ * bound to that queue, and passes them to the network stack if there is none.
+ */
+static struct {
+    int map_fd;
+    int prog_fd;
+    int link_fd;
+    int ifindex;
+    unsigned int refcount;
+    uint64_t queues; /* the queues with a socket bound to them */
+} xdp = { -1, -1, -1, 0, 0, 0 };
+
+static void xdp_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf);
+static void xdp_close(iface_handle_t *handle);
+static void xdp_read_packet(iface_handle_t *handle);
+static void xdp_get_stat(iface_handle_t *handle, struct iface_stat *stat);
+
+static struct iface_operations xdp_op = {
+    .activate = xdp_activate,
+    .close = xdp_close,
+    .read_packet = xdp_read_packet,
+    .set_promiscuous = linux_set_promiscuous,
+    .get_stat = xdp_get_stat
+};
+
+static inline int sys_bpf(int cmd, union bpf_attr *attr)
+{
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int create_xskmap(void)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = MAX_QUEUES;
+    return sys_bpf(BPF_MAP_CREATE, &attr);
+}
+
+/*
+ * return bpf_redirect_map(&xskmap, ctx->rx_queue_index, XDP_PASS);
+ */
+static int load_program(int map_fd)
+{
+    struct ebpf_insn prog[] = {
+        { BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1,
+          offsetof(struct xdp_md, rx_queue_index), 0 },
+        { BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, map_fd },
+        { 0, 0, 0, 0, 0 },
+        { BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS },
+        { BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map },
+        { BPF_JMP | BPF_EXIT, 0, 0, 0, 0 }
+    };
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t) (uintptr_t) prog;
+    attr.insn_cnt = ARRAY_SIZE(prog);
+    attr.license = (uint64_t) (uintptr_t) "Dual MIT/GPL";
+    return sys_bpf(BPF_PROG_LOAD, &attr);
+}
+
+/* Attach the program in driver mode if supported, else in generic (SKB) mode */
+static int attach_program(int prog_fd, int ifindex)
+{
+    union bpf_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = XDP_FLAGS_DRV_MODE;
+    if ((fd = sys_bpf(BPF_LINK_CREATE, &attr)) >= 0)
+        return fd;
+    DEBUG("Cannot attach XDP program in driver mode: %s", strerror(errno));
+    attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+    return sys_bpf(BPF_LINK_CREATE, &attr);
+}
+
+static void setup_program(char *device, int ifindex)
+{
+    if (xdp.refcount++ > 0) {
+        if (xdp.ifindex != ifindex)
+            err_quit("AF_XDP capture is only supported on one interface");
+        return;
+    }
+    xdp.ifindex = ifindex;
+    if ((xdp.map_fd = create_xskmap()) == -1)
+        err_sys("Cannot create XSKMAP");
+    if ((xdp.prog_fd = load_program(xdp.map_fd)) == -1)
+        err_sys("Cannot load XDP program");
+    if ((xdp.link_fd = attach_program(xdp.prog_fd, ifindex)) == -1)
+        err_sys("Cannot attach XDP program to %s", device);
+}
+
+static void release_program(void)
+{
+    if (--xdp.refcount > 0)
+        return;
+
+    /* the program is detached when the last reference to the link is closed */
+    close(xdp.link_fd);
+    close(xdp.prog_fd);
+    close(xdp.map_fd);
+    xdp.link_fd = xdp.prog_fd = xdp.map_fd = -1;
+}
+
+/* Return the lowest queue without a socket */
+static unsigned int alloc_queue(char *device)
+{
+    unsigned int queue;
+
+    if (xdp.queues == ~0ULL)
+        err_quit("Too many AF_XDP sockets on %s", device);
+    queue = __builtin_ctzll(~xdp.queues);
+    xdp.queues |= 1ULL << queue;
+    return queue;
+}
+
+static void free_queue(unsigned int queue)
+{
+    xdp.queues &= ~(1ULL << queue);
+}
+
+static void add_socket(int fd, uint32_t queue)
+{
+    union bpf_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xdp.map_fd;
+    attr.key = (uint64_t) (uintptr_t) &queue;
+    attr.value = (uint64_t) (uintptr_t) &fd;
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) == -1)
+        err_sys("Cannot add AF_XDP socket to XSKMAP");
+}
+
+static void map_ring(int fd, struct xsk_ring *ring, struct xdp_ring_offset *off,
+                     size_t desc_size, uint32_t size, off_t pgoff)
+{
+    ring->map_len = off->desc + size * desc_size;
+    ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd, pgoff);
+    if (ring->map == MAP_FAILED)
+        err_sys("mmap error");
+    ring->producer = (uint32_t *) ((unsigned char *) ring->map + off->producer);
+    ring->consumer = (uint32_t *) ((unsigned char *) ring->map + off->consumer);
+    ring->flags = (uint32_t *) ((unsigned char *) ring->map + off->flags);
+    ring->desc = (unsigned char *) ring->map + off->desc;
+    ring->mask = size - 1;
+}
+
+static void setup_umem(iface_handle_t *handle, struct xsk *xsk)
+{
+    struct xdp_umem_reg reg;
+    struct xdp_mmap_offsets off;
+    socklen_t len = sizeof(off);
+    uint32_t n;
+    uint64_t *addr;
+
+    xsk->umem = mmap(NULL, (size_t) NUM_FRAMES * FRAME_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (xsk->umem == MAP_FAILED)
+        err_sys("mmap error");
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t) (uintptr_t) xsk->umem;
+    reg.len = (uint64_t) NUM_FRAMES * FRAME_SIZE;
+    reg.chunk_size = FRAME_SIZE;
+    if (setsockopt(handle->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) == -1)
+        err_sys("setsockopt XDP_UMEM_REG error");
+    n = FILL_RING_SIZE;
+    if (setsockopt(handle->fd, SOL_XDP, XDP_UMEM_FILL_RING, &n, sizeof(n)) == -1)
+        err_sys("setsockopt XDP_UMEM_FILL_RING error");
+    n = COMP_RING_SIZE;
+    if (setsockopt(handle->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &n, sizeof(n)) == -1)
+        err_sys("setsockopt XDP_UMEM_COMPLETION_RING error");
+    n = RX_RING_SIZE;
+    if (setsockopt(handle->fd, SOL_XDP, XDP_RX_RING, &n, sizeof(n)) == -1)
+        err_sys("setsockopt XDP_RX_RING error");
+    if (getsockopt(handle->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) == -1)
+        err_sys("getsockopt XDP_MMAP_OFFSETS error");
+    map_ring(handle->fd, &xsk->fill, &off.fr, sizeof(uint64_t), FILL_RING_SIZE,
+             XDP_UMEM_PGOFF_FILL_RING);
+    map_ring(handle->fd, &xsk->comp, &off.cr, sizeof(uint64_t), COMP_RING_SIZE,
+             XDP_UMEM_PGOFF_COMPLETION_RING);
+    map_ring(handle->fd, &xsk->rx, &off.rx, sizeof(struct xdp_desc), RX_RING_SIZE,
+             XDP_PGOFF_RX_RING);
+
+    /* give all frames to the kernel */
+    addr = xsk->fill.desc;
+    for (uint32_t i = 0; i < NUM_FRAMES; i++)
+        addr[i & xsk->fill.mask] = (uint64_t) i * FRAME_SIZE;
+    __atomic_store_n(xsk->fill.producer, NUM_FRAMES, __ATOMIC_RELEASE);
+}
+
+/* Bind the socket to the queue, in zero-copy mode if the driver supports it */
+static void bind_socket(iface_handle_t *handle, char *device, int ifindex, unsigned int queue)
+{
+    struct sockaddr_xdp addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sxdp_family = AF_XDP;
+    addr.sxdp_ifindex = ifindex;
+    addr.sxdp_queue_id = queue;
+    addr.sxdp_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+    if (bind(handle->fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+        handle->use_zerocopy = true;
+        return;
+    }
+    DEBUG("Cannot bind AF_XDP socket in zero-copy mode: %s", strerror(errno));
+    addr.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+    if (bind(handle->fd, (struct sockaddr *) &addr, sizeof(addr)) == -1)
+        err_sys("Cannot bind AF_XDP socket to queue %u on %s", queue, device);
+    handle->use_zerocopy = false;
+}
+
+void iface_use_xdp(iface_handle_t *handle)
+{
+    handle->op = &xdp_op;
+}
+
+/*
+ * Every activated handle gets its own socket bound to the lowest free receive
+ * queue, so the number of handles can't exceed the number of queues on the
+ * device.
+ */
+void xdp_activate(iface_handle_t *handle, char *device, struct bpf_prog *bpf UNUSED)
+{
+    struct xsk *xsk;
+    int ifindex;
+    int type;
+
+    if ((type = map_linktype(get_linktype(device))) == -1)
+        err_quit("Link type not supported");
+    handle->linktype = type;
+    memset(&handle->rstat, 0, sizeof(handle->rstat));
+    memset(&handle->stat, 0, sizeof(handle->stat));
+    ifindex = get_interface_index(device);
+    if ((handle->fd = socket(AF_XDP, SOCK_RAW, 0)) == -1)
+        err_sys("socket error");
+    xsk = calloc(1, sizeof(*xsk));
+    xsk->queue = alloc_queue(device);
+    handle->data = xsk;
+    setup_umem(handle, xsk);
+    bind_socket(handle, device, ifindex, xsk->queue);
+    setup_program(device, ifindex);
+    add_socket(handle->fd, xsk->queue);
+    DEBUG("AF_XDP socket bound to queue %u on %s in %s mode", xsk->queue, device,
+          handle->use_zerocopy ? "zero-copy" : "copy");
+
+    /* the packet filter, if any, is run in user space */
+}
+
+void xdp_close(iface_handle_t *handle)
+{
+    struct xsk *xsk = handle->data;
+    struct iface_stat stat;
+
+    DEBUG("Reads: %lu, batches: %lu, budget exhausted: %lu", handle->rstat.wakeups,
+          handle->rstat.blocks, handle->rstat.budget_hits);
+    xdp_get_stat(handle, &stat);
+    release_program();
+    free_queue(xsk->queue);
+    munmap(xsk->rx.map, xsk->rx.map_len);
+    munmap(xsk->comp.map, xsk->comp.map_len);
+    munmap(xsk->fill.map, xsk->fill.map_len);
+    close(handle->fd);
+    munmap(xsk->umem, (size_t) NUM_FRAMES * FRAME_SIZE);
+    free(xsk);
+    handle->data = NULL;
+    handle->fd = -1;
+    handle->use_zerocopy = false;
+}
+
+/*
+ * Read the packets on the RX ring. The packets are passed to the packet
+ * handler straight from UMEM, and the frames are given back to the kernel on
+ * the fill ring when all packets have been handled.
+ */
+void xdp_read_packet(iface_handle_t *handle)
+{
+    struct xsk *xsk = handle->data;
+    struct xdp_desc *desc = xsk->rx.desc;
+    uint64_t *fill = xsk->fill.desc;
+    uint32_t cons, prod, fprod, n;
+    struct timespec t;
+
+    cons = *xsk->rx.consumer;
+    prod = __atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE);
+    n = prod - cons;
+    __atomic_store_n(&handle->stat.ring_fill, n, __ATOMIC_RELAXED);
+    if (n > READ_BUDGET) {
+        n = READ_BUDGET;
+        handle->rstat.budget_hits++;
+    }
+    if (n > 0) {
+        fprod = *xsk->fill.producer;
+        for (uint32_t i = 0; i < n; i++) {
+            struct xdp_desc *d = &desc[(cons + i) & xsk->rx.mask];
+
+            /*
+             * AF_XDP has no packet timestamps. Every packet is timestamped
+             * when read, so that the packets in a batch keep their order
+             * when merged with the packets of other sockets.
+             */
+            clock_gettime(CLOCK_REALTIME, &t);
+            handle->on_packet(handle, xsk->umem + d->addr, d->len, d->len, &t, 0);
+            fill[(fprod + i) & xsk->fill.mask] = d->addr & ~((uint64_t) FRAME_SIZE - 1);
+        }
+        __atomic_store_n(xsk->rx.consumer, cons + n, __ATOMIC_RELEASE);
+        __atomic_store_n(xsk->fill.producer, fprod + n, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&xsk->received, n, __ATOMIC_RELAXED);
+        handle->rstat.wakeups++;
+        handle->rstat.blocks++;
+    }
+
+    /* the kernel needs a system call to start using the new frames */
+    if (__atomic_load_n(xsk->fill.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)
+        recvfrom(handle->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+}
+
+/*
+ * The kernel counters are not reset when read. ring_fill and ring_size are
+ * given in RX descriptors.
+ */
+void xdp_get_stat(iface_handle_t *handle, struct iface_stat *stat)
+{
+    struct xsk *xsk = handle->data;
+    struct xdp_statistics st;
+    socklen_t len = sizeof(st);
+
+    if (getsockopt(handle->fd, SOL_XDP, XDP_STATISTICS, &st, &len) == 0) {
+        handle->stat.drops = st.rx_dropped + st.rx_ring_full;
+        handle->stat.freeze_q = st.rx_fill_ring_empty_descs;
+    }
+    handle->stat.packets = __atomic_load_n(&xsk->received, __ATOMIC_RELAXED) +
+        handle->stat.drops;
+    handle->stat.ring_size = RX_RING_SIZE;
+    stat->packets = handle->stat.packets;
+    stat->drops = handle->stat.drops;
+    stat->freeze_q = handle->stat.freeze_q;
+    stat->lost_blocks = 0;
+    stat->ring_fill = __atomic_load_n(&handle->stat.ring_fill, __ATOMIC_RELAXED);
+    stat->ring_size = handle->stat.ring_size;
+}
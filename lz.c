@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "lz.h"
+
+/*
+ * The compressed data is a sequence of literal runs, each followed by a match,
+ * i.e. a reference to data earlier in the output. A sequence starts with a
+ * token: the upper 4 bits are the number of literals and the lower 4 bits the
+ * length of the match minus MIN_MATCH. If a field is 15, the length continues
+ * in the following bytes, which are added until a byte is less than 255. Then
+ * come the literals and the 2 byte little-endian offset of the match. The last
+ * sequence only contains literals.
+ */
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_BITS 12
+#define LAST_LITERALS 5 /* a match never extends into the last bytes */
+#define MATCH_LIMIT 12  /* no match is started in the last bytes */
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline unsigned int hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static inline unsigned char *put_length(unsigned char *op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+    return op;
+}
+
+/* Write a sequence. A match length of 0 means the last sequence. */
+static unsigned char *put_sequence(unsigned char *op, unsigned char *oend,
+                                   const unsigned char *lit, size_t nlit,
+                                   size_t offset, size_t mlen)
+{
+    unsigned char *token = op++;
+    size_t ml = mlen ? mlen - MIN_MATCH : 0;
+
+    /* the worst case size of the sequence */
+    if (nlit + nlit / 255 + ml / 255 + 5 > (size_t) (oend - token))
+        return NULL;
+    if (nlit >= 15) {
+        *token = 15 << 4;
+        op = put_length(op, nlit - 15);
+    } else {
+        *token = nlit << 4;
+    }
+    memcpy(op, lit, nlit);
+    op += nlit;
+    if (mlen == 0)
+        return op;
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+    if (ml >= 15) {
+        *token |= 15;
+        op = put_length(op, ml - 15);
+    } else {
+        *token |= ml;
+    }
+    return op;
+}
+
+size_t lz_compress(const unsigned char *src, size_t len, unsigned char *dst, size_t cap)
+{
+    uint32_t table[1 << HASH_BITS];
+    const unsigned char *ip = src;
+    const unsigned char *anchor = src;
+    const unsigned char *end = src + len;
+    const unsigned char *mflimit = len > MATCH_LIMIT ? end - MATCH_LIMIT : src;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + cap;
+
+    memset(table, 0, sizeof(table));
+    while (ip < mflimit) {
+        uint32_t seq = read32(ip);
+        unsigned int h = hash(seq);
+        const unsigned char *ref = src + table[h];
+        const unsigned char *mp, *rp;
+
+        table[h] = ip - src;
+        if (ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != seq) {
+            ip++;
+            continue;
+        }
+        mp = ip + MIN_MATCH;
+        rp = ref + MIN_MATCH;
+        while (mp < end - LAST_LITERALS && *mp == *rp) {
+            mp++;
+            rp++;
+        }
+        if ((op = put_sequence(op, oend, anchor, ip - anchor, ip - ref, mp - ip)) == NULL)
+            return 0;
+        ip = anchor = mp;
+    }
+    if ((op = put_sequence(op, oend, anchor, end - anchor, 0, 0)) == NULL)
+        return 0;
+    return op - dst;
+}
+
+static inline bool get_length(const unsigned char **ip, const unsigned char *iend, size_t *len)
+{
+    unsigned char b;
+
+    do {
+        if (*ip >= iend)
+            return false;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return true;
+}
+
+size_t lz_decompress(const unsigned char *src, size_t len, unsigned char *dst, size_t cap)
+{
+    const unsigned char *ip = src;
+    const unsigned char *iend = src + len;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + cap;
+
+    while (ip < iend) {
+        unsigned char token = *ip++;
+        size_t nlit = token >> 4;
+        size_t mlen = token & 15;
+        size_t offset;
+
+        if (nlit == 15 && !get_length(&ip, iend, &nlit))
+            return 0;
+        if (nlit > (size_t) (iend - ip) || nlit > (size_t) (oend - op))
+            return 0;
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+        if (ip == iend)
+            break;
+        if (iend - ip < 2)
+            return 0;
+        offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst))
+            return 0;
+        if (mlen == 15 && !get_length(&ip, iend, &mlen))
+            return 0;
+        mlen += MIN_MATCH;
+        if (mlen > (size_t) (oend - op))
+            return 0;
+        if (offset >= mlen) {
+            memcpy(op, op - offset, mlen);
+            op += mlen;
+        } else {
+            /* the match overlaps the output, e.g. a run of the same byte */
+            const unsigned char *ref = op - offset;
+
+            while (mlen--)
+                *op++ = *ref++;
+        }
+    }
+    return op - dst;
+}
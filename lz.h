@@ -0,0 +1,24 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+/*
+ * A fast LZ77 codec in the style of LZ4. It favours speed over compression
+ * ratio and is meant for compressing blocks of data that are kept in memory.
+ * The format is not compatible with anything else.
+ */
+
+/*
+ * Compress 'len' bytes from src into dst, which has room for 'cap' bytes.
+ * Returns the compressed size, or 0 if the result does not fit in dst.
+ */
+size_t lz_compress(const unsigned char *src, size_t len, unsigned char *dst, size_t cap);
+
+/*
+ * Decompress the 'len' bytes in src into dst, which has room for 'cap' bytes.
+ * Returns the decompressed size, or 0 if the data is corrupt or does not fit.
+ */
+size_t lz_decompress(const unsigned char *src, size_t len, unsigned char *dst, size_t cap);
+
+#endif
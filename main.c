@@ -19,7 +19,7 @@
 #include "interface.h"
 #include "decoder/packet.h"
 #include "decoder/tcp_analyzer.h"
-#include "vector.h"
+#include "svector.h"
 #include "file.h"
 #include "mempool.h"
 #include "decoder/host_analyzer.h"
@@ -32,8 +32,12 @@
 #include "bpf/pcap_parser.h"
 #include "bpf/genasm.h"
 #include "ui/ui.h"
+#include "capture.h"
+#include "retention.h"
+#include "store.h"
+#include "compress.h"
 
-#define SHORT_OPTS "F:i:f:r:GdhlnNpstv"
+#define SHORT_OPTS "C:D:F:i:f:j:r:R:S:GLbdhlnNpstvx"
 #define BPF_DUMP_MODES 3
 
 enum bpf_dump_mode {
@@ -43,21 +47,27 @@ enum bpf_dump_mode {
     BPF_DUMP_MODE_INT
 };
 
-vector_t *packets;
+svector_t *packets;
 main_context ctx;
 static volatile sig_atomic_t alarm_flag = 0;
 static volatile sig_atomic_t winch_flag = 0;
-static bool fd_changed = false;
 static iface_handle_t *handle = NULL;
 static struct bpf_prog bpf;
 static bool promiscuous_mode = false;
 
 static bool handle_packet(iface_handle_t *handle, unsigned char *buffer,
-                          uint32_t n, struct timeval *t);
+                          uint32_t n, uint32_t wirelen, struct timespec *t,
+                          uint32_t rxhash);
+static void add_packet(struct packet *p);
 static void print_help(char *prg) NORETURN;
 static void setup_signal(int signo, void (*handler)(int), int flags);
 static void run(void);
 static void print_bpf(void) NORETURN;
+static void parse_slice_policy(char *spec);
+static void parse_retention(char *spec);
+static void parse_compress(char *age);
+static void parse_devices(char *list);
+static void set_promiscuous(bool enable);
 
 static void sig_alarm()
 {
@@ -81,12 +91,20 @@ int main(int argc, char **argv)
     int opt;
     int idx;
     static struct option long_options[] = {
+        { "busy-poll", no_argument, NULL, 'b' },
+        { "slice", required_argument, NULL, 'S' },
+        { "compress", required_argument, NULL, 'C' },
+        { "spool", required_argument, NULL, 'D' },
+        { "retention", required_argument, NULL, 'R' },
         { "help", no_argument, NULL, 'h' },
         { "interface", required_argument, NULL, 'i' },
         { "list-interfaces", no_argument, NULL, 'l' },
+        { "lazy-decode", no_argument, NULL, 'L' },
+        { "workers", required_argument, NULL, 'j' },
         { "no-geoip", no_argument, NULL, 'G' },
         { "statistics", no_argument, NULL, 's' },
         { "verbose", no_argument, NULL, 'v' },
+        { "xdp", no_argument, NULL, 'x' },
         { NULL, 0, NULL, 0}
     };
 
@@ -99,16 +117,41 @@ int main(int argc, char **argv)
     ctx.opt.nogeoip = false;
     ctx.opt.show_statistics = false;
     ctx.opt.numeric = false;
+    ctx.opt.num_workers = 0;
+    ctx.opt.busy_poll = false;
+    ctx.opt.xdp = false;
+    ctx.opt.lazy_decode = false;
+    ctx.opt.retain_bytes = 0;
+    ctx.opt.retain_window = 0;
+    ctx.opt.compress_age = 0;
     while ((opt = getopt_long(argc, argv, SHORT_OPTS, long_options, &idx)) != -1) {
         switch (opt) {
+        case 'C':
+            parse_compress(optarg);
+            break;
+        case 'D':
+            ctx.spool = optarg;
+            break;
         case 'F':
             ctx.filter_file = optarg;
             break;
         case 'G':
             ctx.opt.nogeoip = true;
             break;
+        case 'L':
+            ctx.opt.lazy_decode = true;
+            break;
         case 'N':
             break;
+        case 'S':
+            ctx.slice = optarg;
+            break;
+        case 'R':
+            parse_retention(optarg);
+            break;
+        case 'b':
+            ctx.opt.busy_poll = true;
+            break;
         case 'd':
             ctx.opt.dmode++;
             break;
@@ -116,8 +159,20 @@ int main(int argc, char **argv)
             ctx.filter = optarg;
             break;
         case 'i':
-            ctx.device = strdup(optarg);
+            parse_devices(optarg);
+            break;
+        case 'j':
+        {
+            char *endptr;
+            long n;
+
+            errno = 0;
+            n = strtol(optarg, &endptr, 10);
+            if (errno != 0 || *endptr != '\0' || n < 1 || n > MAX_WORKERS)
+                err_quit("The number of workers needs to be between 1 and %d", MAX_WORKERS);
+            ctx.opt.num_workers = n;
             break;
+        }
         case 'l':
             list_interfaces();
             exit(0);
@@ -140,6 +195,9 @@ int main(int argc, char **argv)
         case 'v':
             ctx.opt.verbose = true;
             break;
+        case 'x':
+            ctx.opt.xdp = true;
+            break;
         case 'h':
         default:
             print_help(prg_name);
@@ -153,6 +211,12 @@ int main(int argc, char **argv)
     setup_signal(SIGINT, sig_int, 0);
     mempool_init();
     decoder_init();
+    set_lazy_decoding(ctx.opt.lazy_decode);
+    if (ctx.slice) {
+        if (ctx.opt.lazy_decode)
+            err_quit("Lazy decoding cannot be combined with a slicing policy");
+        parse_slice_policy(ctx.slice);
+    }
     debug_init();
     tcp_analyzer_init();
     dns_cache_init();
@@ -164,7 +228,7 @@ int main(int argc, char **argv)
             process_init();
         setup_signal(SIGWINCH, sig_winch, 0);
     }
-    packets = vector_init(PACKET_TABLE_SIZE);
+    packets = svector_init();
     if (ctx.filter_file) {
         bpf = bpf_assemble(ctx.filter_file);
         if (bpf.size == 0)
@@ -176,20 +240,55 @@ int main(int argc, char **argv)
     }
     if (ctx.opt.dmode > BPF_DUMP_MODE_NONE)
         print_bpf();
-    if (!ctx.device && !(ctx.device = get_default_interface()))
-        err_quit("Cannot find active network device");
+    if (ctx.num_devices == 0) {
+        if (!(ctx.device = get_default_interface()))
+            err_quit("Cannot find active network device");
+        ctx.devices = malloc(sizeof(char *));
+        ctx.devices[ctx.num_devices++] = ctx.device;
+    }
+
+    /*
+     * Capture and decode in a separate thread, so that a slow UI never holds up
+     * the kernel ring. This is also where the packets from several interfaces
+     * are merged. A file is read by the main thread, but a new scan can be
+     * started after it has been read.
+     */
+    if (ctx.opt.num_workers == 0)
+        ctx.opt.num_workers = 1;
+    capture_init(ctx.opt.num_workers, ctx.devices, ctx.num_devices, add_packet);
+    if (retention_enabled() && ctx.opt.load_file)
+        err_quit("The retention policy can only be used when capturing");
+    retention_init(packets);
+    if (ctx.spool) {
+        if (ctx.opt.load_file)
+            err_quit("The spool directory can only be used when capturing");
+        store_open(ctx.spool, packets);
+    }
+    if (ctx.opt.compress_age > 0 && ctx.spool)
+        err_quit("Compression cannot be combined with a spool directory");
+
+    /* the spool file only grows, the space of evicted packets is not reused */
+    if (retention_enabled() && ctx.spool)
+        err_quit("The retention policy cannot be combined with a spool directory");
+
+    /* the packets are decoded again from the spool file, which needs the whole frame */
+    if (ctx.slice && ctx.spool)
+        err_quit("The slicing policy cannot be combined with a spool directory");
+    compress_init(packets, ctx.opt.compress_age);
     ctx.local_addr = malloc(sizeof(struct sockaddr_in));
     get_local_address(ctx.device, (struct sockaddr *) ctx.local_addr);
     get_local_mac(ctx.device, ctx.mac);
     if (!ctx.opt.nogeoip && !geoip_init())
         exit(1);
+
+    /* the handle is used to read files */
+    handle = iface_handle_create(buf, SNAPLEN, handle_packet);
+    ctx.handle = handle;
     if (ctx.opt.load_file) {
         enum file_error err;
         FILE *fp;
 
         ctx.capturing = false;
-        handle = iface_handle_create(buf, SNAPLEN, handle_packet);
-        ctx.handle = handle;
         if ((fp = file_open(ctx.filename, "r", &err)) == NULL)
             err_sys("Error: %s", ctx.filename);
         if ((err = file_read(handle, fp, handle_packet)) != NO_ERROR) {
@@ -201,13 +300,9 @@ int main(int argc, char **argv)
         ui_draw();
     } else {
         ctx.capturing = true;
-        handle = iface_handle_create(buf, SNAPLEN, handle_packet);
-        ctx.handle = handle;
-        iface_activate(handle, ctx.device, &bpf);
-        if (!ctx.opt.nopromiscuous) {
-            iface_set_promiscuous(handle, ctx.device, true);
-            promiscuous_mode = true;
-        }
+        capture_start(&bpf);
+        if (!ctx.opt.nopromiscuous)
+            set_promiscuous(true);
         ui_init();
     }
     run();
@@ -237,27 +332,195 @@ static void print_bpf(void)
     exit(0);
 }
 
+static void parse_devices(char *list)
+{
+    char *str = strdup(list);
+    char *tok, *saveptr;
+
+    for (tok = strtok_r(str, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        if (ctx.num_devices == MAX_DEVICES)
+            err_quit("Cannot capture on more than %d interfaces", MAX_DEVICES);
+        ctx.devices = realloc(ctx.devices, (ctx.num_devices + 1) * sizeof(char *));
+        ctx.devices[ctx.num_devices++] = strdup(tok);
+    }
+    free(str);
+    if (ctx.num_devices == 0)
+        err_quit("No interface given");
+    ctx.device = ctx.devices[0];
+}
+
+static void set_promiscuous(bool enable)
+{
+    for (unsigned int i = 0; i < ctx.num_devices; i++)
+        iface_set_promiscuous(handle, ctx.devices[i], enable);
+    promiscuous_mode = enable;
+}
+
+static bool parse_length(char *str, uint32_t *len)
+{
+    char *endptr;
+    unsigned long n;
+
+    if (strcmp(str, "full") == 0) {
+        *len = SLICE_ALL;
+        return true;
+    }
+    if (strcmp(str, "headers") == 0) {
+        *len = 0;
+        return true;
+    }
+    errno = 0;
+    n = strtoul(str, &endptr, 10);
+    if (errno != 0 || *str == '\0' || *endptr != '\0' || n > UINT32_MAX)
+        return false;
+    *len = n;
+    return true;
+}
+
+/* Parse a number followed by an optional unit, e.g. 10M */
+static bool parse_unit(char *str, const char *units, const uint64_t *scale, uint64_t *val)
+{
+    char *endptr;
+    char *u;
+
+    errno = 0;
+    *val = strtoull(str, &endptr, 10);
+    if (errno != 0 || endptr == str || *val == 0)
+        return false;
+    if (*endptr == '\0')
+        return true;
+    if (endptr[1] != '\0' || (u = strchr(units, *endptr)) == NULL ||
+        *val > UINT64_MAX / scale[u - units])
+        return false;
+    *val *= scale[u - units];
+    return true;
+}
+
+/*
+ * The retention policy is a comma-separated list of:
+ *  size=N[K|M|G]  memory used for the stored packets
+ *  time=N[s|m|h]  how long the packets are kept
+ */
+static void parse_retention(char *spec)
+{
+    static const uint64_t size_scale[] = { 1024, 1024 * 1024, 1024 * 1024 * 1024 };
+    static const uint64_t time_scale[] = { 1, 60, 3600 };
+    char *str = strdup(spec);
+    char *tok, *saveptr;
+    uint64_t val;
+
+    for (tok = strtok_r(str, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        if (strncmp(tok, "size=", 5) == 0 && parse_unit(tok + 5, "KMG", size_scale, &val)) {
+            ctx.opt.retain_bytes = val;
+        } else if (strncmp(tok, "time=", 5) == 0 && parse_unit(tok + 5, "smh", time_scale, &val) &&
+                   val <= UINT_MAX) {
+            ctx.opt.retain_window = val;
+        } else {
+            err_quit("Invalid retention policy: %s", tok);
+        }
+    }
+    free(str);
+}
+
+/* The age of the packets whose frames are compressed: N[s|m|h] */
+static void parse_compress(char *age)
+{
+    static const uint64_t time_scale[] = { 1, 60, 3600 };
+    uint64_t val;
+
+    if (!parse_unit(age, "smh", time_scale, &val) || val > UINT_MAX)
+        err_quit("Invalid compression age: %s", age);
+    ctx.opt.compress_age = val;
+}
+
+/*
+ * The slicing policy is a comma-separated list of:
+ *  N            store at most N bytes of a frame
+ *  headers[+K]  store the headers up to the transport layer and K payload bytes
+ *  proto=K      payload bytes stored for an application protocol. K can also be
+ *               "full" or "headers"
+ */
+static void parse_slice_policy(char *spec)
+{
+    struct slice_policy policy = {
+        .snaplen = UINT32_MAX,
+        .headers = false,
+        .payload = SLICE_ALL
+    };
+    char *str = strdup(spec);
+    char *tok, *saveptr, *val;
+
+    for (tok = strtok_r(str, ",", &saveptr); tok; tok = strtok_r(NULL, ",", &saveptr)) {
+        if (strncmp(tok, "headers", 7) == 0 && (tok[7] == '\0' || tok[7] == '+')) {
+            policy.headers = true;
+            policy.payload = 0;
+            if (tok[7] == '+' && !parse_length(tok + 8, &policy.payload))
+                err_quit("Invalid slicing policy: %s", tok);
+        } else if ((val = strchr(tok, '=')) != NULL) {
+            uint32_t len;
+
+            *val++ = '\0';
+            if (!parse_length(val, &len))
+                err_quit("Invalid slicing policy: %s=%s", tok, val);
+            if (!slice_protocol(tok, len))
+                err_quit("Unknown protocol: %s", tok);
+        } else if (!parse_length(tok, &policy.snaplen) || policy.snaplen == 0 ||
+                   policy.snaplen == SLICE_ALL) {
+            err_quit("Invalid slicing policy: %s", tok);
+        }
+    }
+    set_slice_policy(&policy);
+    free(str);
+}
+
 static void print_help(char *prg)
 {
     geoip_print_version();
-    printf("Usage: %s [-dGhlNnpstv] [-f filter] [-F filter-file] [-i interface] [-r path]\n"
+    printf("Usage: %s [-bdGhLlNnpstvx] [-C age] [-D dir] [-f filter] [-F filter-file]\n"
+           "          [-i interface] [-j workers] [-r path] [-R policy] [-S policy]\n"
            "Options:\n"
+           "     -b, --busy-poll        Poll the interface continuously instead of waiting\n"
+           "                            for packets. Reduces latency but uses a full CPU\n"
+           "     -C, --compress         Compress the packet data in memory when it is older\n"
+           "                            than N[s|m|h], e.g. 30s\n"
            "     -d                     Dump packet filter as BPF assembly and exit\n"
            "     -dd                    Dump packet filter as C code fragment and exit\n"
            "     -ddd                   Dump packet filter as decimal numbers and exit\n"
+           "     -D, --spool            Store the packet data in a file in this directory\n"
+           "                            instead of in memory. The packets are decoded\n"
+           "                            again from the file when they are shown\n"
            "     -F                     Read packet filter from file (BPF assembly)\n"
            "     -f                     Specify packet filter (tcpdump syntax)\n"
            "     -G, --no-geoip         Don't use GeoIP information\n"
            "     -h, --help             Print this help summary\n"
-           "     -i, --interface        Specify network interface\n"
+           "     -i, --interface        Specify network interface. Several interfaces can be\n"
+           "                            given as a comma-separated list\n"
+           "     -j, --workers          Number of threads capturing and decoding packets on\n"
+           "                            every interface (default 1)\n"
+           "     -L, --lazy-decode      Only decode the application layer of a packet when\n"
+           "                            it is shown. Application protocol statistics are\n"
+           "                            then incomplete\n"
            "     -l, --list-interfaces  List available interfaces\n"
            "     -n                     Use numerical addresses\n"
            "     -N                     Only print the hostname (don't print the FQDN)\n"
            "     -p                     Don't put the interface into promiscuous mode\n"
            "     -r                     Read file in pcap format\n"
+           "     -R, --retention        Only keep the most recent packets. The policy is a\n"
+           "                            comma-separated list of size=N[K|M|G] (memory used\n"
+           "                            for packets) and time=N[s|m|h], e.g. size=512M\n"
+           "     -S, --slice            Only store the start of every packet. The policy is a\n"
+           "                            comma-separated list of: N (the first N bytes),\n"
+           "                            headers[+K] (headers up to the transport layer and\n"
+           "                            K bytes of payload) and protocol=K|full|headers,\n"
+           "                            e.g. headers+64,dns=full,tls=headers\n"
            "     -s, --statistics       Show statistics page\n"
            "     -t                     Use normal text output, i.e. don't use ncurses\n"
-           "     -v, --verbose          Print verbose information\n",
+           "     -v, --verbose          Print verbose information\n"
+           "     -x, --xdp              Capture with AF_XDP sockets. The packets are taken\n"
+           "                            from the network stack, so only use this on a\n"
+           "                            mirror port or dedicated capture interface. AF_XDP\n"
+           "                            has no packet timestamps, so the packets are\n"
+           "                            timestamped when read\n",
            prg);
     exit(0);
 }
@@ -277,13 +540,14 @@ static void setup_signal(int signo, void (*handler)(int), int flags)
 static void run(void)
 {
     struct pollfd fds[] = {
-        { handle->fd, POLLIN, 0 },
+        { capture_get_fd(), POLLIN, 0 },
         { STDIN_FILENO, POLLIN, 0 }
     };
 
     while (1) {
         if (alarm_flag) {
             alarm_flag = 0;
+            update_iface_stat();
             ui_event(UI_ALARM);
             alarm(1);
         }
@@ -293,17 +557,16 @@ static void run(void)
             ui_event(UI_RESIZE);
             setup_signal(SIGWINCH, sig_winch, 0);
         }
-        if (fd_changed) {
-            fds[0].fd = handle->fd;
-            fd_changed = false;
-        }
         if (poll(fds, 2, -1) == -1) {
             if (errno == EINTR)
                 continue;
             err_sys("poll error");
         }
-        if (fds[0].revents & POLLIN)
-            iface_read_packet(handle);
+        if (fds[0].revents & POLLIN) {
+            capture_read();
+            retention_evict();
+            store_release();
+        }
         if (fds[1].revents & POLLIN)
             ui_event(UI_INPUT);
     }
@@ -311,8 +574,13 @@ static void run(void)
 
 void finish(int status)
 {
+    update_iface_stat();
+    capture_free();
     ui_fini();
-    vector_free(packets, NULL);
+    retention_free();
+    store_close();
+    compress_free();
+    svector_free(packets, NULL);
     if (!ctx.opt.text_mode && !ctx.opt.load_file)
         process_free();
     host_analyzer_free();
@@ -320,16 +588,14 @@ void finish(int status)
     debug_free();
     tcp_analyzer_free();
     if (promiscuous_mode)
-        iface_set_promiscuous(handle, ctx.device, false);
-    free(ctx.device);
+        set_promiscuous(false);
+    for (unsigned int i = 0; i < ctx.num_devices; i++)
+        free(ctx.devices[i]);
+    free(ctx.devices);
     free(ctx.local_addr);
     mempool_destruct();
     geoip_free();
-    if (handle) {
-        if (handle->fd > 0)
-            iface_close(handle);
-        free(handle);
-    }
+    free(handle);
     if (ctx.filter || ctx.filter_file) {
         if (bpf.bytecode)
             free(bpf.bytecode);
@@ -338,31 +604,39 @@ void finish(int status)
     exit(status);
 }
 
+void update_iface_stat(void)
+{
+    if (!ctx.capturing)
+        return;
+    capture_get_stat(&ctx.stat);
+}
+
 void stop_scan(void)
 {
-    iface_close(handle);
-    fd_changed = true;
+    update_iface_stat();
+    capture_stop();
     ctx.capturing = false;
 }
 
 void start_scan(void)
 {
-    if (!ctx.opt.nopromiscuous && !promiscuous_mode) {
-        iface_set_promiscuous(handle, ctx.device, true);
-        promiscuous_mode = true;
-    }
+    if (!ctx.opt.nopromiscuous && !promiscuous_mode)
+        set_promiscuous(true);
     clear_statistics();
-    vector_clear(packets, NULL);
+    memset(&ctx.stat, 0, sizeof(ctx.stat));
+    svector_clear(packets, NULL);
     free_packets(NULL);
+    retention_clear();
+    store_clear();
+    compress_clear();
     process_clear_cache();
-    iface_activate(handle, ctx.device, &bpf);
-    fd_changed = true;
+    capture_start(&bpf);
     ctx.capturing = true;
     ctx.opt.load_file = false;
 }
 
 bool handle_packet(iface_handle_t *handle, unsigned char *buffer, uint32_t n,
-                   struct timeval *t)
+                   uint32_t wirelen, struct timespec *t, uint32_t rxhash)
 {
     struct packet *p;
 
@@ -373,13 +647,25 @@ bool handle_packet(iface_handle_t *handle, unsigned char *buffer, uint32_t n,
     if (!decode_packet(handle, buffer, n, &p))
         return false;
     p->time.tv_sec = t->tv_sec;
-    p->time.tv_usec = t->tv_usec;
+    p->time.tv_nsec = t->tv_nsec;
+    p->wirelen = wirelen;
+    p->rxhash = rxhash;
+    add_packet(p);
+    return true;
+}
+
+/* Store a decoded packet. Needs to be called by the main thread. */
+void add_packet(struct packet *p)
+{
+    count_packet(p);
+    retention_consume(p);
+    p = store_consume(p);
     if (p->perr != DECODE_ERR) {
         tcp_analyzer_check_stream(p);
         host_analyzer_investigate(p);
     }
-    vector_push_back(packets, p);
+    svector_push_back(packets, p);
+    compress_add(p);
     if (ctx.capturing)
         ui_event(UI_NEW_DATA);
-    return true;
 }
@@ -3,17 +3,29 @@
 #else
 #include "compat/obstack.h"
 #endif
+#include <sys/mman.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "mempool.h"
+#include "util.h"
 
-#define obstack_chunk_alloc malloc
-#define obstack_chunk_free free
 #define CHUNK_SIZE 16 * 1024
+#define FRAME_CHUNK_SIZE 64 * 1024
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
 
-#define NUM_POOLS 2
+/* The chunks of POOL_PERM double in size up to a huge page */
+#define MAX_CHUNK_SIZE (HUGE_PAGE_SIZE - sizeof(struct chunk_header))
+
+struct mempool_ctx;
 
 struct mempool {
     struct obstack pool;
+    struct mempool_ctx *ctx;
+    int id;
 
     /* When the argument to obstack_free is a NULL pointer, the result is an
        uninitialized obstack. obj will be a pointer to a first dummy object on
@@ -22,64 +34,336 @@ struct mempool {
     int *obj;
 };
 
-static struct mempool mempool[NUM_POOLS];
-static enum pool mempool_store = POOL_PERM;
+struct mempool_ctx {
+    struct mempool pools[NUM_POOLS];
+    enum pool store;          /* the pool allocated from, see mempool_set */
+    atomic_size_t size;       /* bytes allocated by the chunks */
+    struct mempool_ctx *next; /* list of contexts handed over to the main context */
+};
 
-void mempool_init(void)
+/* Every chunk starts with a header that the obstack does not know about */
+struct chunk_header {
+    struct mempool *pool;
+    size_t size;  /* bytes allocated for the chunk, including the header */
+    size_t used;  /* bytes used when the pool moved on to the next chunk */
+    bool mapped;  /* allocated with mmap */
+    bool huge;
+};
+
+static struct {
+    atomic_size_t used;
+    atomic_size_t reserved;
+    atomic_size_t chunks;
+    atomic_size_t huge_chunks;
+} stats[NUM_POOLS];
+
+static struct mempool_ctx main_ctx;
+static struct mempool_ctx *handed_over = NULL;
+static pthread_mutex_t handover_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct mempool_ctx *current = &main_ctx;
+
+#define current_pool() (&current->pools[current->store].pool)
+
+#define header(chunk) ((struct chunk_header *) (chunk) - 1)
+
+/*
+ * Map a chunk of huge pages, or if none are available, a chunk aligned to the
+ * huge page size that transparent huge pages can be used for.
+ */
+static void *map_chunk(size_t size, bool *huge)
+{
+    char *p;
+    size_t head;
+
+#ifdef MAP_HUGETLB
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        *huge = true;
+        return p;
+    }
+#endif
+    p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    head = -(uintptr_t) p & (HUGE_PAGE_SIZE - 1);
+    if (head > 0)
+        munmap(p, head);
+    munmap(p + head + size, HUGE_PAGE_SIZE - head);
+    p += head;
+#ifdef MADV_HUGEPAGE
+    *huge = madvise(p, size, MADV_HUGEPAGE) == 0;
+#endif
+    return p;
+}
+
+/*
+ * The chunks are accounted to the context they belong to, so the size of a
+ * context is right whichever thread allocates from or deallocates it.
+ */
+static void *chunk_alloc(void *arg, size_t size)
+{
+    struct mempool *pool = arg;
+    struct obstack *h = &pool->pool;
+    struct chunk_header *hdr;
+    bool mapped = false;
+    bool huge = false;
+    size_t used;
+
+    size += sizeof(struct chunk_header);
+    if (size >= HUGE_PAGE_SIZE) {
+        size = (size + HUGE_PAGE_SIZE - 1) & ~(size_t) (HUGE_PAGE_SIZE - 1);
+        hdr = map_chunk(size, &huge);
+        mapped = true;
+    } else {
+        hdr = malloc(size);
+    }
+    if (!hdr)
+        return NULL;
+    hdr->pool = pool;
+    hdr->size = size;
+    hdr->used = 0;
+    hdr->mapped = mapped;
+    hdr->huge = huge;
+    atomic_fetch_add_explicit(&pool->ctx->size, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats[pool->id].reserved, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats[pool->id].chunks, 1, memory_order_relaxed);
+    if (huge)
+        atomic_fetch_add_explicit(&stats[pool->id].huge_chunks, 1, memory_order_relaxed);
+
+    /* the object being built is moved to the new chunk */
+    if (h->chunk) {
+        used = h->object_base - (char *) h->chunk + sizeof(struct chunk_header);
+        atomic_fetch_add_explicit(&stats[pool->id].used, used - header(h->chunk)->used,
+                                  memory_order_relaxed);
+        header(h->chunk)->used = used;
+
+        /* the size of the first chunk is read after it has been allocated */
+        if (pool->id == POOL_PERM && (size_t) h->chunk_size < MAX_CHUNK_SIZE)
+            h->chunk_size = MIN((size_t) h->chunk_size * 2, MAX_CHUNK_SIZE);
+    }
+    return hdr + 1;
+}
+
+static void chunk_free(void *arg, void *chunk)
+{
+    struct mempool *pool = arg;
+    struct chunk_header *hdr = header(chunk);
+
+    atomic_fetch_sub_explicit(&pool->ctx->size, hdr->size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&stats[pool->id].reserved, hdr->size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&stats[pool->id].used, hdr->used, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&stats[pool->id].chunks, 1, memory_order_relaxed);
+    if (hdr->huge)
+        atomic_fetch_sub_explicit(&stats[pool->id].huge_chunks, 1, memory_order_relaxed);
+    if (hdr->mapped)
+        munmap(hdr, hdr->size);
+    else
+        free(hdr);
+}
+
+static void init_ctx(struct mempool_ctx *ctx)
 {
     /* POOL_SHORT will use the default chunk size of 4096 bytes */
+    static const size_t chunk_size[NUM_POOLS] = {
+        [POOL_PERM] = CHUNK_SIZE,
+        [POOL_SHORT] = 0,
+        [POOL_FRAME] = FRAME_CHUNK_SIZE
+    };
+
+    memset(ctx, 0, sizeof(*ctx));
+    atomic_init(&ctx->size, 0);
+    ctx->store = POOL_PERM;
+    ctx->next = NULL;
     for (int i = 0; i < NUM_POOLS; i++) {
-        obstack_init(&mempool[i].pool);
-        mempool[i].obj = obstack_alloc(&mempool[i].pool, sizeof(int));
+        ctx->pools[i].ctx = ctx;
+        ctx->pools[i].id = i;
+        obstack_specify_allocation_with_arg(&ctx->pools[i].pool, chunk_size[i], 0,
+                                            chunk_alloc, chunk_free, &ctx->pools[i]);
+        ctx->pools[i].obj = obstack_alloc(&ctx->pools[i].pool, sizeof(int));
     }
-    obstack_chunk_size(&mempool[POOL_PERM].pool) = CHUNK_SIZE;
 }
 
-void mempool_destruct(void)
+static void free_pools(struct mempool_ctx *ctx)
 {
     for (int i = 0; i < NUM_POOLS; i++)
-        obstack_free(&mempool[i].pool, NULL);
+        obstack_free(&ctx->pools[i].pool, NULL);
+}
+
+static void free_handed_over(void)
+{
+    struct mempool_ctx *ctx;
+
+    pthread_mutex_lock(&handover_lock);
+    while (handed_over) {
+        ctx = handed_over;
+        handed_over = ctx->next;
+        free_pools(ctx);
+        free(ctx);
+    }
+    pthread_mutex_unlock(&handover_lock);
+}
+
+void mempool_init(void)
+{
+    init_ctx(&main_ctx);
+}
+
+void mempool_destruct(void)
+{
+    free_pools(&main_ctx);
+    free_handed_over();
+}
+
+mempool_ctx_t *mempool_ctx_create(void)
+{
+    struct mempool_ctx *ctx;
+
+    ctx = malloc(sizeof(*ctx));
+    init_ctx(ctx);
+    return ctx;
+}
+
+mempool_ctx_t *mempool_ctx_set(mempool_ctx_t *ctx)
+{
+    struct mempool_ctx *prev = current;
+
+    current = ctx ? ctx : &main_ctx;
+    return prev;
+}
+
+mempool_ctx_t *mempool_ctx_get(void)
+{
+    return current;
+}
+
+size_t mempool_ctx_size(mempool_ctx_t *ctx)
+{
+    return atomic_load_explicit(&ctx->size, memory_order_relaxed);
+}
+
+void mempool_ctx_free(mempool_ctx_t *ctx)
+{
+    if (ctx == &main_ctx)
+        return;
+    free_pools(ctx);
+    free(ctx);
+}
+
+void mempool_ctx_handover(mempool_ctx_t *ctx)
+{
+    if (ctx == &main_ctx)
+        return;
+    pthread_mutex_lock(&handover_lock);
+    ctx->next = handed_over;
+    handed_over = ctx;
+    pthread_mutex_unlock(&handover_lock);
+}
+
+void mempool_thread_init(void)
+{
+    mempool_ctx_set(mempool_ctx_create());
+}
+
+void mempool_thread_exit(void)
+{
+    mempool_ctx_handover(mempool_ctx_set(NULL));
 }
 
 enum pool mempool_set(enum pool p)
 {
-	enum pool prev = mempool_store;
+    enum pool prev = current->store;
 
-    mempool_store = p;
-	return prev;
+    current->store = p;
+    return prev;
 }
 
 void *mempool_alloc(size_t size)
 {
-    return obstack_alloc(&mempool[mempool_store].pool, size);
+    return obstack_alloc(current_pool(), size);
+}
+
+/*
+ * Deallocate ptr and everything after it. The chunk ptr is in is being filled
+ * again, so it no longer counts as used.
+ */
+static void free_object(struct mempool *pool, void *ptr)
+{
+    struct chunk_header *hdr;
+
+    obstack_free(&pool->pool, ptr);
+    hdr = header(pool->pool.chunk);
+    atomic_fetch_sub_explicit(&stats[pool->id].used, hdr->used, memory_order_relaxed);
+    hdr->used = 0;
+}
+
+static void clear_pool(struct mempool *pool)
+{
+    free_object(pool, pool->obj);
+    pool->obj = obstack_alloc(&pool->pool, sizeof(int));
 }
 
 void mempool_free(void *ptr)
 {
     if (ptr) {
-        obstack_free(&mempool[mempool_store].pool, ptr);
+        free_object(&current->pools[current->store], ptr);
     } else {
-        obstack_free(&mempool[mempool_store].pool, mempool[mempool_store].obj);
-        mempool[mempool_store].obj = obstack_alloc(&mempool[mempool_store].pool, sizeof(int));
+        clear_pool(&current->pools[current->store]);
+        if (current->store == POOL_PERM) {
+            clear_pool(&current->pools[POOL_FRAME]);
+            if (current == &main_ctx)
+                free_handed_over();
+        }
     }
 }
 
+void mempool_stat(enum pool p, struct mempool_stat *stat)
+{
+    stat->used = atomic_load_explicit(&stats[p].used, memory_order_relaxed);
+    stat->reserved = atomic_load_explicit(&stats[p].reserved, memory_order_relaxed);
+    stat->chunks = atomic_load_explicit(&stats[p].chunks, memory_order_relaxed);
+    stat->huge_chunks = atomic_load_explicit(&stats[p].huge_chunks, memory_order_relaxed);
+}
+
 void *mempool_copy(void *addr, int size)
 {
-    return obstack_copy(&mempool[mempool_store].pool, addr, size);
+    return obstack_copy(current_pool(), addr, size);
 }
 
 void *mempool_copy0(void *addr, int size)
 {
-    return obstack_copy0(&mempool[mempool_store].pool, addr, size);
+    return obstack_copy0(current_pool(), addr, size);
 }
 
 void mempool_grow(void *data, int size)
 {
-    obstack_grow(&mempool[mempool_store].pool, data, size);
+    obstack_grow(current_pool(), data, size);
 }
 
 void *mempool_finish(void)
 {
-    return obstack_finish(&mempool[mempool_store].pool);
+    return obstack_finish(current_pool());
+}
+
+/*
+ * The frame is a growing object in a pool of its own, so it can be shrunk after
+ * the packet has been decoded without moving it.
+ */
+void *mempool_frame_reserve(size_t size)
+{
+    struct obstack *pool = &current->pools[POOL_FRAME].pool;
+
+    obstack_blank(pool, size);
+    return obstack_base(pool);
+}
+
+void *mempool_frame_finish(size_t len)
+{
+    struct obstack *pool = &current->pools[POOL_FRAME].pool;
+
+    obstack_blank_fast(pool, (ptrdiff_t) len - (ptrdiff_t) obstack_object_size(pool));
+    if (len == 0)
+        return NULL;
+    return obstack_finish(pool);
 }
@@ -11,27 +11,97 @@
 
 enum pool {
     POOL_PERM,  /* pool for long-lived memory */
-    POOL_SHORT  /* pool for temporary/short-lived memory */
+    POOL_SHORT, /* pool for temporary/short-lived memory */
+    POOL_FRAME, /* packet frames, see mempool_frame_reserve. Not used with mempool_set */
+    NUM_POOLS
 };
 
+struct mempool_stat {
+    size_t used;        /* bytes used in the chunks the pool has moved on from, see below */
+    size_t reserved;    /* bytes allocated for the chunks */
+    size_t chunks;
+    size_t huge_chunks; /* chunks backed by huge pages */
+};
+
+/*
+ * A context is a set of pools. Every thread allocates from its current context,
+ * which is the main context until another one is set with mempool_ctx_set.
+ * A context is not thread-safe, but it can be passed on to another thread when
+ * the first thread no longer uses it.
+ */
+typedef struct mempool_ctx mempool_ctx_t;
+
 /* Initializes the memory pools. The default pool is POOL_PERM */
 void mempool_init(void);
 
 /* Deallocates the memory pools */
 void mempool_destruct(void);
 
+/* Create a new context */
+mempool_ctx_t *mempool_ctx_create(void);
+
+/*
+ * Make ctx the calling thread's current context, or the main context if ctx is
+ * NULL. Returns the previous context.
+ */
+mempool_ctx_t *mempool_ctx_set(mempool_ctx_t *ctx);
+
+/* Return the calling thread's current context */
+mempool_ctx_t *mempool_ctx_get(void);
+
+/* Return the number of bytes allocated by the context. Can be called by any thread */
+size_t mempool_ctx_size(mempool_ctx_t *ctx);
+
+/* Deallocate the context. It must not be in use by any thread */
+void mempool_ctx_free(mempool_ctx_t *ctx);
+
+/*
+ * Hand the context over to the main context without copying it. The memory
+ * stays valid and is deallocated together with the main context's POOL_PERM,
+ * i.e. on mempool_free(NULL) in the main thread or mempool_destruct. The
+ * context must no longer be used.
+ */
+void mempool_ctx_handover(mempool_ctx_t *ctx);
+
+/*
+ * Give the calling thread a context of its own. The pools are not thread-safe,
+ * so every thread other than the main thread that allocates from the pools
+ * needs to call this, or set a context of its own, first.
+ */
+void mempool_thread_init(void);
+
+/*
+ * Go back to the main context and hand the calling thread's current context
+ * over to it, see mempool_ctx_handover.
+ */
+void mempool_thread_exit(void);
+
+/*
+ * Get the statistics of pool p summed over all contexts. The chunks of POOL_PERM
+ * grow up to 2 MB and the large chunks are backed by huge pages when possible.
+ * Can be called by any thread.
+ *
+ * The chunk that a context is allocating from is written by its thread without
+ * any synchronization, so its bytes are left out of 'used' until the pool moves
+ * on to the next chunk. With few chunks, e.g. right after start, 'used' can
+ * therefore be much lower than 'reserved'.
+ */
+void mempool_stat(enum pool p, struct mempool_stat *stat);
+
 /* Allocates memory for stack pool storage. The block will be uninitialized. */
 void *mempool_alloc(size_t size);
 
 /*
  * Deallocates ptr and everything allocated in the pool more recently
- * than ptr. To deallocate the whole pool use NULL as argument.
+ * than ptr. To deallocate the whole pool use NULL as argument. Deallocating the
+ * whole POOL_PERM also deallocates the frames, and for the main context the
+ * contexts handed over to it.
  */
 void mempool_free(void *ptr);
 
 /*
- * Set the pool to use. Need to call mempool_set with the previous pool when you
- * are done with the pool, or use MEMPOOL_RELEASE.
+ * Set the pool to use in the current context. Need to call mempool_set with the
+ * previous pool when you are done with the pool, or use MEMPOOL_RELEASE.
  *
  * Returns the old pool
  */
@@ -80,4 +150,19 @@ void mempool_grow(void *data, int size);
  */
 void *mempool_finish(void);
 
+/*
+ * Reserve 'size' bytes for a packet frame. Frames are kept apart from the other
+ * pools and live as long as POOL_PERM. Only one frame can be reserved at a
+ * time, and it must be ended with mempool_frame_finish before the next one is
+ * reserved.
+ */
+void *mempool_frame_reserve(size_t size);
+
+/*
+ * Keep the first 'len' bytes of the reserved frame and return its address. The
+ * rest is given back to the pool. If len is 0 the reservation is cancelled and
+ * NULL is returned.
+ */
+void *mempool_frame_finish(size_t len);
+
 #endif
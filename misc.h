@@ -27,7 +27,8 @@
 #define TIME_TO_WAIT 0
 
 #define MAXLINE 1000
-#define PACKET_TABLE_SIZE 65536
+#define MAX_WORKERS 64
+#define MAX_DEVICES 16
 
 #ifdef PATH_MAX
 #define MAXPATH PATH_MAX
@@ -36,7 +37,9 @@
 #endif
 
 typedef struct {
-    char *device;
+    char *device;          /* the first of the devices */
+    char **devices;        /* the interfaces to capture on */
+    unsigned int num_devices;
     char filename[MAXPATH + 1];
     bool capturing;
     struct options {
@@ -48,12 +51,22 @@ typedef struct {
         bool load_file;
         int dmode;
         bool numeric;
+        unsigned int num_workers; /* number of capture threads, 0 if none */
+        bool busy_poll;
+        bool xdp; /* capture with AF_XDP sockets */
+        bool lazy_decode; /* see set_lazy_decoding */
+        uint64_t retain_bytes;      /* memory limit for the stored packets, 0 if none */
+        unsigned int retain_window; /* seconds of packets to keep, 0 if none */
+        unsigned int compress_age;  /* age in seconds of the frames compressed, 0 if none */
     } opt;
     struct sockaddr_in *local_addr;
     unsigned char mac[ETHER_ADDR_LEN];
     char *filter;
     char *filter_file;
+    char *slice; /* slicing policy, see -S */
+    char *spool; /* directory of the spool file, see store.h */
     iface_handle_t *handle;
+    struct iface_stat stat; /* capture statistics, updated on every alarm */
 } main_context;
 
 extern main_context ctx;
@@ -62,4 +75,7 @@ void finish(int status) NORETURN;
 void stop_scan(void);
 void start_scan(void);
 
+/* Read the capture statistics from the interface into ctx.stat */
+void update_iface_stat(void);
+
 #endif
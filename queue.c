@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "queue.h"
+#include "util.h"
+
+#define CACHELINE 64
+
+struct queue {
+    void **buf;
+    unsigned int mask;
+
+    /* written by the consumer */
+    _Alignas(CACHELINE) atomic_uint head;
+    unsigned int tail_cache; /* the consumer's last view of tail */
+
+    /* written by the producer */
+    _Alignas(CACHELINE) atomic_uint tail;
+    unsigned int head_cache; /* the producer's last view of head */
+};
+
+queue_t *queue_init(unsigned int size)
+{
+    queue_t *q;
+
+    if (posix_memalign((void **) &q, CACHELINE, sizeof(*q)) != 0)
+        return NULL;
+    q->mask = clp2(size) - 1;
+    q->buf = malloc((q->mask + 1) * sizeof(void *));
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->head_cache = 0;
+    q->tail_cache = 0;
+    return q;
+}
+
+void queue_free(queue_t *q)
+{
+    if (!q)
+        return;
+    free(q->buf);
+    free(q);
+}
+
+bool queue_push(queue_t *q, void *data)
+{
+    unsigned int tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    /* only read the consumer's index when the queue looks full */
+    if (tail - q->head_cache > q->mask) {
+        q->head_cache = atomic_load_explicit(&q->head, memory_order_acquire);
+        if (tail - q->head_cache > q->mask)
+            return false;
+    }
+    q->buf[tail & q->mask] = data;
+    atomic_store_explicit(&q->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+void *queue_front(queue_t *q)
+{
+    unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    if (head == q->tail_cache) {
+        q->tail_cache = atomic_load_explicit(&q->tail, memory_order_acquire);
+        if (head == q->tail_cache)
+            return NULL;
+    }
+    return q->buf[head & q->mask];
+}
+
+void *queue_pop(queue_t *q)
+{
+    void *data;
+
+    if ((data = queue_front(q)) != NULL) {
+        unsigned int head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+        atomic_store_explicit(&q->head, head + 1, memory_order_release);
+    }
+    return data;
+}
+
+bool queue_empty(queue_t *q)
+{
+    return atomic_load_explicit(&q->head, memory_order_relaxed) ==
+        atomic_load_explicit(&q->tail, memory_order_acquire);
+}
+
+unsigned int queue_size(queue_t *q)
+{
+    return atomic_load_explicit(&q->tail, memory_order_acquire) -
+        atomic_load_explicit(&q->head, memory_order_relaxed);
+}
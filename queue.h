@@ -0,0 +1,34 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdbool.h>
+
+/*
+ * Lock-free bounded queue for one producer and one consumer thread. The
+ * producer may only call queue_push and the consumer queue_pop, queue_front
+ * and queue_empty.
+ */
+typedef struct queue queue_t;
+
+/* Initialize queue. The capacity will be rounded up to a power of 2 */
+queue_t *queue_init(unsigned int size);
+
+/* Free all resources related to the queue. Will not free the data */
+void queue_free(queue_t *q);
+
+/* Add an element to the end of the queue. Returns false if the queue is full */
+bool queue_push(queue_t *q, void *data);
+
+/* Remove and return the element at the front of the queue, or NULL if empty */
+void *queue_pop(queue_t *q);
+
+/* Return the element at the front of the queue without removing it */
+void *queue_front(queue_t *q);
+
+/* Is the queue empty? */
+bool queue_empty(queue_t *q);
+
+/* Return the number of elements in the queue */
+unsigned int queue_size(queue_t *q);
+
+#endif
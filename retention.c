@@ -0,0 +1,265 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "retention.h"
+#include "misc.h"
+#include "mempool.h"
+#include "signal.h"
+#include "util.h"
+#include "decoder/packet.h"
+#include "decoder/tcp_analyzer.h"
+#include "decoder/host_analyzer.h"
+#include "decoder/summary.h"
+#include "compress.h"
+
+#define NUM_SEGMENTS 16 /* the limits are divided between this number of segments */
+#define MIN_SEGMENT_SIZE (1024 * 1024)
+
+/*
+ * A segment is written by a single capture worker. The worker closes the
+ * segment when it starts the next one, and the segment can be removed when it
+ * is closed and the main thread has stored all its packets.
+ */
+struct retention_segment {
+    mempool_ctx_t *mempool;
+    time_t first;          /* timestamp of the first packet, used by the worker */
+    atomic_uint npackets;  /* number of packets passed on by the worker */
+    atomic_bool closed;
+    unsigned int consumed; /* number of packets stored by the main thread */
+    size_t released;       /* bytes given back by frame compression */
+    uint32_t last_num;     /* number of the last packet stored */
+    time_t last;           /* timestamp of the last packet stored */
+    struct retention_segment *next;
+};
+
+static struct retention_segment *head = NULL; /* the oldest segment */
+static struct retention_segment *tail = NULL;
+static pthread_mutex_t segments_lock = PTHREAD_MUTEX_INITIALIZER;
+static svector_t *packets;
+static uint32_t evicted_num = 0; /* number of the last packet removed */
+static time_t newest = 0;        /* timestamp of the newest packet stored */
+static size_t segment_size;
+static time_t segment_span;
+static publisher_t *evict_publisher = NULL;
+static __thread struct retention_segment *current = NULL;
+static __thread mempool_ctx_t *home; /* the context used before the first segment */
+
+void retention_init(svector_t *p)
+{
+    unsigned int n = MAX(ctx.opt.num_workers * ctx.num_devices, 1);
+
+    packets = p;
+    evict_publisher = publisher_init();
+
+    /* a worker starts a new segment when one of the limits is reached */
+    segment_size = ctx.opt.retain_bytes ?
+        MAX(ctx.opt.retain_bytes / NUM_SEGMENTS / n, MIN_SEGMENT_SIZE) : SIZE_MAX;
+    segment_span = ctx.opt.retain_window ? MAX(ctx.opt.retain_window / NUM_SEGMENTS, 1) : 0;
+}
+
+void retention_free(void)
+{
+    retention_clear();
+    if (evict_publisher)
+        publisher_free(evict_publisher);
+    evict_publisher = NULL;
+}
+
+bool retention_enabled(void)
+{
+    return ctx.opt.retain_bytes > 0 || ctx.opt.retain_window > 0;
+}
+
+static void new_segment(void)
+{
+    struct retention_segment *seg;
+
+    seg = calloc(1, sizeof(*seg));
+    seg->mempool = mempool_ctx_create();
+    atomic_init(&seg->npackets, 0);
+    atomic_init(&seg->closed, false);
+    pthread_mutex_lock(&segments_lock);
+    if (tail)
+        tail->next = seg;
+    else
+        head = seg;
+    tail = seg;
+    pthread_mutex_unlock(&segments_lock);
+
+    /* the previous segment is no longer used by this thread */
+    if (current)
+        atomic_store_explicit(&current->closed, true, memory_order_release);
+    else
+        home = mempool_ctx_get();
+    mempool_ctx_set(seg->mempool);
+    current = seg;
+}
+
+void retention_thread_init(void)
+{
+    if (retention_enabled())
+        new_segment();
+    else
+        mempool_thread_init();
+}
+
+void retention_thread_exit(void)
+{
+    if (current) {
+        /* the segments are deallocated when they are evicted */
+        atomic_store_explicit(&current->closed, true, memory_order_release);
+        mempool_ctx_set(home);
+        current = NULL;
+    } else {
+        mempool_thread_exit();
+    }
+}
+
+void retention_prepare(struct timespec *t)
+{
+    if (!current)
+        return;
+    if (atomic_load_explicit(&current->npackets, memory_order_relaxed) == 0) {
+        current->first = t->tv_sec;
+    } else if (mempool_ctx_size(current->mempool) >= segment_size ||
+               (segment_span && t->tv_sec - current->first >= segment_span)) {
+        new_segment();
+        current->first = t->tv_sec;
+    }
+}
+
+void retention_add(struct packet *p)
+{
+    p->seg = current;
+    if (current)
+        atomic_fetch_add_explicit(&current->npackets, 1, memory_order_relaxed);
+}
+
+void retention_consume(struct packet *p)
+{
+    struct retention_segment *seg = p->seg;
+
+    if (!seg)
+        return;
+    seg->consumed++;
+    seg->last_num = p->num;
+    seg->last = p->time.tv_sec;
+    if (seg->last > newest)
+        newest = seg->last;
+}
+
+void retention_release(struct packet *p, size_t n)
+{
+    if (p->seg)
+        p->seg->released += n;
+}
+
+/* Return the memory used by the segment */
+static size_t segment_used(struct retention_segment *seg)
+{
+    size_t size = mempool_ctx_size(seg->mempool);
+
+    return size - MIN(size, seg->released);
+}
+
+static inline bool is_evictable(struct retention_segment *seg)
+{
+    return atomic_load_explicit(&seg->closed, memory_order_acquire) &&
+        seg->consumed == atomic_load_explicit(&seg->npackets, memory_order_relaxed);
+}
+
+/*
+ * Remove the packets in the segment from the packet vector and deallocate it.
+ * The packet vector is in packet number order, so all packets up to the last
+ * packet in the segment are removed. This can include packets from other
+ * workers' segments, which are deallocated when their segment is removed.
+ */
+static void evict(struct retention_segment *seg)
+{
+    if (seg->last_num > evicted_num) {
+        uint32_t num = seg->last_num;
+
+        tcp_analyzer_evict(num);
+        host_analyzer_evict(num);
+        summary_evict(num);
+        compress_evict(num);
+        publish1(evict_publisher, &num);
+        svector_erase_front(packets, num - evicted_num, NULL);
+        evicted_num = num;
+    }
+    mempool_ctx_free(seg->mempool);
+    free(seg);
+}
+
+void retention_evict(void)
+{
+    struct retention_segment *seg, *prev, *next;
+    struct retention_segment *evicted = NULL;
+    struct retention_segment **last = &evicted;
+    size_t total;
+
+    if (!retention_enabled())
+        return;
+    pthread_mutex_lock(&segments_lock);
+    total = compress_size();
+    for (seg = head; seg; seg = seg->next)
+        total += segment_used(seg);
+    prev = NULL;
+    for (seg = head; seg; seg = next) {
+        next = seg->next;
+        if (!is_evictable(seg)) {
+            prev = seg;
+            continue;
+        }
+        if (!(ctx.opt.retain_bytes && total > ctx.opt.retain_bytes) &&
+            !(ctx.opt.retain_window && seg->last + (time_t) ctx.opt.retain_window < newest))
+            break;
+        total -= segment_used(seg);
+        if (prev)
+            prev->next = next;
+        else
+            head = next;
+        if (tail == seg)
+            tail = prev;
+        seg->next = NULL;
+        *last = seg;
+        last = &seg->next;
+    }
+    pthread_mutex_unlock(&segments_lock);
+    while (evicted) {
+        next = evicted->next;
+        evict(evicted);
+        evicted = next;
+    }
+}
+
+void retention_clear(void)
+{
+    struct retention_segment *seg;
+
+    pthread_mutex_lock(&segments_lock);
+    seg = head;
+    head = tail = NULL;
+    pthread_mutex_unlock(&segments_lock);
+    while (seg) {
+        struct retention_segment *next = seg->next;
+
+        mempool_ctx_free(seg->mempool);
+        free(seg);
+        seg = next;
+    }
+    evicted_num = 0;
+    newest = 0;
+}
+
+void retention_subscribe(retention_fn fn)
+{
+    if (evict_publisher)
+        add_subscription1(evict_publisher, (publisher_fn1) (void *) fn);
+}
+
+void retention_unsubscribe(retention_fn fn)
+{
+    if (evict_publisher)
+        remove_subscription1(evict_publisher, (publisher_fn1) (void *) fn);
+}
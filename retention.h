@@ -0,0 +1,77 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "svector.h"
+
+/*
+ * Bounded retention of the captured packets. The capture workers store the
+ * packets in segments, i.e. memory arenas that cover a limited amount of
+ * memory and time. When the memory limit (ctx.opt.retain_bytes) or the time
+ * window (ctx.opt.retain_window) is exceeded, the oldest segment is dropped in
+ * one step and the packets stored in it are removed from the packet vector.
+ */
+
+struct packet;
+struct timespec;
+
+/*
+ * Function that is called before the packets with a number less than or equal
+ * to *num are removed from the packet vector and deallocated. Any references
+ * to these packets must be removed.
+ */
+typedef void (*retention_fn)(uint32_t *num);
+
+/* Initialize the retention of the packets stored in 'packets' */
+void retention_init(svector_t *packets);
+
+/* Free all segments */
+void retention_free(void);
+
+/* Is the retention of packets limited? */
+bool retention_enabled(void);
+
+/*
+ * Needs to be called by a capture worker before it allocates from the pools.
+ * If the retention is limited the pools are replaced by a segment.
+ */
+void retention_thread_init(void);
+
+/* Called by a capture worker when it exits */
+void retention_thread_exit(void);
+
+/*
+ * Called by a capture worker before decoding a packet with timestamp t. Starts
+ * a new segment if the current segment is full.
+ */
+void retention_prepare(struct timespec *t);
+
+/* Called by a capture worker when a decoded packet is passed on */
+void retention_add(struct packet *p);
+
+/*
+ * Called by the main thread when a packet is stored in the packet vector. The
+ * packet number needs to be set.
+ */
+void retention_consume(struct packet *p);
+
+/*
+ * Called by the main thread when 'n' bytes of the memory used by the packet's
+ * frame have been given back to the system, see compress.h
+ */
+void retention_release(struct packet *p, size_t n);
+
+/* Remove the oldest segments until the limits are no longer exceeded */
+void retention_evict(void);
+
+/* Remove all segments. The capture workers must be stopped */
+void retention_clear(void);
+
+/* Subscribe to removal of packets */
+void retention_subscribe(retention_fn fn);
+
+/* Unsubscribe to removal of packets */
+void retention_unsubscribe(retention_fn fn);
+
+#endif
@@ -0,0 +1,323 @@
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "store.h"
+#include "misc.h"
+#include "error.h"
+#include "debug.h"
+#include "util.h"
+#include "mempool.h"
+#include "vector.h"
+#include "decoder/packet.h"
+
+#define BLOCK_SIZE (32 * 1024 * 1024)
+#define RECORD_ALIGN 8
+
+/*
+ * A block is written by a single capture worker, and the decoded data of the
+ * packets whose frames are in the block is allocated from a context of its
+ * own. The worker closes the block when it starts the next one. When the block
+ * is closed and the main thread has stored all its packets, the decoded data is
+ * deallocated and the packets are decoded again from the frames when they are
+ * looked at.
+ */
+struct store_block {
+    unsigned char *map;
+    mempool_ctx_t *mempool; /* NULL when the decoded data is deallocated */
+    atomic_uint npackets;   /* number of packets passed on by the worker */
+    atomic_bool closed;
+    unsigned int consumed;  /* number of packets stored by the main thread */
+    uint32_t first_num;     /* number of the first and last packet stored */
+    uint32_t last_num;
+    struct store_block *next;
+};
+
+/*
+ * Every frame in the spool file is preceded by a record. A record never crosses
+ * a block boundary, and the space after the last record in a block is zero,
+ * i.e. a record with length 0 ends the block.
+ */
+struct store_record {
+    int64_t sec;
+    uint32_t nsec;
+    uint32_t len;     /* number of bytes of the frame stored after the record */
+    uint32_t wirelen; /* length of the frame on the network */
+    uint16_t iface;
+    uint16_t reserved;
+    struct store_block *block;
+};
+
+static int fd = -1;
+static off_t file_size = 0;
+static struct store_block *head = NULL; /* the blocks in file order */
+static struct store_block *tail = NULL;
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+static svector_t *packets;
+static vector_t *roots = NULL; /* the datalink layer of the packets without decoded data */
+
+/* every worker appends to a block of its own */
+static __thread bool attached = false;
+static __thread bool full = false; /* the spool file could not grow */
+static __thread struct store_block *current = NULL;
+static __thread size_t used;
+static __thread struct store_record *reserved = NULL;
+static __thread struct store_record *last = NULL;
+static __thread mempool_ctx_t *home; /* the context used when the frames are kept in memory */
+
+void store_open(const char *dir, svector_t *p)
+{
+    char path[MAXPATH + 1];
+
+    if (snprintf(path, sizeof(path), "%s/monitor.XXXXXX", dir) >= (int) sizeof(path))
+        err_quit("Spool directory name too long: %s", dir);
+    if ((fd = mkstemp(path)) == -1)
+        err_sys("Cannot create spool file in %s", dir);
+    unlink(path);
+    packets = p;
+    roots = vector_init(8);
+}
+
+void store_close(void)
+{
+    if (fd == -1)
+        return;
+    store_clear();
+    vector_free(roots, free);
+    roots = NULL;
+    close(fd);
+    fd = -1;
+}
+
+bool store_enabled(void)
+{
+    return fd != -1;
+}
+
+void store_thread_init(void)
+{
+    attached = store_enabled();
+    full = false;
+    current = NULL;
+    reserved = NULL;
+    last = NULL;
+    home = mempool_ctx_get();
+}
+
+static void close_block(void)
+{
+    if (!current)
+        return;
+#ifdef MADV_COLD
+    /* the frames are rarely looked at again, so let the kernel page them out first */
+    madvise(current->map, BLOCK_SIZE, MADV_COLD);
+#endif
+    atomic_store_explicit(&current->closed, true, memory_order_release);
+    mempool_ctx_set(home);
+    current = NULL;
+}
+
+void store_thread_exit(void)
+{
+    close_block();
+    attached = false;
+    last = NULL;
+}
+
+/*
+ * Allocate the blocks on disk before they are mapped. Writing to a sparse file
+ * on a full file system would raise SIGBUS.
+ */
+static struct store_block *new_block(void)
+{
+    struct store_block *b = NULL;
+    unsigned char *map;
+    int err;
+
+    pthread_mutex_lock(&store_lock);
+    if ((err = posix_fallocate(fd, file_size, BLOCK_SIZE)) != 0) {
+        DEBUG("Cannot extend the spool file: %s", strerror(err));
+        goto done;
+    }
+    map = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, file_size);
+    if (map == MAP_FAILED)
+        err_sys("mmap error");
+    file_size += BLOCK_SIZE;
+    b = calloc(1, sizeof(*b));
+    b->map = map;
+    b->mempool = mempool_ctx_create();
+    atomic_init(&b->npackets, 0);
+    atomic_init(&b->closed, false);
+    if (tail)
+        tail->next = b;
+    else
+        head = b;
+    tail = b;
+done:
+    pthread_mutex_unlock(&store_lock);
+    return b;
+}
+
+void store_prepare(size_t size)
+{
+    struct store_block *b;
+
+    if (!attached || full)
+        return;
+    if (current && used + sizeof(struct store_record) + size <= BLOCK_SIZE)
+        return;
+    close_block();
+    if ((b = new_block()) == NULL) {
+        full = true;
+        return;
+    }
+    mempool_ctx_set(b->mempool);
+    current = b;
+    used = 0;
+}
+
+void *store_frame_reserve(size_t size)
+{
+    if (!current || used + sizeof(struct store_record) + size > BLOCK_SIZE)
+        return NULL;
+    reserved = (struct store_record *) (current->map + used);
+    return reserved + 1;
+}
+
+void *store_frame_finish(size_t len)
+{
+    struct store_record *rec = reserved;
+
+    reserved = NULL;
+    if (len == 0)
+        return NULL;
+    rec->len = len;
+    rec->block = current;
+    used += (sizeof(*rec) + len + RECORD_ALIGN - 1) & ~(size_t) (RECORD_ALIGN - 1);
+    last = rec;
+    return rec + 1;
+}
+
+void store_commit(struct packet *p)
+{
+    if (!p->spooled)
+        return;
+    last->sec = p->time.tv_sec;
+    last->nsec = p->time.tv_nsec;
+    last->wirelen = p->wirelen;
+    last->iface = p->iface;
+    atomic_fetch_add_explicit(&current->npackets, 1, memory_order_relaxed);
+    last = NULL;
+}
+
+static inline struct store_block *get_block(struct packet *p)
+{
+    return ((struct store_record *) p->buf - 1)->block;
+}
+
+static inline bool in_block(struct store_block *b, struct packet *p)
+{
+    return p->buf >= b->map && p->buf < b->map + BLOCK_SIZE;
+}
+
+struct packet *store_consume(struct packet *p)
+{
+    struct store_block *b;
+    struct packet *entry;
+
+    if (!p->spooled)
+        return p;
+    b = get_block(p);
+    if (b->consumed++ == 0)
+        b->first_num = p->num;
+    b->last_num = p->num;
+
+    /* the packet itself is deallocated together with the decoded data */
+    entry = mempool_alloc(sizeof(struct packet));
+    *entry = *p;
+    return entry;
+}
+
+/* Return a datalink layer without decoded data for protocol id */
+static struct packet_data *get_root(uint32_t id)
+{
+    struct packet_data *root;
+
+    for (int i = 0; i < vector_size(roots); i++) {
+        root = vector_get(roots, i);
+        if (root->id == id)
+            return root;
+    }
+    root = calloc(1, sizeof(*root));
+    root->id = id;
+    vector_push_back(roots, root);
+    return root;
+}
+
+/*
+ * Deallocate the decoded data of the packets in the block. The packets need to
+ * be decoded again, see get_full_packet.
+ */
+static void release(struct store_block *b)
+{
+    if (b->consumed > 0 && svector_size(packets) > 0) {
+        struct packet *p = svector_get(packets, 0);
+        uint32_t base = p->num;
+
+        for (uint32_t num = MAX(b->first_num, base); num <= b->last_num; num++) {
+            p = svector_get(packets, num - base);
+
+            /* the packets of other workers' blocks are interleaved */
+            if (p->spooled && in_block(b, p)) {
+                p->root = get_root(p->root->id);
+                p->partial = true;
+            }
+        }
+    }
+    mempool_ctx_free(b->mempool);
+    b->mempool = NULL;
+}
+
+void store_release(void)
+{
+    struct store_block *b;
+
+    if (!store_enabled())
+        return;
+    pthread_mutex_lock(&store_lock);
+    for (b = head; b; b = b->next) {
+        if (b->mempool && atomic_load_explicit(&b->closed, memory_order_acquire) &&
+            b->consumed == atomic_load_explicit(&b->npackets, memory_order_relaxed))
+            release(b);
+    }
+    pthread_mutex_unlock(&store_lock);
+}
+
+void store_clear(void)
+{
+    struct store_block *b;
+
+    if (fd == -1)
+        return;
+    pthread_mutex_lock(&store_lock);
+    b = head;
+    head = tail = NULL;
+    pthread_mutex_unlock(&store_lock);
+    while (b) {
+        struct store_block *next = b->next;
+
+        if (b->mempool)
+            mempool_ctx_free(b->mempool);
+        munmap(b->map, BLOCK_SIZE);
+        free(b);
+        b = next;
+    }
+    if (ftruncate(fd, 0) == -1)
+        err_sys("ftruncate error");
+    file_size = 0;
+}
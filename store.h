@@ -0,0 +1,83 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "svector.h"
+
+/*
+ * Disk-backed store for the captured frames. The capture workers append the
+ * frames, each preceded by a small record with the packet metadata, to a spool
+ * file that is mapped into memory. The packets point into the mapping, so the
+ * frames are paged in by the kernel when they are accessed, and pages that have
+ * not been used for a while can be dropped from memory.
+ *
+ * The packet vector only keeps the packets themselves. The decoded data is
+ * deallocated when the main thread has stored all the packets of a block of the
+ * spool file, and a packet is decoded again from its frame when it is looked
+ * at, see get_full_packet.
+ */
+
+struct packet;
+
+/*
+ * Create the spool file in directory 'dir' for the packets stored in 'packets'.
+ * The file is removed as soon as it is created, so it never outlives the
+ * process.
+ */
+void store_open(const char *dir, svector_t *packets);
+
+/* Unmap and close the spool file */
+void store_close(void);
+
+/* Is the spool file used? */
+bool store_enabled(void);
+
+/* Needs to be called by a capture worker before it stores frames in the spool file */
+void store_thread_init(void);
+
+/* Called by a capture worker when it exits */
+void store_thread_exit(void);
+
+/*
+ * Called by a capture worker before decoding a frame of at most 'size' bytes.
+ * Starts a new block if the frame does not fit in the current one. The decoded
+ * data is allocated from the block until the next block is started.
+ */
+void store_prepare(size_t size);
+
+/*
+ * Reserve 'size' bytes for a frame in the spool file. Only one frame can be
+ * reserved at a time, and it must be ended with store_frame_finish. Returns
+ * NULL if the calling thread does not use the store or the spool file cannot
+ * grow, in which case the frame needs to be kept in memory.
+ */
+void *store_frame_reserve(size_t size);
+
+/*
+ * Keep the first 'len' bytes of the reserved frame and return its address. If
+ * len is 0 the reservation is cancelled and NULL is returned.
+ */
+void *store_frame_finish(size_t len);
+
+/*
+ * Write the metadata of the packet whose frame was the last one finished by the
+ * calling thread. Does nothing if the frame is not stored in the spool file.
+ */
+void store_commit(struct packet *p);
+
+/*
+ * Called by the main thread when a packet is stored in the packet vector. The
+ * packet number needs to be set. If the frame is stored in the spool file, the
+ * packet is copied to memory that is kept when the decoded data is deallocated,
+ * and the copy is returned. Otherwise p is returned.
+ */
+struct packet *store_consume(struct packet *p);
+
+/* Deallocate the decoded data of the blocks whose packets are all stored */
+void store_release(void);
+
+/* Remove all frames. The capture workers must be stopped */
+void store_clear(void);
+
+#endif
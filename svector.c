@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include "svector.h"
+
+#define CHUNK_SHIFT 12
+#define CHUNK_SIZE (1U << CHUNK_SHIFT) /* number of elements in a chunk */
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define DIR_SIZE 16
+
+/*
+ * The chunks in use are dir[first, last). The first element is stored at
+ * position base in dir[first]. Removing elements from the front deallocates the
+ * chunks in front of the first element, and the space in front of first is
+ * reclaimed when the directory is full. One chunk is kept as a spare, so a
+ * vector whose front is continuously erased does not allocate new chunks.
+ */
+struct svector {
+    void ***dir;
+    unsigned int first;
+    unsigned int last;
+    unsigned int dir_size;
+    unsigned int base;
+    unsigned int count;
+    void **spare;
+};
+
+svector_t *svector_init(void)
+{
+    svector_t *vector;
+
+    vector = calloc(1, sizeof(svector_t));
+    vector->dir_size = DIR_SIZE;
+    vector->dir = malloc(vector->dir_size * sizeof(*vector->dir));
+    return vector;
+}
+
+static void **alloc_chunk(svector_t *vector)
+{
+    void **chunk;
+
+    if ((chunk = vector->spare)) {
+        vector->spare = NULL;
+        return chunk;
+    }
+    return malloc(CHUNK_SIZE * sizeof(void *));
+}
+
+static void free_chunk(svector_t *vector, void **chunk)
+{
+    if (vector->spare)
+        free(chunk);
+    else
+        vector->spare = chunk;
+}
+
+static inline void **get_slot(svector_t *vector, unsigned int i)
+{
+    unsigned int pos = vector->base + i;
+
+    return &vector->dir[vector->first + (pos >> CHUNK_SHIFT)][pos & CHUNK_MASK];
+}
+
+void svector_push_back(svector_t *vector, void *data)
+{
+    unsigned int pos = vector->base + vector->count;
+
+    if (vector->first + (pos >> CHUNK_SHIFT) == vector->last) {
+        if (vector->last == vector->dir_size) {
+            if (vector->first > 0 && vector->first >= vector->dir_size / 2) {
+                vector->last -= vector->first;
+                memmove(vector->dir, vector->dir + vector->first, vector->last * sizeof(*vector->dir));
+                vector->first = 0;
+            } else {
+                vector->dir_size *= 2;
+                vector->dir = realloc(vector->dir, vector->dir_size * sizeof(*vector->dir));
+            }
+        }
+        vector->dir[vector->last++] = alloc_chunk(vector);
+    }
+    *get_slot(vector, vector->count++) = data;
+}
+
+void svector_erase_front(svector_t *vector, int n, vector_deallocate func)
+{
+    if ((unsigned int) n > vector->count)
+        n = vector->count;
+    if (func) {
+        for (int i = 0; i < n; i++)
+            func(*get_slot(vector, i));
+    }
+    vector->base += n;
+    vector->count -= n;
+    while (vector->base >= CHUNK_SIZE) {
+        free_chunk(vector, vector->dir[vector->first++]);
+        vector->base -= CHUNK_SIZE;
+    }
+}
+
+void *svector_back(svector_t *vector)
+{
+    if (vector->count > 0)
+        return *get_slot(vector, vector->count - 1);
+    return NULL;
+}
+
+void *svector_get(svector_t *vector, int i)
+{
+    if ((unsigned int) i < vector->count)
+        return *get_slot(vector, i);
+    return NULL;
+}
+
+int svector_size(svector_t *vector)
+{
+    return vector->count;
+}
+
+void svector_clear(svector_t *vector, vector_deallocate func)
+{
+    if (func) {
+        for (unsigned int i = 0; i < vector->count; i++)
+            func(*get_slot(vector, i));
+    }
+    for (unsigned int i = vector->first; i < vector->last; i++)
+        free_chunk(vector, vector->dir[i]);
+    vector->first = 0;
+    vector->last = 0;
+    vector->base = 0;
+    vector->count = 0;
+}
+
+void svector_free(svector_t *vector, vector_deallocate func)
+{
+    if (!vector)
+        return;
+
+    svector_clear(vector, func);
+    free(vector->spare);
+    free(vector->dir);
+    free(vector);
+}
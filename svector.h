@@ -0,0 +1,47 @@
+#ifndef SVECTOR_H
+#define SVECTOR_H
+
+#include "vector.h"
+
+/*
+ * A segmented vector. The elements are stored in fixed-size chunks that are
+ * referenced from a directory, so an element never moves once it is stored and
+ * appending never copies the elements, only the directory when it is full.
+ * Indexing is constant time.
+ */
+
+typedef struct svector svector_t;
+
+/* initialize an empty vector */
+svector_t *svector_init(void);
+
+/* insert element at the end */
+void svector_push_back(svector_t *vector, void *data);
+
+/*
+ * Remove the first n elements. The chunks that become empty are deallocated,
+ * the remaining elements are not moved.
+ */
+void svector_erase_front(svector_t *vector, int n, vector_deallocate func);
+
+/* get data from end of vector */
+void *svector_back(svector_t *vector);
+
+/* Get the ith element. Return null if no element */
+void *svector_get(svector_t *vector, int i);
+
+/* Get the number of elements stored in the vector */
+int svector_size(svector_t *vector);
+
+/*
+ * Clears the vector
+ *
+ * Memory for the data is deallocated if func is specified, but not the vector.
+ * To free all memory associated with vector use svector_free.
+ */
+void svector_clear(svector_t *vector, vector_deallocate func);
+
+/* Free all memory used by vector */
+void svector_free(svector_t *vector, vector_deallocate func);
+
+#endif
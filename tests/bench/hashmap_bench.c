@@ -0,0 +1,221 @@
+/*
+ * Compares hashmap_t with the specialized maps in hashmap_gen.h for the key
+ * types used per packet: IPv4 addresses, TCP endpoints and strings, and the
+ * TCP analyzer's flow cache with a lookup in the connection table.
+ *
+ * Usage: hashmap_bench [number of keys]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../../hashmap.h"
+#include "../../decoder/tcp_analyzer.h"
+#include "../../hashmap_gen.h"
+
+#define LOOKUPS 10000000
+
+static unsigned int nkeys;
+static uint32_t *addrs;
+static struct tcp_endpoint_v4 *endps;
+static char **names;
+static unsigned int *order; /* the keys looked up */
+static volatile uintptr_t sink;
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *op, double start, unsigned int n)
+{
+    printf("%-10s %-8s %8.1f ns/op\n", name, op, (now() - start) * 1e9 / n);
+}
+
+static void bench_uint32(void)
+{
+    hashmap_t *map = hashmap_init(16, hashdjb_uint32, compare_uint);
+    u32map_t *u32 = u32map_init(16);
+    double t;
+
+    t = now();
+    for (unsigned int i = 0; i < nkeys; i++)
+        hashmap_insert(map, UINT_TO_PTR(addrs[i]), UINT_TO_PTR(i));
+    report("hashmap", "insert", t, nkeys);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(hashmap_get(map, UINT_TO_PTR(addrs[order[i]])));
+    report("hashmap", "get", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(hashmap_get(map, UINT_TO_PTR(~addrs[order[i]])));
+    report("hashmap", "miss", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < nkeys; i++)
+        u32map_insert(u32, addrs[i], UINT_TO_PTR(i));
+    report("u32map", "insert", t, nkeys);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(*u32map_get(u32, addrs[order[i]]));
+    report("u32map", "get", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += u32map_get(u32, ~addrs[order[i]]) != NULL;
+    report("u32map", "miss", t, LOOKUPS);
+    hashmap_free(map);
+    u32map_free(u32);
+}
+
+static void bench_endpoint(void)
+{
+    hashmap_t *map = hashmap_init(16, hash_tcp_v4, compare_tcp_v4);
+    flowmap_t *flows = flowmap_init(16);
+    double t;
+
+    t = now();
+    for (unsigned int i = 0; i < nkeys; i++)
+        hashmap_insert(map, &endps[i], UINT_TO_PTR(i));
+    report("hashmap", "insert", t, nkeys);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(hashmap_get(map, &endps[order[i]]));
+    report("hashmap", "get", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < nkeys; i++)
+        flowmap_insert(flows, tcp_flow_key(&endps[i]), UINT_TO_PTR(i));
+    report("flowmap", "insert", t, nkeys);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(*flowmap_get(flows, tcp_flow_key(&endps[order[i]])));
+    report("flowmap", "get", t, LOOKUPS);
+    hashmap_free(map);
+    flowmap_free(flows);
+}
+
+/*
+ * The TCP analyzer finds a connection through a cache indexed by the kernel
+ * flow hash, which saves hashing the endpoint, and falls back to the
+ * connection table on a miss.
+ */
+static void bench_flow_cache(void)
+{
+    hashmap_t *map = hashmap_init(16, hash_tcp_v4, compare_tcp_v4);
+    hashmap_t *cache = hashmap_init(16, NULL, NULL);
+    uint32_t *rxhash = malloc(nkeys * sizeof(*rxhash));
+    struct tcp_endpoint_v4 *endp;
+    double t;
+
+    for (unsigned int i = 0; i < nkeys; i++) {
+        rxhash[i] = hash_mix32(i + 1);
+        hashmap_insert(map, &endps[i], &endps[i]);
+        hashmap_insert_hash(cache, UINT_TO_PTR(rxhash[i]), &endps[i], rxhash[i]);
+    }
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += (uintptr_t) hashmap_get(map, &endps[order[i]]);
+    report("table", "get", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++) {
+        uint32_t h = rxhash[order[i]];
+
+        endp = hashmap_get_hash(cache, UINT_TO_PTR(h), h);
+        if (endp && compare_tcp_v4(endp, &endps[order[i]]) == 0)
+            sink += (uintptr_t) endp;
+    }
+    report("cache", "hit", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++) {
+        uint32_t h = ~rxhash[order[i]];
+
+        endp = hashmap_get_hash(cache, UINT_TO_PTR(h), h);
+        if (!endp || compare_tcp_v4(endp, &endps[order[i]]) != 0)
+            endp = hashmap_get(map, &endps[order[i]]);
+        sink += (uintptr_t) endp;
+    }
+    report("cache", "miss", t, LOOKUPS);
+    hashmap_free(map);
+    hashmap_free(cache);
+    free(rxhash);
+}
+
+/* The slowest insert while the table grows, which used to be a full rehash */
+static void bench_latency(void)
+{
+    hashmap_t *map = hashmap_init(16, hash_tcp_v4, compare_tcp_v4);
+    double worst = 0;
+    double t, d;
+
+    for (unsigned int i = 0; i < nkeys; i++) {
+        t = now();
+        hashmap_insert(map, &endps[i], UINT_TO_PTR(i));
+        if ((d = now() - t) > worst)
+            worst = d;
+    }
+    printf("%-10s %-8s %8.1f us\n", "hashmap", "worst", worst * 1e6);
+    hashmap_free(map);
+}
+
+static void bench_string(void)
+{
+    hashmap_t *map = hashmap_init(16, hashfnv_string, compare_string);
+    strmap_t *str = strmap_init(16);
+    double t;
+
+    t = now();
+    for (unsigned int i = 0; i < nkeys; i++)
+        hashmap_insert(map, names[i], UINT_TO_PTR(i));
+    report("hashmap", "insert", t, nkeys);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(hashmap_get(map, names[order[i]]));
+    report("hashmap", "get", t, LOOKUPS);
+    t = now();
+    for (unsigned int i = 0; i < nkeys; i++)
+        strmap_insert(str, names[i], UINT_TO_PTR(i));
+    report("strmap", "insert", t, nkeys);
+    t = now();
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        sink += PTR_TO_UINT(*strmap_get(str, names[order[i]]));
+    report("strmap", "get", t, LOOKUPS);
+    hashmap_free(map);
+    strmap_free(str);
+}
+
+int main(int argc, char **argv)
+{
+    nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 65536;
+    if (nkeys == 0)
+        return 1;
+    addrs = malloc(nkeys * sizeof(*addrs));
+    endps = malloc(nkeys * sizeof(*endps));
+    names = malloc(nkeys * sizeof(*names));
+    order = malloc(LOOKUPS * sizeof(*order));
+    srand(1);
+
+    /* hosts in a /16 network and connections from them to a few servers */
+    for (unsigned int i = 0; i < nkeys; i++) {
+        addrs[i] = 0x0a000000 | (i & 0xffff) | (i >> 16) << 24;
+        endps[i].src = addrs[i];
+        endps[i].dst = 0xc0a80001 + rand() % 16;
+        endps[i].sport = 1024 + rand() % 64512;
+        endps[i].dport = rand() % 2 ? 443 : 80;
+        names[i] = malloc(32);
+        snprintf(names[i], 32, "host%u.example.com", i);
+    }
+    for (unsigned int i = 0; i < LOOKUPS; i++)
+        order[i] = rand() % nkeys;
+    printf("%u keys, %u lookups\n", nkeys, LOOKUPS);
+    printf("IPv4 addresses\n");
+    bench_uint32();
+    printf("TCP endpoints\n");
+    bench_endpoint();
+    printf("TCP flow cache\n");
+    bench_flow_cache();
+    printf("Strings\n");
+    bench_string();
+    printf("Insert latency\n");
+    bench_latency();
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <check.h>
+#include <stdlib.h>
+#include "../decoder/tcp_analyzer.h"
+#include "../hashmap_gen.h"
+
+#define NUM_KEYS (1 << 16)
+
+START_TEST(hashmap_gen_test_u32map)
+{
+    static bool present[NUM_KEYS];
+    struct u32map_slot *slot;
+    u32map_t *map = u32map_init(4);
+    unsigned int n = 0;
+    void **value;
+
+    /* random inserts and removes, checked against a bitmap */
+    srand(1);
+    for (int i = 0; i < 1000000; i++) {
+        uint32_t key = rand() % NUM_KEYS;
+
+        switch (rand() % 3) {
+        case 0:
+            ck_assert(u32map_insert(map, key, UINT_TO_PTR(key + 1)) == !present[key]);
+            present[key] = true;
+            break;
+        case 1:
+            ck_assert(u32map_remove(map, key) == present[key]);
+            present[key] = false;
+            break;
+        default:
+            value = u32map_get(map, key);
+            ck_assert((value != NULL) == present[key]);
+            if (value)
+                ck_assert_uint_eq(PTR_TO_UINT(*value), key + 1);
+            break;
+        }
+    }
+    HASHMAP_GEN_FOREACH(u32map, map, slot) {
+        ck_assert(present[slot->key]);
+        n++;
+    }
+    ck_assert_uint_eq(n, u32map_size(map));
+    for (int i = 0; i < NUM_KEYS; i++)
+        n -= present[i];
+    ck_assert_uint_eq(n, 0);
+    u32map_clear(map);
+    ck_assert_uint_eq(u32map_size(map), 0);
+    ck_assert(u32map_first(map) == NULL);
+    u32map_free(map);
+}
+END_TEST
+
+START_TEST(hashmap_gen_test_strmap)
+{
+    char *keys[] = { "eth", "ip", "ip6", "tcp", "udp", "dns", "http", "tls" };
+    strmap_t *map = strmap_init(0);
+    char buf[8];
+
+    for (unsigned int i = 0; i < ARRAY_SIZE(keys); i++)
+        ck_assert(strmap_insert(map, keys[i], UINT_TO_PTR(i)));
+    ck_assert(!strmap_insert(map, "tcp", UINT_TO_PTR(100)));
+    ck_assert_uint_eq(strmap_size(map), ARRAY_SIZE(keys));
+
+    /* the keys are compared, not the pointers */
+    strcpy(buf, "tcp");
+    ck_assert_uint_eq(PTR_TO_UINT(*strmap_get(map, buf)), 100);
+    ck_assert(strmap_get(map, "arp") == NULL);
+    ck_assert(strmap_remove(map, "ip"));
+    ck_assert(!strmap_remove(map, "ip"));
+    ck_assert(strmap_get(map, "ip") == NULL);
+    ck_assert_uint_eq(PTR_TO_UINT(*strmap_get(map, "ip6")), 2);
+    strmap_free(map);
+}
+END_TEST
+
+START_TEST(hashmap_gen_test_flowmap)
+{
+    struct tcp_endpoint_v4 endp = { 1234, 80, 0x0100000a, 0x0200000a };
+    struct tcp_endpoint_v4 reply = { 80, 1234, 0x0200000a, 0x0100000a };
+    flowmap_t *map = flowmap_init(0);
+
+    /* both directions of a connection have the same key */
+    for (unsigned int i = 0; i < 1000; i++) {
+        endp.sport = 1024 + i;
+        ck_assert(flowmap_insert(map, tcp_flow_key(&endp), UINT_TO_PTR(i)));
+    }
+    for (unsigned int i = 0; i < 1000; i++) {
+        reply.dport = 1024 + i;
+        ck_assert_uint_eq(PTR_TO_UINT(*flowmap_get(map, tcp_flow_key(&reply))), i);
+    }
+    reply.dport = 80;
+    ck_assert(flowmap_get(map, tcp_flow_key(&reply)) == NULL);
+    ck_assert(flowmap_remove(map, tcp_flow_key(&endp)));
+    ck_assert_uint_eq(flowmap_size(map), 999);
+    flowmap_free(map);
+}
+END_TEST
+
+Suite *hashmap_gen_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("hashmap_gen");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, hashmap_gen_test_u32map);
+    tcase_add_test(tc_core, hashmap_gen_test_strmap);
+    tcase_add_test(tc_core, hashmap_gen_test_flowmap);
+    return s;
+}
@@ -3,6 +3,7 @@
 #include "../util.h"
 #include "../hashmap.h"
 #include "../hash.h"
+#include "../decoder/tcp_analyzer.h"
 
 START_TEST(hashmap_test_create)
 {
@@ -159,6 +160,135 @@ START_TEST(hashmap_test_id)
 }
 END_TEST
 
+START_TEST(hashmap_test_precomputed_hash)
+{
+    hashmap_t *map = hashmap_init(16, NULL, NULL);
+
+    /* the hash is unrelated to the key and must survive the resizes */
+    for (unsigned int i = 1; i <= 100; i++)
+        ck_assert(hashmap_insert_hash(map, UINT_TO_PTR(i), UINT_TO_PTR(i), i * 2654435761u));
+    ck_assert(hashmap_size(map) == 100);
+    for (unsigned int i = 1; i <= 100; i++)
+        ck_assert(PTR_TO_UINT(hashmap_get_hash(map, UINT_TO_PTR(i), i * 2654435761u)) == i);
+    ck_assert(hashmap_insert_hash(map, UINT_TO_PTR(1), UINT_TO_PTR(101), 2654435761u) == false);
+    ck_assert(PTR_TO_UINT(hashmap_get_hash(map, UINT_TO_PTR(1), 2654435761u)) == 101);
+    for (unsigned int i = 1; i <= 100; i += 2)
+        hashmap_remove_hash(map, UINT_TO_PTR(i), i * 2654435761u);
+    ck_assert(hashmap_size(map) == 50);
+    for (unsigned int i = 2; i <= 100; i += 2)
+        ck_assert(PTR_TO_UINT(hashmap_get_hash(map, UINT_TO_PTR(i), i * 2654435761u)) == i);
+    ck_assert(hashmap_get_hash(map, UINT_TO_PTR(1), 2654435761u) == NULL);
+    hashmap_free(map);
+}
+END_TEST
+
+#define NUM_KEYS (1 << 16)
+
+/* Random inserts, removes and lookups while the table grows */
+START_TEST(hashmap_test_resize)
+{
+    static bool present[NUM_KEYS];
+    hashmap_t *map = hashmap_init(4, hashfnv_uint32, compare_uint);
+    const hashmap_iterator *it;
+    unsigned int n = 0;
+
+    srand(2);
+    for (int i = 0; i < 1000000; i++) {
+        uint32_t key = rand() % NUM_KEYS;
+
+        switch (rand() % 4) {
+        case 0:
+        case 1:
+            ck_assert(hashmap_insert(map, UINT_TO_PTR(key), UINT_TO_PTR(key + 1)) == !present[key]);
+            present[key] = true;
+            break;
+        case 2:
+            hashmap_remove(map, UINT_TO_PTR(key));
+            present[key] = false;
+            break;
+        default:
+            ck_assert(PTR_TO_UINT(hashmap_get(map, UINT_TO_PTR(key))) == (present[key] ? key + 1 : 0));
+            break;
+        }
+    }
+    for (int i = 0; i < NUM_KEYS; i++)
+        n += present[i];
+    ck_assert_uint_eq(hashmap_size(map), n);
+    HASHMAP_FOREACH(map, it) {
+        ck_assert(present[PTR_TO_UINT(it->key)]);
+        n--;
+    }
+    ck_assert_uint_eq(n, 0);
+    hashmap_free(map);
+}
+END_TEST
+
+#define NUM_FLOWS 20000
+
+static void check_probe_length(hashmap_t *map)
+{
+    hashmap_stat_t stat = hashmap_get_stat(map);
+
+    ck_assert_msg(stat.avgpc < 2.5, "Average probe count %f", stat.avgpc);
+    ck_assert_msg(stat.lpc < 40, "Longest probe count %u", stat.lpc);
+}
+
+/*
+ * Flows whose ports add to the same sum, as from a port scan or behind a NAT
+ * gateway, must not collide.
+ */
+START_TEST(hashmap_test_flow_probe_length)
+{
+    hashmap_t *map = hashmap_init(16, hash_tcp_v4, compare_tcp_v4);
+    struct tcp_endpoint_v4 *endp = malloc(NUM_FLOWS * sizeof(*endp));
+    struct tcp_endpoint_v4 rev;
+
+    for (int i = 0; i < NUM_FLOWS; i++) {
+        endp[i].src = 0x0a000001;
+        endp[i].dst = 0x0a000002;
+        endp[i].sport = 1024 + i;
+        endp[i].dport = 60000 - i;
+        ck_assert(hashmap_insert(map, &endp[i], &endp[i]));
+    }
+    ck_assert_uint_eq(hashmap_size(map), NUM_FLOWS);
+    check_probe_length(map);
+
+    /* both directions find the same flow */
+    for (int i = 0; i < NUM_FLOWS; i++) {
+        rev.src = endp[i].dst;
+        rev.dst = endp[i].src;
+        rev.sport = endp[i].dport;
+        rev.dport = endp[i].sport;
+        ck_assert(hashmap_get(map, &rev) == &endp[i]);
+    }
+
+    /* a scan of every port on a host */
+    hashmap_clear(map);
+    for (int i = 0; i < NUM_FLOWS; i++) {
+        endp[i].src = 0x0a000001;
+        endp[i].dst = 0x0a000002 + i % 4;
+        endp[i].sport = 40000;
+        endp[i].dport = i / 4;
+        ck_assert(hashmap_insert(map, &endp[i], &endp[i]));
+    }
+    check_probe_length(map);
+    hashmap_free(map);
+    free(endp);
+}
+END_TEST
+
+START_TEST(hashmap_test_flow_compare)
+{
+    struct tcp_endpoint_v4 e1 = { .src = 0xffffffff, .dst = 1, .sport = 80, .dport = 1024 };
+    struct tcp_endpoint_v4 e2 = { .src = 1, .dst = 0xfffffffe, .sport = 80, .dport = 1024 };
+
+    /* an arithmetic difference of the fields would overflow */
+    ck_assert_int_gt(compare_tcp_v4(&e1, &e2), 0);
+    ck_assert_int_lt(compare_tcp_v4(&e2, &e1), 0);
+    ck_assert_int_eq(compare_tcp_v4(&e1, &e1), 0);
+}
+END_TEST
+
 Suite *hashmap_suite(void)
 {
     Suite *s;
@@ -174,6 +304,10 @@ Suite *hashmap_suite(void)
     tcase_add_test(tc_core, hashmap_test_iterate);
     tcase_add_test(tc_core, hashmap_test_iterate_same_id);
     tcase_add_test(tc_core, hashmap_test_id);
+    tcase_add_test(tc_core, hashmap_test_precomputed_hash);
+    tcase_add_test(tc_core, hashmap_test_resize);
+    tcase_add_test(tc_core, hashmap_test_flow_probe_length);
+    tcase_add_test(tc_core, hashmap_test_flow_compare);
     tcase_set_timeout(tc_core, 60);
     return s;
 }
@@ -0,0 +1,88 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lz.h"
+
+#define BUFSIZE (256 * 1024)
+
+static unsigned char src[BUFSIZE];
+static unsigned char comp[BUFSIZE + BUFSIZE / 8];
+static unsigned char dst[BUFSIZE];
+
+static size_t roundtrip(size_t len)
+{
+    size_t n;
+
+    n = lz_compress(src, len, comp, sizeof(comp));
+    ck_assert(n > 0);
+    ck_assert_uint_eq(lz_decompress(comp, n, dst, sizeof(dst)), len);
+    ck_assert(memcmp(src, dst, len) == 0);
+    return n;
+}
+
+START_TEST(lz_test_repetitive)
+{
+    size_t n;
+
+    /* packet-like data: the same headers with a counter and some payload */
+    for (size_t i = 0; i < BUFSIZE; i += 64) {
+        memset(src + i, 0x45, 64);
+        memcpy(src + i + 8, &i, sizeof(i));
+    }
+    n = roundtrip(BUFSIZE);
+    ck_assert_msg(n < BUFSIZE / 4, "Compressed size %zu too large", n);
+    memset(src, 0, BUFSIZE);
+    roundtrip(BUFSIZE);
+}
+END_TEST
+
+START_TEST(lz_test_random)
+{
+    srand(1);
+    for (size_t i = 0; i < BUFSIZE; i++)
+        src[i] = rand();
+    roundtrip(BUFSIZE);
+    ck_assert_msg(lz_compress(src, BUFSIZE, comp, BUFSIZE - 1) == 0,
+                  "Random data should not fit in less space");
+}
+END_TEST
+
+START_TEST(lz_test_small)
+{
+    for (size_t len = 1; len < 64; len++) {
+        for (size_t i = 0; i < len; i++)
+            src[i] = i % 3;
+        roundtrip(len);
+    }
+}
+END_TEST
+
+START_TEST(lz_test_corrupt)
+{
+    size_t n;
+
+    for (size_t i = 0; i < BUFSIZE; i++)
+        src[i] = i % 251;
+    n = lz_compress(src, BUFSIZE, comp, sizeof(comp));
+    ck_assert(n > 0);
+    ck_assert_uint_eq(lz_decompress(comp, n, dst, BUFSIZE / 2), 0);
+    ck_assert_uint_eq(lz_decompress(comp, n - 1, dst, sizeof(dst)) == BUFSIZE, 0);
+    comp[0] = 0x0f; /* a match before the start of the output */
+    ck_assert_uint_eq(lz_decompress(comp, n, dst, sizeof(dst)), 0);
+}
+END_TEST
+
+Suite *lz_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("lz");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, lz_test_repetitive);
+    tcase_add_test(tc_core, lz_test_random);
+    tcase_add_test(tc_core, lz_test_small);
+    tcase_add_test(tc_core, lz_test_corrupt);
+    return s;
+}
@@ -9,6 +9,14 @@ int main()
     sr = srunner_create(hashmap_suite());
     srunner_add_suite(sr, bpf_suite());
     srunner_add_suite(sr, rbtree_suite());
+    srunner_add_suite(sr, queue_suite());
+    srunner_add_suite(sr, vector_suite());
+    srunner_add_suite(sr, summary_suite());
+    srunner_add_suite(sr, options_suite());
+    srunner_add_suite(sr, lz_suite());
+    srunner_add_suite(sr, mempool_suite());
+    srunner_add_suite(sr, hashmap_gen_suite());
+    srunner_add_suite(sr, svector_suite());
     srunner_run_all(sr, CK_NORMAL);
     number_failed = srunner_ntests_failed(sr);
     srunner_free(sr);
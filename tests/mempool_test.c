@@ -0,0 +1,70 @@
+#include <check.h>
+#include "../mempool.h"
+
+#define ALLOC_SIZE 512
+#define TOTAL_SIZE (16 * 1024 * 1024)
+
+START_TEST(mempool_test_stat)
+{
+    struct mempool_stat stat;
+    char *p;
+
+    mempool_init();
+    for (int i = 0; i < TOTAL_SIZE / ALLOC_SIZE; i++) {
+        p = mempool_alloc(ALLOC_SIZE);
+        memset(p, i, ALLOC_SIZE);
+    }
+    mempool_stat(POOL_PERM, &stat);
+    ck_assert_uint_ge(stat.reserved, TOTAL_SIZE);
+    ck_assert_uint_ge(stat.used, TOTAL_SIZE / 2);
+    ck_assert_uint_le(stat.used, stat.reserved);
+
+    /* the chunks grow, so far fewer than with fixed 16 KB chunks are needed */
+    ck_assert_uint_lt(stat.chunks, 32);
+    ck_assert_uint_le(stat.huge_chunks, stat.chunks);
+    mempool_free(NULL);
+    mempool_stat(POOL_PERM, &stat);
+    ck_assert_uint_eq(stat.chunks, 1);
+    ck_assert_uint_eq(stat.used, 0);
+    mempool_destruct();
+    mempool_stat(POOL_PERM, &stat);
+    ck_assert_uint_eq(stat.chunks, 0);
+    ck_assert_uint_eq(stat.reserved, 0);
+}
+END_TEST
+
+START_TEST(mempool_test_ctx)
+{
+    struct mempool_stat before, after;
+    mempool_ctx_t *ctx;
+
+    mempool_init();
+    mempool_stat(POOL_PERM, &before);
+    ctx = mempool_ctx_create();
+    mempool_ctx_set(ctx);
+    for (int i = 0; i < TOTAL_SIZE / ALLOC_SIZE; i++)
+        mempool_alloc(ALLOC_SIZE);
+    mempool_ctx_set(NULL);
+    mempool_stat(POOL_PERM, &after);
+    ck_assert_uint_ge(mempool_ctx_size(ctx), TOTAL_SIZE);
+    ck_assert_uint_ge(after.reserved - before.reserved, TOTAL_SIZE);
+    mempool_ctx_free(ctx);
+    mempool_stat(POOL_PERM, &after);
+    ck_assert_uint_eq(after.reserved, before.reserved);
+    ck_assert_uint_eq(after.chunks, before.chunks);
+    mempool_destruct();
+}
+END_TEST
+
+Suite *mempool_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("mempool");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, mempool_test_stat);
+    tcase_add_test(tc_core, mempool_test_ctx);
+    return s;
+}
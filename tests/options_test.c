@@ -0,0 +1,165 @@
+#include <check.h>
+#include <stdlib.h>
+#include "../decoder/packet_tcp.h"
+#include "../decoder/packet_dns.h"
+
+#define ITERATIONS 100000
+
+/*
+ * Count the heap allocations made while the options are parsed. With glibc
+ * malloc can be interposed and forward to the libc implementation.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+void *malloc(size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static unsigned char tcp_options[] = {
+    TCP_OPT_MSS, 4, 0x05, 0xb4,
+    TCP_OPT_NOP,
+    TCP_OPT_WIN_SCALE, 3, 7,
+    TCP_OPT_SAP, 2,
+    TCP_OPT_TIMESTAMP, 10, 0, 0, 0, 1, 0, 0, 0, 2,
+    TCP_OPT_SACK, 18, 0, 0, 0, 10, 0, 0, 0, 20, 0, 0, 0, 30, 0, 0, 0, 40,
+    TCP_OPT_END, 0
+};
+
+static unsigned char dns_options[] = {
+    0, 10, 0, 8, 1, 2, 3, 4, 5, 6, 7, 8, /* cookie */
+    0, 12, 0, 0,                         /* padding */
+    0, 15, 0, 2, 0, 23                   /* extended error */
+};
+
+static int parse_tcp(unsigned char *data, int len, struct tcp_options *opts, int n)
+{
+    struct tcp_option_iterator it;
+    int i = 0;
+
+    tcp_options_begin(&it, data, len);
+    while (i < n && tcp_options_next(&it, &opts[i]))
+        i++;
+    return i;
+}
+
+static int parse_dns(struct dns_resource_record *rr)
+{
+    struct dns_option_iterator it;
+    struct dns_opt_rr opt;
+    int n = 0;
+
+    dns_options_begin(&it, rr);
+    while (dns_options_next(&it, &opt))
+        n++;
+    return n;
+}
+
+START_TEST(tcp_options_test)
+{
+    struct tcp_options opts[8];
+
+    ck_assert_int_eq(parse_tcp(tcp_options, sizeof(tcp_options), opts, 8), 6);
+    ck_assert_uint_eq(opts[0].mss, 1460);
+    ck_assert_uint_eq(opts[1].option_kind, TCP_OPT_NOP);
+    ck_assert_uint_eq(opts[2].win_scale, 7);
+    ck_assert(opts[3].sack_permitted);
+    ck_assert_uint_eq(opts[4].ts.ts_val, 1);
+    ck_assert_uint_eq(opts[4].ts.ts_ecr, 2);
+    ck_assert_uint_eq(opts[5].sack.num_blocks, 2);
+    ck_assert_uint_eq(opts[5].sack.blocks[1].left_edge, 30);
+    ck_assert_uint_eq(opts[5].sack.blocks[1].right_edge, 40);
+}
+END_TEST
+
+START_TEST(tcp_options_malformed_test)
+{
+    struct tcp_options opts[8];
+    unsigned char zero_length[] = { TCP_OPT_NOP, TCP_OPT_MSS, 0, 0x05, 0xb4 };
+    unsigned char too_long[] = { TCP_OPT_TIMESTAMP, 10, 0, 0, 0, 1 };
+
+    ck_assert_int_eq(parse_tcp(zero_length, sizeof(zero_length), opts, 8), 1);
+    ck_assert_int_eq(parse_tcp(too_long, sizeof(too_long), opts, 8), 0);
+    ck_assert_int_eq(parse_tcp(NULL, 0, opts, 8), 0);
+}
+END_TEST
+
+START_TEST(dns_options_test)
+{
+    struct dns_resource_record rr;
+    struct dns_option_iterator it;
+    struct dns_opt_rr opt;
+
+    rr.rdata.opt.data = dns_options;
+    rr.rdata.opt.rdlen = sizeof(dns_options);
+    ck_assert_int_eq(parse_dns(&rr), 3);
+    dns_options_begin(&it, &rr);
+    ck_assert(dns_options_next(&it, &opt));
+    ck_assert_uint_eq(opt.option_code, 10);
+    ck_assert_uint_eq(opt.option_length, 8);
+    ck_assert_uint_eq(opt.data[7], 8);
+    rr.rdata.opt.rdlen = sizeof(dns_options) - 1;
+    ck_assert_int_eq(parse_dns(&rr), 2);
+}
+END_TEST
+
+/* Parse the options of many packets and check that nothing is allocated */
+START_TEST(options_allocation_test)
+{
+#ifdef __GLIBC__
+    struct dns_resource_record rr;
+    struct tcp_options opts[8];
+    int n = 0;
+
+    rr.rdata.opt.data = dns_options;
+    rr.rdata.opt.rdlen = sizeof(dns_options);
+    allocations = 0;
+    counting = true;
+    for (int i = 0; i < ITERATIONS; i++) {
+        n += parse_tcp(tcp_options, sizeof(tcp_options), opts, 8);
+        n += parse_dns(&rr);
+    }
+    counting = false;
+    ck_assert_int_eq(n, ITERATIONS * 9);
+    ck_assert_uint_eq(allocations, 0);
+#endif
+}
+END_TEST
+
+Suite *options_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("options");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, tcp_options_test);
+    tcase_add_test(tc_core, tcp_options_malformed_test);
+    tcase_add_test(tc_core, dns_options_test);
+    tcase_add_test(tc_core, options_allocation_test);
+    return s;
+}
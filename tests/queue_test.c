@@ -0,0 +1,101 @@
+#include <check.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../util.h"
+#include "../queue.h"
+
+START_TEST(queue_test_create)
+{
+    queue_t *q = queue_init(10);
+
+    ck_assert(q);
+    ck_assert(queue_empty(q));
+    ck_assert(queue_pop(q) == NULL);
+    ck_assert(queue_front(q) == NULL);
+    queue_free(q);
+}
+END_TEST
+
+START_TEST(queue_test_push_pop)
+{
+    queue_t *q = queue_init(16);
+
+    for (unsigned int i = 1; i <= 16; i++)
+        ck_assert(queue_push(q, UINT_TO_PTR(i)));
+    ck_assert_msg(queue_push(q, UINT_TO_PTR(17)) == false, "Queue should be full");
+    ck_assert_msg(queue_size(q) == 16, "Queue should contain 16 elements, but size is %u",
+                  queue_size(q));
+    ck_assert(PTR_TO_UINT(queue_front(q)) == 1);
+    for (unsigned int i = 1; i <= 16; i++)
+        ck_assert(PTR_TO_UINT(queue_pop(q)) == i);
+    ck_assert(queue_empty(q));
+    queue_free(q);
+}
+END_TEST
+
+START_TEST(queue_test_wrap)
+{
+    queue_t *q = queue_init(5); /* rounded up to 8 */
+
+    for (unsigned int i = 1; i <= 100; i++) {
+        ck_assert(queue_push(q, UINT_TO_PTR(i)));
+        ck_assert(queue_push(q, UINT_TO_PTR(i + 1000)));
+        ck_assert(PTR_TO_UINT(queue_pop(q)) == i);
+        ck_assert(PTR_TO_UINT(queue_pop(q)) == i + 1000);
+    }
+    ck_assert(queue_empty(q));
+    queue_free(q);
+}
+END_TEST
+
+#define NUM_ELEMENTS 1000000
+
+static void *produce(void *arg)
+{
+    queue_t *q = arg;
+
+    for (unsigned int i = 1; i <= NUM_ELEMENTS; i++) {
+        while (!queue_push(q, UINT_TO_PTR(i)))
+            sched_yield();
+    }
+    return NULL;
+}
+
+START_TEST(queue_test_threads)
+{
+    queue_t *q = queue_init(64);
+    pthread_t producer;
+    unsigned int i = 1;
+
+    ck_assert(pthread_create(&producer, NULL, produce, q) == 0);
+    while (i <= NUM_ELEMENTS) {
+        void *data;
+
+        if ((data = queue_pop(q)) == NULL) {
+            sched_yield();
+            continue;
+        }
+        ck_assert_msg(PTR_TO_UINT(data) == i, "Element %u out of order", i);
+        i++;
+    }
+    pthread_join(producer, NULL);
+    ck_assert(queue_empty(q));
+    queue_free(q);
+}
+END_TEST
+
+Suite *queue_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("queue");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, queue_test_create);
+    tcase_add_test(tc_core, queue_test_push_pop);
+    tcase_add_test(tc_core, queue_test_wrap);
+    tcase_add_test(tc_core, queue_test_threads);
+    tcase_set_timeout(tc_core, 60);
+    return s;
+}
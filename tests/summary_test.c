@@ -0,0 +1,192 @@
+#include <check.h>
+#include <arpa/inet.h>
+#include "../decoder/packet.h"
+#include "../decoder/packet_ip.h"
+#include "../decoder/summary.h"
+
+struct test_packet {
+    struct packet p;
+    struct packet_data eth, ip, udp;
+    struct eth_info eth_info;
+    struct ipv4_info ip_info;
+    struct udp_info udp_info;
+};
+
+static void make_packet(struct test_packet *t, uint32_t num, uint32_t src, uint16_t sport,
+                        uint32_t dst, uint16_t dport)
+{
+    memset(t, 0, sizeof(*t));
+    t->p.num = num;
+    t->p.wirelen = 100 + num;
+    t->p.time.tv_sec = num;
+    t->p.root = &t->eth;
+    t->eth.id = get_protocol_id(DATALINK, LINKTYPE_ETHERNET);
+    t->eth.data = &t->eth_info;
+    t->eth.next = &t->ip;
+    t->eth_info.ethertype = ETHERTYPE_IP;
+    t->ip.id = get_protocol_id(ETHERNET_II, ETHERTYPE_IP);
+    t->ip.data = &t->ip_info;
+    t->ip.next = &t->udp;
+    t->ip_info.protocol = IPPROTO_UDP;
+    t->ip_info.src = src;
+    t->ip_info.dst = dst;
+    t->udp.id = get_protocol_id(IP_PROTOCOL, IPPROTO_UDP);
+    t->udp.data = &t->udp_info;
+    t->udp_info.sport = sport;
+    t->udp_info.dport = dport;
+}
+
+START_TEST(summary_test_add)
+{
+    struct test_packet t1, t2, t3;
+    uint32_t i;
+
+    summary_init();
+    make_packet(&t1, 1, inet_addr("10.0.0.1"), 1234, inet_addr("10.0.0.2"), 53);
+    make_packet(&t2, 2, inet_addr("10.0.0.2"), 53, inet_addr("10.0.0.1"), 1234);
+    make_packet(&t3, 3, inet_addr("10.0.0.1"), 1235, inet_addr("10.0.0.2"), 53);
+    summary_add(&t1.p);
+    summary_add(&t2.p);
+    summary_add(&t3.p);
+    ck_assert_uint_eq(summary.size, 3);
+    i = summary_index(2);
+    ck_assert_uint_eq(summary.len[i], 102);
+    ck_assert_uint_eq(summary.time[i].tv_sec, 2);
+    ck_assert_uint_eq(summary.ethertype[i], ETHERTYPE_IP);
+    ck_assert_uint_eq(summary.protocol[i], IPPROTO_UDP);
+    ck_assert_uint_eq(summary.src[i], inet_addr("10.0.0.2"));
+    ck_assert_uint_eq(summary.dst[i], inet_addr("10.0.0.1"));
+    ck_assert_uint_eq(summary.sport[i], 53);
+    ck_assert_uint_eq(summary.dport[i], 1234);
+    ck_assert_uint_eq(summary.top[i], get_protocol_id(IP_PROTOCOL, IPPROTO_UDP));
+    ck_assert_msg(summary.flow[0] == summary.flow[1], "Flow id should not depend on direction");
+    ck_assert(summary.flow[0] != summary.flow[2]);
+    summary_free();
+}
+END_TEST
+
+START_TEST(summary_test_evict)
+{
+    struct test_packet t;
+
+    summary_init();
+    for (uint32_t num = 1; num <= 10000; num++) {
+        make_packet(&t, num, num, 1, 0, 2);
+        summary_add(&t.p);
+        if (num % 1000 == 0)
+            summary_evict(num - 500);
+    }
+    ck_assert_uint_eq(summary.first, 9501);
+    ck_assert_uint_eq(summary.size, 500);
+    for (uint32_t num = summary.first; num <= 10000; num++)
+        ck_assert_uint_eq(summary.src[summary_index(num)], num);
+    summary_evict(20000);
+    ck_assert_uint_eq(summary.size, 0);
+    summary_free();
+}
+END_TEST
+
+/* Write the Ethernet, IPv4 and UDP headers of the packet to its frame */
+static void make_frame(struct test_packet *t, unsigned char *frame, int ihl, uint16_t foffset)
+{
+    unsigned char *ip = frame + 14;
+    unsigned char *udp = ip + ihl * 4;
+
+    memset(frame, 0, 14 + ihl * 4 + 8);
+    frame[12] = ETHERTYPE_IP >> 8;
+    frame[13] = ETHERTYPE_IP & 0xff;
+    ip[0] = 0x40 | ihl;
+    ip[6] = foffset >> 8;
+    ip[7] = foffset & 0xff;
+    ip[9] = t->ip_info.protocol;
+    memcpy(ip + 12, &t->ip_info.src, 4);
+    memcpy(ip + 16, &t->ip_info.dst, 4);
+    udp[0] = t->udp_info.sport >> 8;
+    udp[1] = t->udp_info.sport & 0xff;
+    udp[2] = t->udp_info.dport >> 8;
+    udp[3] = t->udp_info.dport & 0xff;
+    t->ip_info.ihl = ihl;
+    t->ip_info.foffset = foffset;
+    t->p.buf = frame;
+    t->p.len = 14 + ihl * 4 + 8;
+}
+
+START_TEST(summary_test_filter)
+{
+    /* udp port 53 */
+    struct bpf_insn port[] = {
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 12 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 10, ETHERTYPE_IP },
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 23 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 8, IPPROTO_UDP },
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 20 },
+        { BPF_JMP | BPF_JSET | BPF_K, 6, 0, 0x1fff },
+        { BPF_LDX | BPF_B | BPF_MSH, 0, 0, 14 },
+        { BPF_LD | BPF_H | BPF_IND, 0, 0, 14 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 2, 0, 53 },
+        { BPF_LD | BPF_H | BPF_IND, 0, 0, 16 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 53 },
+        { BPF_RET | BPF_K, 0, 0, -1 },
+        { BPF_RET | BPF_K, 0, 0, 0 }
+    };
+    /* ip src 10.0.0.1 */
+    struct bpf_insn src[] = {
+        { BPF_LD | BPF_H | BPF_ABS, 0, 0, 12 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 3, ETHERTYPE_IP },
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, 26 },
+        { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0x0a000001 },
+        { BPF_RET | BPF_K, 0, 0, -1 },
+        { BPF_RET | BPF_K, 0, 0, 0 }
+    };
+    /* ip[0] & 0xf > 5, which reads a field that is not in the summary */
+    struct bpf_insn ihl[] = {
+        { BPF_LD | BPF_B | BPF_ABS, 0, 0, 14 },
+        { BPF_ALU | BPF_AND | BPF_K, 0, 0, 0xf },
+        { BPF_JMP | BPF_JGT | BPF_K, 0, 1, 5 },
+        { BPF_RET | BPF_K, 0, 0, -1 },
+        { BPF_RET | BPF_K, 0, 0, 0 }
+    };
+    struct bpf_prog progs[] = {
+        { port, sizeof(port) / sizeof(port[0]) },
+        { src, sizeof(src) / sizeof(src[0]) }
+    };
+    struct bpf_prog other = { ihl, sizeof(ihl) / sizeof(ihl[0]) };
+    struct test_packet t[4];
+    unsigned char frames[4][64];
+    uint32_t res;
+
+    summary_init();
+    make_packet(&t[0], 1, inet_addr("10.0.0.1"), 1234, inet_addr("10.0.0.2"), 53);
+    make_frame(&t[0], frames[0], 5, 0);
+    make_packet(&t[1], 2, inet_addr("10.0.0.2"), 53, inet_addr("10.0.0.1"), 1234);
+    make_frame(&t[1], frames[1], 6, 0); /* with IP options */
+    make_packet(&t[2], 3, inet_addr("10.0.0.1"), 1235, inet_addr("10.0.0.3"), 80);
+    make_frame(&t[2], frames[2], 5, 0);
+    make_packet(&t[3], 4, inet_addr("10.0.0.2"), 53, inet_addr("10.0.0.1"), 1234);
+    make_frame(&t[3], frames[3], 5, 0x20); /* not the first fragment */
+    for (int i = 0; i < 4; i++)
+        summary_add(&t[i].p);
+    for (unsigned int j = 0; j < sizeof(progs) / sizeof(progs[0]); j++) {
+        for (int i = 0; i < 4; i++) {
+            ck_assert(summary_run_filter(progs[j], i, &res));
+            ck_assert_uint_eq(res, (uint32_t) bpf_run_filter(progs[j], t[i].p.buf, t[i].p.len));
+        }
+    }
+    ck_assert(!summary_run_filter(other, 0, &res));
+    summary_free();
+}
+END_TEST
+
+Suite *summary_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("summary");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, summary_test_add);
+    tcase_add_test(tc_core, summary_test_evict);
+    tcase_add_test(tc_core, summary_test_filter);
+    return s;
+}
@@ -0,0 +1,65 @@
+#include <check.h>
+#include "../util.h"
+#include "../svector.h"
+
+START_TEST(svector_test_push_get)
+{
+    svector_t *v = svector_init();
+
+    /* several chunks and directory resizes */
+    for (unsigned int i = 0; i < 100000; i++)
+        svector_push_back(v, UINT_TO_PTR(i));
+    ck_assert(svector_size(v) == 100000);
+    for (unsigned int i = 0; i < 100000; i++)
+        ck_assert(PTR_TO_UINT(svector_get(v, i)) == i);
+    ck_assert(svector_get(v, 100000) == NULL);
+    ck_assert(svector_get(v, -1) == NULL);
+    ck_assert(PTR_TO_UINT(svector_back(v)) == 99999);
+    svector_clear(v, NULL);
+    ck_assert(svector_size(v) == 0);
+    ck_assert(svector_back(v) == NULL);
+    svector_push_back(v, UINT_TO_PTR(1));
+    ck_assert(PTR_TO_UINT(svector_get(v, 0)) == 1);
+    svector_free(v, NULL);
+}
+END_TEST
+
+START_TEST(svector_test_erase_front)
+{
+    svector_t *v = svector_init();
+    unsigned int first = 0;
+    unsigned int last = 0;
+
+    /* the chunks in front are deallocated and the directory is reused */
+    for (unsigned int n = 0; n < 100000; n++) {
+        for (int i = 0; i < 10; i++)
+            svector_push_back(v, UINT_TO_PTR(last++));
+        svector_erase_front(v, 7, NULL);
+        first += 7;
+        ck_assert(svector_size(v) == (int) (last - first));
+        ck_assert(PTR_TO_UINT(svector_get(v, 0)) == first);
+        ck_assert(PTR_TO_UINT(svector_back(v)) == last - 1);
+    }
+    for (int i = 0; i < svector_size(v); i++)
+        ck_assert(PTR_TO_UINT(svector_get(v, i)) == first + i);
+    svector_erase_front(v, svector_size(v) + 1, NULL);
+    ck_assert(svector_size(v) == 0);
+    ck_assert(svector_back(v) == NULL);
+    svector_push_back(v, UINT_TO_PTR(1));
+    ck_assert(PTR_TO_UINT(svector_get(v, 0)) == 1);
+    svector_free(v, NULL);
+}
+END_TEST
+
+Suite *svector_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("svector");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, svector_test_push_get);
+    tcase_add_test(tc_core, svector_test_erase_front);
+    return s;
+}
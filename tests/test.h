@@ -4,5 +4,13 @@
 Suite *hashmap_suite(void);
 Suite *bpf_suite(void);
 Suite *rbtree_suite(void);
+Suite *queue_suite(void);
+Suite *vector_suite(void);
+Suite *summary_suite(void);
+Suite *options_suite(void);
+Suite *lz_suite(void);
+Suite *mempool_suite(void);
+Suite *hashmap_gen_suite(void);
+Suite *svector_suite(void);
 
 #endif
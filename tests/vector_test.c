@@ -0,0 +1,59 @@
+#include <check.h>
+#include "../util.h"
+#include "../vector.h"
+
+START_TEST(vector_test_push_get)
+{
+    vector_t *v = vector_init(2);
+
+    for (unsigned int i = 0; i < 100; i++)
+        vector_push_back(v, UINT_TO_PTR(i));
+    ck_assert(vector_size(v) == 100);
+    for (unsigned int i = 0; i < 100; i++)
+        ck_assert(PTR_TO_UINT(vector_get(v, i)) == i);
+    ck_assert(vector_get(v, 100) == NULL);
+    ck_assert(PTR_TO_UINT(vector_back(v)) == 99);
+    vector_free(v, NULL);
+}
+END_TEST
+
+START_TEST(vector_test_erase_front)
+{
+    vector_t *v = vector_init(16);
+    unsigned int first = 0;
+    unsigned int last = 0;
+
+    /* erasing from the front and pushing at the back reuses the space */
+    for (unsigned int n = 0; n < 1000; n++) {
+        for (int i = 0; i < 10; i++)
+            vector_push_back(v, UINT_TO_PTR(last++));
+        vector_erase_front(v, 7, NULL);
+        first += 7;
+        ck_assert(vector_size(v) == (int) (last - first));
+        ck_assert(PTR_TO_UINT(vector_get(v, 0)) == first);
+        ck_assert(PTR_TO_UINT(vector_back(v)) == last - 1);
+    }
+    for (int i = 0; i < vector_size(v); i++)
+        ck_assert(PTR_TO_UINT(vector_get(v, i)) == first + i);
+    ck_assert(PTR_TO_UINT(* (void **) vector_data(v)) == first);
+    vector_erase_front(v, vector_size(v) + 1, NULL);
+    ck_assert(vector_size(v) == 0);
+    ck_assert(vector_back(v) == NULL);
+    vector_push_back(v, UINT_TO_PTR(1));
+    ck_assert(PTR_TO_UINT(vector_get(v, 0)) == 1);
+    vector_free(v, NULL);
+}
+END_TEST
+
+Suite *vector_suite(void)
+{
+    Suite *s;
+    TCase *tc_core;
+
+    s = suite_create("vector");
+    tc_core = tcase_create("Core");
+    suite_add_tcase(s, tc_core);
+    tcase_add_test(tc_core, vector_test_push_get);
+    tcase_add_test(tc_core, vector_test_erase_front);
+    return s;
+}
@@ -6,7 +6,7 @@
 #include "menu.h"
 #include "decoder/tcp_analyzer.h"
 #include "decoder/packet.h"
-#include "decoder/packet_ip.h"
+#include "decoder/summary.h"
 #include "monitor.h"
 #include "process.h"
 #include "conversation_screen.h"
@@ -120,12 +120,12 @@ static void update_screen_buf(screen *s)
     cs = (connection_screen *) s;
     vector_clear(cs->screen_buf, NULL);
     if (view == CONNECTION_PAGE) {
-        hashmap_t *sessions = tcp_analyzer_get_sessions();
-        const hashmap_iterator *it;
+        flowmap_t *sessions = tcp_analyzer_get_sessions();
+        struct flowmap_slot *slot;
         struct tcp_connection_v4 *conn;
 
-        HASHMAP_FOREACH(sessions, it) {
-            conn = it->data;
+        HASHMAP_GEN_FOREACH(flowmap, sessions, slot) {
+            conn = slot->value;
             if (mode == REMOVE_CLOSED) {
                 if (conn->state != CLOSED && conn->state != RESET)
                     vector_push_back(cs->screen_buf, conn);
@@ -151,6 +151,7 @@ static void print_process(connection_screen *cs, struct process *proc, int y)
     struct tcp_connection_v4 *conn;
     struct packet *p;
     unsigned int nconn = 0;
+    uint32_t i;
 
     if (!proc->name)
         return;
@@ -178,12 +179,13 @@ static void print_process(connection_screen *cs, struct process *proc, int y)
         entry[PORTB].val = conn->endp->dport;
         DLIST_FOREACH(conn->packets, m) {
             p = list_data(m);
-            if (entry[ADDRA].val == ipv4_src(p) && entry[PORTA].val == tcp_member(p, sport)) {
-                entry[BYTES_AB].val += p->len;
+            i = summary_index(p->num);
+            if (entry[ADDRA].val == summary.src[i] && entry[PORTA].val == summary.sport[i]) {
+                entry[BYTES_AB].val += summary.len[i];
                 entry[PACKETS_AB].val++;
-            } else if (entry[ADDRB].val == ipv4_src(p) &&
-                       entry[PORTB].val == tcp_member(p, sport)) {
-                entry[BYTES_BA].val += p->len;
+            } else if (entry[ADDRB].val == summary.src[i] &&
+                       entry[PORTB].val == summary.sport[i]) {
+                entry[BYTES_BA].val += summary.len[i];
                 entry[PACKETS_BA].val++;
             }
         }
@@ -201,6 +203,7 @@ static void print_connection(connection_screen *cs, struct tcp_connection_v4 *co
 {
     const node_t *n = list_begin(conn->packets);
     struct packet *p;
+    uint32_t i;
     char *state;
     int x = 0;
     struct cs_entry entry[NUM_VALS];
@@ -209,22 +212,22 @@ static void print_connection(connection_screen *cs, struct tcp_connection_v4 *co
     memset(entry, 0, sizeof(entry));
     inet_ntop(AF_INET, &conn->endp->src, entry[ADDRA].buf, INET_ADDRSTRLEN);
     inet_ntop(AF_INET, &conn->endp->dst, entry[ADDRB].buf, INET_ADDRSTRLEN);
-    p = list_data(n);
     entry[ADDRA].val = conn->endp->src;
     entry[PORTA].val = conn->endp->sport;
     entry[ADDRB].val = conn->endp->dst;
     entry[PORTB].val = conn->endp->dport;
     while (n) {
         p = list_data(n);
-        if (entry[ADDRA].val == ipv4_src(p) && entry[PORTA].val == tcp_member(p, sport)) {
-            entry[BYTES_AB].val += p->len;
+        i = summary_index(p->num);
+        if (entry[ADDRA].val == summary.src[i] && entry[PORTA].val == summary.sport[i]) {
+            entry[BYTES_AB].val += summary.len[i];
             entry[PACKETS_AB].val++;
-        } else if (entry[ADDRB].val == ipv4_src(p) &&
-                   entry[PORTB].val == tcp_member(p, sport)) {
-            entry[BYTES_BA].val += p->len;
+        } else if (entry[ADDRB].val == summary.src[i] &&
+                   entry[PORTB].val == summary.sport[i]) {
+            entry[BYTES_BA].val += summary.len[i];
             entry[PACKETS_BA].val++;
         }
-        entry[BYTES].val += p->len;
+        entry[BYTES].val += summary.len[i];
         n = list_next(n);
     }
     state = tcp_analyzer_get_connection_state(conn->state);
@@ -354,7 +357,7 @@ void connection_screen_get_input(screen *s)
     case KEY_ENTER:
     case '\n':
         cvs = (conversation_screen *) screen_cache_get(CONVERSATION_SCREEN);
-        cvs->stream = vector_get(cs->screen_buf, s->selectionbar);
+        conversation_screen_set_stream(cvs, vector_get(cs->screen_buf, s->selectionbar));
         screen_stack_move_to_top((screen *) cvs);
         break;
     case 'f':
@@ -382,6 +385,21 @@ void connection_screen_get_input(screen *s)
     }
 }
 
+void connection_screen_evict(connection_screen *cs)
+{
+    screen *s = (screen *) cs;
+
+    if (!active)
+        return;
+    update_screen_buf(s);
+    if (s->top >= vector_size(cs->screen_buf))
+        s->top = 0;
+    if (s->selectionbar >= vector_size(cs->screen_buf))
+        s->selectionbar = s->top;
+    if (s->focus)
+        connection_screen_refresh(s);
+}
+
 static unsigned int connection_screen_get_size(screen *s)
 {
     return vector_size(((connection_screen *) s)->screen_buf);
@@ -15,4 +15,7 @@ typedef struct {
 connection_screen *connection_screen_create(void);
 void connection_screen_free(screen *s);
 
+/* Update the screen after connections have been removed by the retention */
+void connection_screen_evict(connection_screen *cs);
+
 #endif
@@ -9,7 +9,7 @@
 #include "list.h"
 #include "error.h"
 #include "monitor.h"
-#include "vector.h"
+#include "svector.h"
 #include "decoder/decoder.h"
 #include "stack.h"
 #include "file.h"
@@ -27,8 +27,6 @@
 #include "process.h"
 #include "actionbar.h"
 
-#define TCP_PAGE_SIZE 1000
-
 enum follow_tcp_mode {
     NORMAL,
     ASCII,
@@ -38,7 +36,7 @@ enum follow_tcp_mode {
 
 struct tcp_page {
     int top;
-    vector_t *buf;
+    svector_t *buf;
 };
 
 struct tcp_page_attr {
@@ -46,7 +44,7 @@ struct tcp_page_attr {
     int col;
 };
 
-extern vector_t *packets;
+extern svector_t *packets;
 extern main_menu *menu;
 static bool input_mode = false;
 static progress_dialogue *pd = NULL;
@@ -102,7 +100,7 @@ static void fill_screen_buffer(conversation_screen *cs)
     const node_t *n;
 
     DLIST_FOREACH(cs->stream->packets, n)
-        vector_push_back(cs->base.packet_ref, list_data(n));
+        svector_push_back(cs->base.packet_ref, list_data(n));
 }
 
 conversation_screen *conversation_screen_create(void)
@@ -124,12 +122,12 @@ void conversation_screen_init(screen *s)
     cs->base.packet_ref = NULL;
     s->show_selectionbar = true;
     memset(&tcp_page, 0, sizeof(struct tcp_page));
-    tcp_page.buf = vector_init(TCP_PAGE_SIZE);
+    tcp_page.buf = svector_init();
 }
 
 void conversation_screen_free(screen *s)
 {
-    vector_free(tcp_page.buf, free_tcp_attr);
+    svector_free(tcp_page.buf, free_tcp_attr);
     delwin(((main_screen *) s)->subwindow.win);
     delwin(((main_screen *) s)->header);
     if (((main_screen *) s)->lvw) {
@@ -158,7 +156,7 @@ void conversation_screen_got_focus(screen *s, screen *oldscr)
     ((main_screen *) s)->follow_stream = true;
     tcp_analyzer_subscribe(add_packet);
     if (oldscr->fullscreen) {
-        cs->base.packet_ref = vector_init(list_size(cs->stream->packets));
+        cs->base.packet_ref = svector_init();
         fill_screen_buffer(cs);
         actionbar_update(s, "F7", NULL, true);
     }
@@ -171,19 +169,29 @@ void conversation_screen_lost_focus(screen *s, screen *newscr)
     ((main_screen *) s)->follow_stream = false;
     tcp_analyzer_unsubscribe(add_packet);
     if (newscr->fullscreen) {
-        vector_free(cs->base.packet_ref, NULL);
+        svector_free(cs->base.packet_ref, NULL);
+        cs->base.packet_ref = NULL;
         s->top = 0;
         s->selectionbar = 0;
         actionbar_update(s, "F7", NULL, ctx.capturing);
     }
 }
 
+void conversation_screen_set_stream(conversation_screen *cs, struct tcp_connection_v4 *stream)
+{
+    if (cs->stream)
+        tcp_analyzer_unref(cs->stream);
+    if (stream)
+        tcp_analyzer_ref(stream);
+    cs->stream = stream;
+}
+
 static void conversation_screen_on_back(screen *s)
 {
-    ((conversation_screen *) s)->stream = NULL;
+    conversation_screen_set_stream((conversation_screen *) s, NULL);
     ((main_screen *) s)->follow_stream = false;
     tcp_mode = NORMAL;
-    vector_clear(tcp_page.buf, free_tcp_attr);
+    svector_clear(tcp_page.buf, free_tcp_attr);
     tcp_page.top = 0;
 }
 
@@ -256,7 +264,7 @@ void conversation_screen_get_input(screen *s)
         }
         break;
     case KEY_F(5):
-        if (!ctx.capturing && vector_size(cs->base.packet_ref) > 0) {
+        if (!ctx.capturing && svector_size(cs->base.packet_ref) > 0) {
             create_save_dialogue();
         }
         break;
@@ -275,7 +283,7 @@ void conversation_screen_get_input(screen *s)
 
 static unsigned int conversation_screen_get_size(screen *s)
 {
-    return vector_size(((conversation_screen *) s)->base.packet_ref);
+    return svector_size(((conversation_screen *) s)->base.packet_ref);
 }
 
 static void conversation_screen_render(conversation_screen *cs)
@@ -284,8 +292,8 @@ static void conversation_screen_render(conversation_screen *cs)
     char buf[MAXLINE];
     int my = getmaxy(s->win);
 
-    for (int i = 0; i < my && i < vector_size(cs->base.packet_ref); i++) {
-        write_to_buf(buf, MAXLINE, vector_get(cs->base.packet_ref, i));
+    for (int i = 0; i < my && i < svector_size(cs->base.packet_ref); i++) {
+        write_to_buf(buf, MAXLINE, svector_get(cs->base.packet_ref, i));
         mvprintnlw(s->win, i, 0, cs->base.scrollx, buf);
     }
 }
@@ -305,8 +313,8 @@ static void goto_end(conversation_screen *cs)
     int my = getmaxy(((screen *) cs)->win);
 
     if (tcp_mode != NORMAL) {
-        if (vector_size(tcp_page.buf) > my) {
-            tcp_page.top = vector_size(tcp_page.buf) - 1 - my;
+        if (svector_size(tcp_page.buf) > my) {
+            tcp_page.top = svector_size(tcp_page.buf) - 1 - my;
             print_tcppage(cs);
         }
     } else {
@@ -372,7 +380,7 @@ static void save_handle_ok(void *file)
 
         get_file_part(file);
         snprintf(title, MAXLINE, " Saving %s ", (char *) file);
-        pd = progress_dialogue_create(title, vector_size(cs->base.packet_ref));
+        pd = progress_dialogue_create(title, svector_size(cs->base.packet_ref));
         push_screen((screen *) pd);
         switch (tcp_mode) {
         case NORMAL:
@@ -398,15 +406,15 @@ static void save_handle_ok(void *file)
 static void export_handle_ok(void *file)
 {
     const rbtree_node_t *n;
-    vector_t *tmp;
+    svector_t *tmp;
     conversation_screen *cs;
 
     cs = (conversation_screen *) screen_cache_get(CONVERSATION_SCREEN);
-    tmp = vector_init(rbtree_size(cs->base.marked));
+    tmp = svector_init();
     RBTREE_FOREACH(cs->base.marked, n)
-        vector_push_back(tmp, vector_get(cs->base.packet_ref, PTR_TO_UINT(rbtree_get_key(n)) - 1));
+        svector_push_back(tmp, svector_get(cs->base.packet_ref, PTR_TO_UINT(rbtree_get_key(n)) - 1));
     main_screen_save(tmp, (const char *) file);
-    vector_free(tmp, NULL);
+    svector_free(tmp, NULL);
 }
 
 static void create_save_dialogue(void)
@@ -446,7 +454,7 @@ static void change_tcp_mode(conversation_screen *cs)
 {
     changing_tcp_mode = true;
     tcp_page.top = 0;
-    vector_clear(tcp_page.buf, free_tcp_attr);
+    svector_clear(tcp_page.buf, free_tcp_attr);
     switch (tcp_mode) {
     case NORMAL:
         werase(cs->base.header);
@@ -476,11 +484,11 @@ static void buffer_tcppage(conversation_screen *cs, int (*buffer_fn)
     uint16_t cli_port = 0;
     progress_dialogue *pd;
 
-    pd = progress_dialogue_create(" Reading packets ", vector_size(cs->base.packet_ref));
+    pd = progress_dialogue_create(" Reading packets ", svector_size(cs->base.packet_ref));
     push_screen((screen *) pd);
     mx = getmaxx(((screen *) cs)->win) - 1;
-    for (int i = 0; i < vector_size(cs->base.packet_ref); i++) {
-        struct packet *p = vector_get(cs->base.packet_ref, i);
+    for (int i = 0; i < svector_size(cs->base.packet_ref); i++) {
+        struct packet *p = get_full_packet(svector_get(cs->base.packet_ref, i));
         unsigned char *payload = get_adu_payload(p);
         uint16_t len;
         int n;
@@ -505,7 +513,7 @@ static void buffer_tcppage(conversation_screen *cs, int (*buffer_fn)
         attr = calloc(1, sizeof(struct tcp_page_attr));
         attr->line = malloc(n + 1);
         strncpy(attr->line, buf, n + 1);
-        vector_push_back(tcp_page.buf, attr);
+        svector_push_back(tcp_page.buf, attr);
         n = len;
         while (n > 0) {
             int k;
@@ -513,7 +521,7 @@ static void buffer_tcppage(conversation_screen *cs, int (*buffer_fn)
             attr = malloc(sizeof(struct tcp_page_attr));
             k = buffer_fn(payload, n, attr, j, mx);
             attr->col = col;
-            vector_push_back(tcp_page.buf, attr);
+            svector_push_back(tcp_page.buf, attr);
             j += k;
             n -= k;
         }
@@ -572,8 +580,8 @@ static void print_tcppage(conversation_screen *cs)
     print_header(cs);
     werase(s->win);
     my = getmaxy(s->win);
-    while (i < my + tcp_page.top && i < vector_size(tcp_page.buf)) {
-        attr = vector_get(tcp_page.buf, i);
+    while (i < my + tcp_page.top && i < svector_size(tcp_page.buf)) {
+        attr = svector_get(tcp_page.buf, i);
         wattron(s->win, attr->col);
         waddstr(s->win, attr->line);
         wattroff(s->win, attr->col);
@@ -593,7 +601,7 @@ void add_packet(struct tcp_connection_v4 *conn, bool new_connection)
         return;
     cs = (conversation_screen *) screen_cache_get(CONVERSATION_SCREEN);
     if (cs->stream == conn) {
-        vector_push_back(cs->base.packet_ref, list_back(conn->packets));
+        svector_push_back(cs->base.packet_ref, list_back(conn->packets));
         if (tcp_mode == NORMAL)
             main_screen_print_packet((main_screen *) cs, list_back(conn->packets));
     }
@@ -615,8 +623,8 @@ void print_header(conversation_screen *cs)
     int x = 0;
 
     werase(cs->base.header);
-    for (int i = 0; i < vector_size(cs->base.packet_ref); i++) {
-        struct packet *p = vector_get(cs->base.packet_ref, i);
+    for (int i = 0; i < svector_size(cs->base.packet_ref); i++) {
+        struct packet *p = get_full_packet(svector_get(cs->base.packet_ref, i));
         uint16_t len = get_adu_payload_len(p);
 
         if (i == 0) {
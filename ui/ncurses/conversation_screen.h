@@ -11,4 +11,7 @@ typedef struct {
 conversation_screen *conversation_screen_create(void);
 void conversation_screen_free(screen *s);
 
+/* Set the TCP stream to show. The connection is kept until the screen is closed. */
+void conversation_screen_set_stream(conversation_screen *cs, struct tcp_connection_v4 *stream);
+
 #endif
@@ -84,10 +84,10 @@ void add_winhexdump(WINDOW *win, int y, int x, enum hexmode mode, struct packet
 
     args.type = HD_WINDOW;
     args.h_arg.win = win;
-    args.h_arg.p = p;
+    args.h_arg.p = get_full_packet(p);
     args.h_arg.y = y;
     args.h_arg.x = x;
-    print_hexdump(mode, p->buf, p->len, &args);
+    print_hexdump(mode, args.h_arg.p->buf, args.h_arg.p->len, &args);
 }
 
 void print_hexdump(enum hexmode mode, unsigned char *payload, uint16_t len, hd_args *arg)
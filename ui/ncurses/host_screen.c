@@ -116,6 +116,14 @@ void host_screen_lost_focus(screen *s UNUSED, screen *newscr UNUSED)
     host_analyzer_unsubscribe(update_host);
 }
 
+void host_screen_evict(host_screen *hs)
+{
+    /* the buffer is filled when the screen is rendered */
+    vector_clear(hs->screen_buf, NULL);
+    if (hs->base.focus)
+        host_screen_refresh((screen *) hs);
+}
+
 static unsigned int host_screen_get_size(screen *s)
 {
     return vector_size(((host_screen *) s)->screen_buf);
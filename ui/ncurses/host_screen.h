@@ -15,4 +15,7 @@ typedef struct {
 host_screen *host_screen_create();
 void host_screen_free(screen *s);
 
+/* Update the screen after hosts have been removed by the retention */
+void host_screen_evict(host_screen *hs);
+
 #endif
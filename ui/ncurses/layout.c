@@ -12,16 +12,17 @@
 #include "conversation_screen.h"
 #include "actionbar.h"
 #include "ui/ui.h"
-#include "vector.h"
+#include "svector.h"
 #include "stack.h"
 #include "monitor.h"
 #include "terminal.h"
+#include "retention.h"
 
 #define NUM_COLOURS 8
 #define COLOUR_IDX(f, b) ((b == -1) ? (f) + 1 : (b) + 1 + ((f) + 1) * NUM_COLOURS)
 
 extern void main_screen_refresh(screen *s);
-extern vector_t *packets;
+extern svector_t *packets;
 main_menu *menu;
 actionbar_t *actionbar;
 
@@ -163,6 +164,21 @@ static void layout_resize(void)
     s->resize = false;
 }
 
+/* Remove the packets that are no longer retained from the screens */
+static void evict_packets(uint32_t *num)
+{
+    screen *s;
+
+    if ((s = screen_cache_get(MAIN_SCREEN)))
+        main_screen_evict((main_screen *) s, *num);
+    if ((s = screen_cache_get(CONVERSATION_SCREEN)) && ((main_screen *) s)->packet_ref)
+        main_screen_evict((main_screen *) s, *num);
+    if ((s = screen_cache_get(CONNECTION_SCREEN)))
+        connection_screen_evict((connection_screen *) s);
+    if ((s = screen_cache_get(HOST_SCREEN)))
+        host_screen_evict((host_screen *) s);
+}
+
 static void ncurses_init(void)
 {
     initscr(); /* initialize curses mode */
@@ -179,6 +195,7 @@ static void ncurses_init(void)
     actionbar_add_default("F10", "Quit", false);
     create_screens();
     create_menu();
+    retention_subscribe(evict_packets);
 }
 
 static void ncurses_event(int event)
@@ -188,7 +205,7 @@ static void ncurses_event(int event)
     switch (event) {
     case UI_NEW_DATA:
         main_screen_print_packet((main_screen *) screen_cache[MAIN_SCREEN],
-                                 vector_back(packets));
+                                 svector_back(packets));
         break;
     case UI_ALARM:
         s = stack_top(screen_stack);
@@ -216,6 +233,7 @@ static void ncurses_event(int event)
 
 static void ncurses_end(void)
 {
+    retention_unsubscribe(evict_packets);
     screen_cache_clear();
     main_menu_free((screen *) menu);
     actionbar_free(actionbar);
@@ -8,8 +8,9 @@
 #include "list.h"
 #include "error.h"
 #include "monitor.h"
-#include "vector.h"
+#include "svector.h"
 #include "decoder/decoder.h"
+#include "decoder/summary.h"
 #include "stack.h"
 #include "file.h"
 #include "signal.h"
@@ -28,6 +29,9 @@
 #include "bpf/pcap_parser.h"
 #include "actionbar.h"
 #include "hash.h"
+#include "retention.h"
+#include "store.h"
+#include "compress.h"
 
 /* Get the y screen coordinate. The argument is the main_screen coordinate */
 #define GET_SCRY(y) ((y) + HEADER_HEIGHT)
@@ -40,7 +44,7 @@ enum input_mode {
     INPUT_FILTER
 };
 
-extern vector_t *packets;
+extern svector_t *packets;
 extern main_menu *menu;
 bool selected[NUM_LAYERS];
 int hexmode = HEXMODE_NORMAL;
@@ -100,7 +104,7 @@ static void add_actionbar_elems(screen *s)
     actionbar_add(s, "F3", "Start", ctx.capturing || geteuid() != 0);
     actionbar_add(s, "F4", "Stop", !ctx.capturing);
     actionbar_add(s, "F5", "Save", ctx.capturing ||
-                  vector_size(((main_screen *) s)->packet_ref) == 0);
+                  svector_size(((main_screen *) s)->packet_ref) == 0);
     actionbar_add(s, "F6", "Export", rbtree_size(((main_screen *) s)->marked) == 0);
     actionbar_add(s, "F7", "Load", ctx.capturing);
     actionbar_add(s, "F8", "View (dec)", false);
@@ -110,7 +114,7 @@ static void add_actionbar_elems(screen *s)
 
 static void screen_render(main_screen *ms, int my)
 {
-    if (!ms->base.show_selectionbar && ctx.capturing && vector_size(ms->packet_ref) > my) {
+    if (!ms->base.show_selectionbar && ctx.capturing && svector_size(ms->packet_ref) > my) {
         print_new_packets(ms);
     } else {
         if (ms->subwindow.top < 0 && abs(ms->subwindow.top) <= ms->subwindow.num_lines)
@@ -217,6 +221,50 @@ void main_screen_clear(main_screen *ms)
     werase(ms->base.win);
 }
 
+void main_screen_evict(main_screen *ms, uint32_t num)
+{
+    const rbtree_node_t *n;
+    rbtree_t *marked;
+    struct packet *p;
+    int k = 0;
+
+    while ((p = svector_get(ms->packet_ref, k)) && p->num <= num)
+        k++;
+    if (k == 0)
+        return;
+    if (ms->subwindow.win && (ms->main_line.line_number < k || ms->base.top < k)) {
+        delete_subwindow(ms, false);
+        ms->main_line.selected = false;
+        ms->main_line.line_number = -1;
+    } else if (ms->main_line.line_number >= 0) {
+        ms->main_line.line_number = MAX(ms->main_line.line_number - k, -1);
+    }
+
+    /* the packet vector itself is updated by the retention */
+    if (ms->packet_ref != packets)
+        svector_erase_front(ms->packet_ref, k, NULL);
+
+    /* the marked packets are keyed on their position */
+    marked = rbtree_init(compare_uint, NULL);
+    RBTREE_FOREACH(ms->marked, n) {
+        unsigned int i = PTR_TO_UINT(rbtree_get_key(n));
+
+        if (i > (unsigned int) k)
+            rbtree_insert(marked, UINT_TO_PTR(i - k), NULL);
+    }
+    rbtree_free(ms->marked);
+    ms->marked = marked;
+    ms->base.selectionbar = MAX(ms->base.selectionbar - k, 0);
+    if (ms->base.top < k) {
+        /* packets on the screen have been removed */
+        ms->base.top = 0;
+        if (ms->base.focus)
+            SCREEN_REFRESH((screen *) ms);
+    } else {
+        ms->base.top -= k;
+    }
+}
+
 void main_screen_refresh(screen *s)
 {
     int my;
@@ -245,7 +293,7 @@ void main_screen_refresh(screen *s)
             LV_RENDER(ms->lvw, ms->subwindow.win);
         else
             add_winhexdump(ms->subwindow.win, 0, 2, hexmode,
-                           vector_get(ms->packet_ref, ms->main_line.line_number));
+                           svector_get(ms->packet_ref, ms->main_line.line_number));
         if (inside_subwindow(ms))
             UPDATE_SELECTIONBAR(ms->subwindow.win, s->selectionbar - s->top -
                                 ms->subwindow.top, SELECTIONBAR);
@@ -276,13 +324,27 @@ void main_screen_refresh_pad(main_screen *ms)
     }
 }
 
+/*
+ * Return true if the packet, which is at index i in the summary, matches the
+ * filter. The filter is run on the summary if possible, so that the frame does
+ * not need to be read and decompressed.
+ */
+static bool match_filter(struct packet *p, uint32_t i)
+{
+    uint32_t res;
+
+    if (!summary_run_filter(bpf, i, &res))
+        res = bpf_run_filter(bpf, compress_frame(p), p->len);
+    return res != 0;
+}
+
 void main_screen_print_packet(main_screen *ms, struct packet *p)
 {
     char buf[MAXLINE];
 
     if (bpf.size > 0) {
-        if (bpf_run_filter(bpf, p->buf, p->len) != 0) {
-            vector_push_back(ms->packet_ref, p);
+        if (match_filter(p, summary_index(p->num))) {
+            svector_push_back(ms->packet_ref, p);
             write_to_buf(buf, MAXLINE, p);
             main_screen_update(ms, buf);
         }
@@ -321,7 +383,7 @@ static void create_export_dialogue(void)
 }
 
 static bool read_show_progress(iface_handle_t *handle, unsigned char *buffer, uint32_t n,
-                               struct timeval *t)
+                               uint32_t wirelen, struct timespec *t, uint32_t rxhash)
 {
     struct packet *p;
     main_screen *ms = (main_screen *) screen_cache_get(MAIN_SCREEN);
@@ -330,18 +392,22 @@ static bool read_show_progress(iface_handle_t *handle, unsigned char *buffer, ui
         return false;
     }
     p->time.tv_sec = t->tv_sec;
-    p->time.tv_usec = t->tv_usec;
+    p->time.tv_nsec = t->tv_nsec;
+    p->wirelen = wirelen;
+    p->rxhash = rxhash;
+    count_packet(p);
     if (p->perr != DECODE_ERR) {
         tcp_analyzer_check_stream(p);
         host_analyzer_investigate(p);
     }
     if (bpf.size > 0)  {
-        vector_push_back(packets, p);
-        if (bpf_run_filter(bpf, p->buf, p->len) != 0)
-            vector_push_back(ms->packet_ref, p);
+        svector_push_back(packets, p);
+        if (match_filter(p, summary_index(p->num)))
+            svector_push_back(ms->packet_ref, p);
     } else {
-        vector_push_back(ms->packet_ref, p);
+        svector_push_back(ms->packet_ref, p);
     }
+    compress_add(p);
     PROGRESS_DIALOGUE_UPDATE(pd, n);
     return true;
 }
@@ -368,10 +434,13 @@ void main_screen_load_handle_ok(void *file)
         if ((n = snprintf(title, MAXLINE, " Loading %s ", filename)) >= MAXLINE)
             string_truncate(title, MAXLINE, MAXLINE - 1);
         clear_statistics();
-        vector_clear(ms->packet_ref, NULL);
+        svector_clear(ms->packet_ref, NULL);
         if (bpf.size > 0)
-            vector_clear(packets, NULL);
+            svector_clear(packets, NULL);
         free_packets(NULL);
+        retention_clear();
+        store_clear();
+        compress_clear();
         lstat((const char *) file, buf);
         pd = progress_dialogue_create(title, buf->st_size);
         push_screen((screen *) pd);
@@ -417,7 +486,7 @@ void main_screen_load_handle_cancel(void *d UNUSED)
     }
 }
 
-void main_screen_save(vector_t *data, const char *file)
+void main_screen_save(svector_t *data, const char *file)
 {
     enum file_error err;
     FILE *fp;
@@ -443,14 +512,14 @@ void main_screen_save(vector_t *data, const char *file)
 void main_screen_export_handle_ok(void *file)
 {
     const rbtree_node_t *n;
-    vector_t *tmp;
+    svector_t *tmp;
     main_screen *ms = (main_screen *) screen_cache_get(MAIN_SCREEN);
 
-    tmp = vector_init(rbtree_size(ms->marked));
+    tmp = svector_init();
     RBTREE_FOREACH(ms->marked, n)
-        vector_push_back(tmp, vector_get(ms->packet_ref, PTR_TO_UINT(rbtree_get_key(n)) - 1));
+        svector_push_back(tmp, svector_get(ms->packet_ref, PTR_TO_UINT(rbtree_get_key(n)) - 1));
     main_screen_save(tmp, (const char *) file);
-    vector_free(tmp, NULL);
+    svector_free(tmp, NULL);
 }
 
 void main_screen_save_handle_ok(void *file)
@@ -509,7 +578,7 @@ void main_screen_get_input(screen *s)
         if (ms->subwindow.win) {
             struct packet *p;
 
-            p = vector_get(ms->packet_ref, ms->main_line.line_number);
+            p = svector_get(ms->packet_ref, ms->main_line.line_number);
             if (view_mode == HEXDUMP_VIEW) {
                 delete_subwindow(ms, true);
                 create_subwindow(ms, (hexmode == HEXMODE_NORMAL) ? p->len / 16 + 3 :
@@ -591,13 +660,13 @@ void main_screen_get_input(screen *s)
             stop_scan();
             actionbar_update(s, "F3", NULL, false);
             actionbar_update(s, "F4", NULL, true);
-            actionbar_update(s, "F5", NULL, !vector_size(ms->packet_ref));
+            actionbar_update(s, "F5", NULL, !svector_size(ms->packet_ref));
             actionbar_update(s, "F6", NULL, !rbtree_size(ms->marked));
             actionbar_update(s, "F7", NULL, false);
         }
         break;
     case KEY_F(5):
-        if (!ctx.capturing && vector_size(ms->packet_ref) > 0) {
+        if (!ctx.capturing && svector_size(ms->packet_ref) > 0) {
             create_save_dialogue();
         }
         break;
@@ -616,7 +685,7 @@ void main_screen_get_input(screen *s)
             struct packet *p;
 
             delete_subwindow(ms, true);
-            p = vector_get(ms->packet_ref, ms->main_line.line_number);
+            p = svector_get(ms->packet_ref, ms->main_line.line_number);
             if (view_mode == DECODED_VIEW) {
                 add_elements(ms, p);
                 create_subwindow(ms, ms->lvw->size + 1, ms->main_line.line_number);
@@ -683,6 +752,8 @@ void print_header(main_screen *ms)
     } else {
         mvprintat(ms->header, y, 0, txtcol, "Device");
         wprintw(ms->header, ": %s", ctx.device);
+        for (unsigned int i = 1; i < ctx.num_devices; i++)
+            wprintw(ms->header, ", %s", ctx.devices[i]);
     }
     mvprintat(ms->header, y, maxx / 2, txtcol, "Display filter");
     if (bpf.size != 0)
@@ -747,7 +818,7 @@ void main_screen_goto_line(main_screen *ms, int c)
         }
         wrefresh(status);
     } else if (num && (c == '\n' || c == KEY_ENTER)) {
-        if (num > ms->subwindow.num_lines + vector_size(ms->packet_ref))
+        if (num > ms->subwindow.num_lines + svector_size(ms->packet_ref))
             return;
 
         int my;
@@ -762,8 +833,8 @@ void main_screen_goto_line(main_screen *ms, int c)
         } else {
             if (ms->subwindow.win)
                 delete_subwindow(ms, false);
-            if (num + my - 1 > vector_size(ms->packet_ref)) {
-                ms->base.top = vector_size(ms->packet_ref) - my;
+            if (num + my - 1 > svector_size(ms->packet_ref)) {
+                ms->base.top = svector_size(ms->packet_ref) - my;
                 ms->base.selectionbar = num - 1;
             } else {
                 ms->base.selectionbar = ms->base.top = num - 1;
@@ -797,17 +868,17 @@ void main_screen_goto_end(main_screen *ms)
 {
     int my = getmaxy(ms->base.win);
 
-    if (vector_size(ms->packet_ref) >= my) {
+    if (svector_size(ms->packet_ref) >= my) {
         if (ms->subwindow.win) {
             int scroll;
 
-            scroll = vector_size(ms->packet_ref) - my - ms->base.top + ms->subwindow.num_lines;
-            ms->base.top = vector_size(ms->packet_ref) - my + ms->subwindow.num_lines;
-            ms->base.selectionbar = vector_size(ms->packet_ref) - 1 + ms->subwindow.num_lines;
+            scroll = svector_size(ms->packet_ref) - my - ms->base.top + ms->subwindow.num_lines;
+            ms->base.top = svector_size(ms->packet_ref) - my + ms->subwindow.num_lines;
+            ms->base.selectionbar = svector_size(ms->packet_ref) - 1 + ms->subwindow.num_lines;
             ms->subwindow.top -= scroll;
         } else {
-            ms->base.top = vector_size(ms->packet_ref) - my;
-            ms->base.selectionbar = vector_size(ms->packet_ref) - 1;
+            ms->base.top = svector_size(ms->packet_ref) - my;
+            ms->base.selectionbar = svector_size(ms->packet_ref) - 1;
         }
     }
     main_screen_refresh((screen *) ms);
@@ -844,12 +915,12 @@ void set_filter(main_screen *ms, int c)
             }
             if (bpf.size > 0) {
                 free(bpf.bytecode);
-                vector_free(ms->packet_ref, NULL);
+                svector_free(ms->packet_ref, NULL);
             }
             bpf = prog;
             strncpy(bpf_filter, filter, MAXLINE);
             filter_packets(ms);
-            if (vector_size(ms->packet_ref) == 0)
+            if (svector_size(ms->packet_ref) == 0)
                 ms->base.show_selectionbar = false;
         }
         input_mode = INPUT_NONE;
@@ -916,7 +987,7 @@ void clear_filter(main_screen *ms)
     if (bpf.size > 0) {
         free(bpf.bytecode);
         bpf.size = 0;
-        vector_free(ms->packet_ref, NULL);
+        svector_free(ms->packet_ref, NULL);
         ms->packet_ref = packets;
     }
     memset(bpf_filter, 0, sizeof(bpf_filter));
@@ -924,18 +995,25 @@ void clear_filter(main_screen *ms)
 
 void filter_packets(main_screen *ms)
 {
-    ms->packet_ref = vector_init(PACKET_TABLE_SIZE);
-    for (int i = 0; i < vector_size(packets); i++) {
-        struct packet *p = vector_get(packets, i);
+    uint32_t first;
+
+    ms->packet_ref = svector_init();
+    if (svector_size(packets) == 0)
+        return;
+
+    /* the packets are numbered consecutively, as are the rows of the summary */
+    first = summary_index(((struct packet *) svector_get(packets, 0))->num);
+    for (int i = 0; i < svector_size(packets); i++) {
+        struct packet *p = svector_get(packets, i);
 
-        if (bpf_run_filter(bpf, p->buf, p->len) != 0)
-            vector_push_back(ms->packet_ref, p);
+        if (match_filter(p, first + i))
+            svector_push_back(ms->packet_ref, p);
     }
 }
 
 void print_new_packets(main_screen *ms)
 {
-    int c = vector_size(ms->packet_ref) - 1;
+    int c = svector_size(ms->packet_ref) - 1;
     int my = getmaxy(ms->base.win);
 
     werase(ms->base.win);
@@ -945,7 +1023,7 @@ void print_new_packets(main_screen *ms)
         struct packet *p;
         char buffer[MAXLINE];
 
-        p = vector_get(ms->packet_ref, c);
+        p = svector_get(ms->packet_ref, c);
         write_to_buf(buffer, MAXLINE, p);
         mvprintnlw(ms->base.win, i, 0, ms->scrollx, buffer);
     }
@@ -959,7 +1037,7 @@ void print_new_packets(main_screen *ms)
  */
 static inline bool check_line(main_screen *ms)
 {
-    return ms->base.selectionbar < vector_size(ms->packet_ref) +
+    return ms->base.selectionbar < svector_size(ms->packet_ref) +
         ms->subwindow.num_lines - 1;
 }
 
@@ -1018,23 +1096,23 @@ void main_screen_scroll_page(main_screen *ms, int num_lines)
         main_screen_set_interactive(ms, true);
     }
     if (num_lines > 0) { /* scroll page down */
-        if (vector_size(ms->packet_ref) + ms->subwindow.num_lines <= num_lines) {
+        if (svector_size(ms->packet_ref) + ms->subwindow.num_lines <= num_lines) {
             if (ms->subwindow.win) {
-                ms->base.selectionbar = ms->subwindow.num_lines + vector_size(ms->packet_ref) - 1;
+                ms->base.selectionbar = ms->subwindow.num_lines + svector_size(ms->packet_ref) - 1;
             } else {
-                ms->base.selectionbar = vector_size(ms->packet_ref) - 1;
+                ms->base.selectionbar = svector_size(ms->packet_ref) - 1;
             }
             main_screen_refresh((screen *) ms);
         } else {
             int bottom = ms->base.top + num_lines - 1;
 
-            if (bottom + num_lines > vector_size(ms->packet_ref) - 1 + ms->subwindow.num_lines) {
-                int scroll = vector_size(ms->packet_ref) - bottom - 1 + ms->subwindow.num_lines;
+            if (bottom + num_lines > svector_size(ms->packet_ref) - 1 + ms->subwindow.num_lines) {
+                int scroll = svector_size(ms->packet_ref) - bottom - 1 + ms->subwindow.num_lines;
 
                 ms->base.top += scroll;
                 ms->base.selectionbar += num_lines;
-                if (ms->base.selectionbar >= vector_size(ms->packet_ref) + ms->subwindow.num_lines) {
-                    ms->base.selectionbar = vector_size(ms->packet_ref) - 1 + ms->subwindow.num_lines;
+                if (ms->base.selectionbar >= svector_size(ms->packet_ref) + ms->subwindow.num_lines) {
+                    ms->base.selectionbar = svector_size(ms->packet_ref) - 1 + ms->subwindow.num_lines;
                 }
                 if (ms->subwindow.win) {
                     refresh_pad(ms, &ms->subwindow, -scroll, ms->scrollx, false);
@@ -1050,7 +1128,7 @@ void main_screen_scroll_page(main_screen *ms, int num_lines)
             }
         }
     } else { /* scroll page up */
-        if (vector_size(ms->packet_ref) + ms->subwindow.num_lines <= abs(num_lines) || ms->base.top == 0) {
+        if (svector_size(ms->packet_ref) + ms->subwindow.num_lines <= abs(num_lines) || ms->base.top == 0) {
             ms->base.selectionbar = 0;
             main_screen_refresh((screen *) ms);
         } else {
@@ -1077,7 +1155,7 @@ void main_screen_scroll_page(main_screen *ms, int num_lines)
 
 void main_screen_set_interactive(main_screen *ms, bool interactive_mode)
 {
-    if (!vector_size(ms->packet_ref)) {
+    if (!svector_size(ms->packet_ref)) {
         ms->base.show_selectionbar = false;
         return;
     }
@@ -1111,7 +1189,7 @@ int print_lines(main_screen *ms, int from, int to, int y)
             y < ms->subwindow.top + ms->subwindow.num_lines) {
             y++;
         } else {
-            p = vector_get(ms->packet_ref, from);
+            p = svector_get(ms->packet_ref, from);
             if (!p) break;
             write_to_buf(buffer, MAXLINE, p);
             if (ms->scrollx) {
@@ -1188,7 +1266,7 @@ void print_selected_packet(main_screen *ms)
         ms->main_line.line_number = ms->base.selectionbar;
     }
     if (ms->main_line.selected) {
-        p = vector_get(ms->packet_ref, ms->base.selectionbar);
+        p = svector_get(ms->packet_ref, ms->base.selectionbar);
         if (view_mode == DECODED_VIEW) {
             add_elements(ms, p);
             if (ms->subwindow.win)
@@ -1219,6 +1297,7 @@ void add_elements(main_screen *ms, struct packet *p)
         free_list_view(ms->lvw);
     }
     ms->lvw = create_list_view();
+    p = get_full_packet(p);
     pdata = p->root;
 
     /* add packet headers as elements to the list view */
@@ -1286,11 +1365,11 @@ void delete_subwindow(main_screen *ms, bool refresh)
     if (refresh) {
         int my = getmaxy(ms->base.win);
 
-        if (ms->base.selectionbar >= vector_size(ms->packet_ref))
-            ms->base.selectionbar = vector_size(ms->packet_ref) - 1;
-        if (ms->base.top >= vector_size(ms->packet_ref) ||
+        if (ms->base.selectionbar >= svector_size(ms->packet_ref))
+            ms->base.selectionbar = svector_size(ms->packet_ref) - 1;
+        if (ms->base.top >= svector_size(ms->packet_ref) ||
             (subwindow_on_screen(ms) && ms->subwindow.top < 0)) {
-            if (vector_size(ms->packet_ref) < my)
+            if (svector_size(ms->packet_ref) < my)
                 ms->base.top = 0;
             else
                 ms->base.top = ms->main_line.line_number;
@@ -1352,8 +1431,7 @@ void refresh_pad(main_screen *ms, struct subwin_info *pad, int scrolly, int minx
 
 static void follow_tcp_stream(main_screen *ms)
 {
-    hashmap_t *connections = tcp_analyzer_get_sessions();
-    struct packet *p = vector_get(ms->packet_ref, ms->base.selectionbar);
+    struct packet *p = get_full_packet(svector_get(ms->packet_ref, ms->base.selectionbar));
     struct tcp_connection_v4 *stream;
     struct tcp_endpoint_v4 endp;
     conversation_screen *cs = (conversation_screen *) screen_cache_get(CONVERSATION_SCREEN);
@@ -1364,13 +1442,7 @@ static void follow_tcp_stream(main_screen *ms)
     endp.dst = ipv4_dst(p);
     endp.sport = tcp_member(p, sport);
     endp.dport = tcp_member(p, dport);
-    if (!(stream = hashmap_get(connections, &endp))) {
-        endp.src = ipv4_dst(p);
-        endp.dst = ipv4_src(p);
-        endp.sport = tcp_member(p, dport);
-        endp.dport = tcp_member(p, sport);
-        stream = hashmap_get(connections, &endp);
-    }
-    cs->stream = stream;
+    stream = tcp_analyzer_get_connection(&endp);
+    conversation_screen_set_stream(cs, stream);
     screen_stack_move_to_top((screen *) cs);
 }
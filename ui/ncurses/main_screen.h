@@ -3,7 +3,7 @@
 
 #include "list_view.h"
 #include "screen.h"
-#include "vector.h"
+#include "svector.h"
 #include "rbtree.h"
 
 typedef struct main_screen {
@@ -30,7 +30,7 @@ typedef struct main_screen {
     int scrolly;
 
     int scrollx; /* the amount scrolled on the x-axis */
-    vector_t *packet_ref;
+    svector_t *packet_ref;
     bool follow_stream;
     rbtree_t *marked;
 } main_screen;
@@ -43,6 +43,13 @@ void main_screen_free(screen *s);
 void main_screen_set_interactive(main_screen *ms, bool interactive_mode);
 void main_screen_print_packet(main_screen *ms, struct packet *p);
 
+/*
+ * Remove the packets with a number less than or equal to num from the screen.
+ * The packets are removed from the start of packet_ref, and the positions on
+ * the screen are adjusted accordingly.
+ */
+void main_screen_evict(main_screen *ms, uint32_t num);
+
 /* refresh the entire pad */
 void main_screen_refresh_pad(main_screen *ms);
 
@@ -463,7 +463,7 @@ void add_icmp6_information(void *w, void *sw, void *data)
         LV_ADD_TEXT_ELEMENT(lw, header, "Checksum: 0x%x", icmp6->checksum);
         LV_ADD_TEXT_ELEMENT(lw, header, "Identifier: 0x%x", icmp6->echo.id);
         LV_ADD_TEXT_ELEMENT(lw, header, "Sequence number: %d", icmp6->echo.seq);
-        for (unsigned int i = 0; i < icmp6->echo.len; i++)
+        for (unsigned int i = 0; icmp6->echo.data && i < icmp6->echo.len; i++)
             snprintf(buf + 2 * i, 1024 - 2 * i, "%02x", icmp6->echo.data[i]);
         break;
     case ND_ROUTER_SOLICIT:
@@ -898,15 +898,14 @@ void add_udp_information(void *w, void *sw, void *data)
 
 static void add_tcp_options(list_view *lw, list_view_header *header, struct tcp *tcp)
 {
-    list_t *options;
-    const node_t *n;
+    struct tcp_option_iterator it;
+    struct tcp_options option;
+    struct tcp_options *opt = &option;
     list_view_header *h;
 
-    options = parse_tcp_options(&tcp->options, (tcp->offset - 5) * 4);
+    tcp_options_begin(&it, tcp->options, (tcp->offset - 5) * 4);
     h = LV_ADD_SUB_HEADER(lw, header, selected[UI_SUBLAYER1], UI_SUBLAYER1, "Options");
-    n = list_begin(options);
-    while (n) {
-        struct tcp_options *opt = list_data(n);
+    while (tcp_options_next(&it, opt)) {
         list_view_header *w;
 
         switch (opt->option_kind) {
@@ -934,22 +933,15 @@ static void add_tcp_options(list_view *lw, list_view_header *header, struct tcp
             LV_ADD_TEXT_ELEMENT(lw, w, "Option length: %u", opt->option_length);
             break;
         case TCP_OPT_SACK:
-        {
-            const node_t *n = list_begin(opt->sack);
-
             w = LV_ADD_SUB_HEADER(lw, h, selected[UI_SUBLAYER2], UI_SUBLAYER2,
                                   "Selective Acknowledgement");
             LV_ADD_TEXT_ELEMENT(lw, w, "Option kind: %u", opt->option_kind);
             LV_ADD_TEXT_ELEMENT(lw, w, "Option length: %u", opt->option_length);
-            while (n) {
-                struct tcp_sack_block *block = list_data(n);
-
-                LV_ADD_TEXT_ELEMENT(lw, w, "Left edge: %u", block->left_edge);
-                LV_ADD_TEXT_ELEMENT(lw, w, "Right edge: %u", block->right_edge);
-                n = list_next(n);
+            for (int i = 0; i < opt->sack.num_blocks; i++) {
+                LV_ADD_TEXT_ELEMENT(lw, w, "Left edge: %u", opt->sack.blocks[i].left_edge);
+                LV_ADD_TEXT_ELEMENT(lw, w, "Right edge: %u", opt->sack.blocks[i].right_edge);
             }
             break;
-        }
         case TCP_OPT_TIMESTAMP:
             w = LV_ADD_SUB_HEADER(lw, h, selected[UI_SUBLAYER2], UI_SUBLAYER2, "Timestamp");
             LV_ADD_TEXT_ELEMENT(lw, w, "Option kind: %u", opt->option_kind);
@@ -973,9 +965,7 @@ static void add_tcp_options(list_view *lw, list_view_header *header, struct tcp
         default:
             break;
         }
-        n = list_next(n);
     }
-    free_tcp_options(options);
 }
 
 void add_tcp_information(void *w, void *sw, void *data)
@@ -1068,8 +1058,8 @@ static void add_dns_soa(list_view *lw, list_view_header *w, struct dns_info *dns
 
 static void add_dns_opt(list_view *lw, list_view_header *w, struct dns_info *dns, int i)
 {
-    list_t *opt;
-    const node_t *n;
+    struct dns_option_iterator it;
+    struct dns_opt_rr opt;
 
     if (!dns->record[i].name[0]) {
         LV_ADD_TEXT_ELEMENT(lw, w, "Name: <root domain>");
@@ -1082,22 +1072,18 @@ static void add_dns_opt(list_view *lw, list_view_header *w, struct dns_info *dns
                      GET_DNS_OPT_EXTENDED_RCODE(dns->record[i].ttl));
     LV_ADD_TEXT_ELEMENT(lw, w, "Version: 0x%x", GET_DNS_OPT_VERSION(dns->record[i].ttl));
     LV_ADD_TEXT_ELEMENT(lw, w, "D0 (DNSSEC OK bit): %u", GET_DNS_OPT_D0(dns->record[i].ttl));
-    opt = parse_dns_options(&dns->record[i]);
-    n = list_begin(opt);
-    while (n) {
+    dns_options_begin(&it, &dns->record[i]);
+    while (dns_options_next(&it, &opt)) {
         char buf[1024];
-        struct dns_opt_rr *opt_rr;
+        int len = MIN(opt.option_length, (int) (sizeof(buf) - 1) / 2);
 
-        opt_rr = (struct dns_opt_rr *) list_data(n);
-        for (int j = 0; j < opt_rr->option_length; j++) {
-            snprintf(buf + 2 * j, 1024 - 2 * j, "%02x", opt_rr->data[j]);
-        }
-        LV_ADD_TEXT_ELEMENT(lw, w, "Option code: %u", opt_rr->option_code);
-        LV_ADD_TEXT_ELEMENT(lw, w, "Option length: %u", opt_rr->option_length);
+        buf[0] = '\0';
+        for (int j = 0; j < len; j++)
+            snprintf(buf + 2 * j, sizeof(buf) - 2 * j, "%02x", opt.data[j]);
+        LV_ADD_TEXT_ELEMENT(lw, w, "Option code: %u", opt.option_code);
+        LV_ADD_TEXT_ELEMENT(lw, w, "Option length: %u", opt.option_length);
         LV_ADD_TEXT_ELEMENT(lw, w, "Data: %s", buf);
-        n = list_next(n);
     }
-    free_dns_options(opt);
 }
 
 static void add_dns_record(list_view *lw, list_view_header *w, struct dns_info *dns, int i, uint16_t type)
@@ -2095,8 +2081,10 @@ void add_tls_information(void *w, void *sw, void *data)
             add_tls_handshake(lw, record, tls->handshake);
             break;
         case TLS_APPLICATION_DATA:
-            sub = LV_ADD_SUB_HEADER(lw, record, selected[UI_SUBLAYER1], UI_SUBLAYER1, "Data");
-            add_hexdump(lw, sub, hexmode, tls->data, tls->length);
+            if (tls->data) {
+                sub = LV_ADD_SUB_HEADER(lw, record, selected[UI_SUBLAYER1], UI_SUBLAYER1, "Data");
+                add_hexdump(lw, sub, hexmode, tls->data, tls->length);
+            }
             break;
         default:
             break;
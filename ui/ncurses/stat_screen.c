@@ -6,18 +6,21 @@
 #include "layout.h"
 #include "interface.h"
 #include "decoder/decoder.h"
+#include "decoder/summary.h"
 #include "menu.h"
 #include "screen.h"
 #include "actionbar.h"
 #include "monitor.h"
 #include "system_information.h"
 #include "ringbuffer.h"
+#include "mempool.h"
+#include "retention.h"
 
 #define KIB 1024
 #define MIB (KIB * KIB)
 #define TX_RATE_X 78
-#define WIRELESS_Y 17
-#define PACKETS_Y 21
+#define WIRELESS_Y 20
+#define PACKETS_Y 24
 
 enum page {
     NET_STAT,
@@ -59,6 +62,7 @@ static bool wireless;
 static void calculate_rate(void);
 static void print_netstat(screen *s);
 static void print_hwstat(screen *s);
+static void print_mempool_stat(screen *s, int y);
 static void stat_screen_free(screen *s);
 static void stat_screen_init(screen *s);
 static void stat_screen_get_input(screen *s);
@@ -281,6 +285,44 @@ static void print_graph(screen *s, int col, ringbuffer_t *rate, int y, int x, ch
     mvwprintw(s->win, ++ry, m, "%s", buf);
 }
 
+/* Kernel counters, ring buffer occupancy and backlog drops of the capture */
+static void print_capture_stat(screen *s, int col, int y)
+{
+    mvprintat(s->win, y, 2, col, "%13s", "Received");
+    wprintw(s->win, ": %10" PRIu64, ctx.stat.packets);
+    printat(s->win, col, "%15s", "Dropped");
+    wprintw(s->win, ": %10" PRIu64, ctx.stat.drops);
+    printat(s->win, col, "%15s", "Queue freezes");
+    wprintw(s->win, ": %8" PRIu64, ctx.stat.freeze_q);
+    if (ctx.stat.ring_size) {
+        mvprintat(s->win, ++y, 2, col, "%13s", "Ring fill");
+        wprintw(s->win, ": %3u%% (%u/%u)", ctx.stat.ring_fill * 100 / ctx.stat.ring_size,
+                ctx.stat.ring_fill, ctx.stat.ring_size);
+        mvprintat(s->win, y, 32, col, "%13s", "Lost blocks");
+        wprintw(s->win, ": %10" PRIu64, ctx.stat.lost_blocks);
+        printat(s->win, col, "%15s", "Backlog drops");
+    } else {
+        mvprintat(s->win, ++y, 2, col, "%13s", "Backlog drops");
+    }
+    wprintw(s->win, ": %8" PRIu64, ctx.stat.backlog_drops);
+}
+
+/* The packets that have not been evicted, summed over the packet summary */
+static void print_stored_stat(screen *s, int col, int y)
+{
+    uint64_t bytes = 0;
+    char buf[16];
+
+    for (uint32_t i = 0; i < summary.size; i++)
+        bytes += summary.len[i];
+    mvprintat(s->win, y, 5, col, "%10s", "Stored");
+    wprintw(s->win, ": %8u", summary.size);
+    if (formatted_output)
+        wprintw(s->win, "%14s", format_bytes(bytes, buf, 16));
+    else
+        wprintw(s->win, "%14" PRIu64, bytes);
+}
+
 static void print_packet_stat(screen *s, int col, int y)
 {
     char buf[16];
@@ -294,6 +336,8 @@ static void print_packet_stat(screen *s, int col, int y)
             wprintw(s->win, "%14s", format_bytes(total_bytes, buf, 16));
         else
             wprintw(s->win, "%14" PRIu64, total_bytes);
+        if (retention_enabled())
+            print_stored_stat(s, col, ++y);
         traverse_protocols(print_protocol_stat, &y);
     }
 }
@@ -338,6 +382,8 @@ void print_netstat(screen *s)
         print_rate(s, &tx);
         print_graph(s, subcol, tx_rate, y, TX_RATE_X, "%4d packets/s", tx.pps);
         y += 15;
+        print_capture_stat(s, subcol, ++y);
+        y += 2;
         if (wireless && get_iwstat(ctx.device, &stat)) {
             mvprintat(s->win, ++y, 2, subcol, "%13s", "Link quality");
             wprintw(s->win, ": %8u/%u", stat.qual, stat.max_qual);
@@ -383,6 +429,8 @@ void print_hwstat(screen *s)
     wprintw(s->win, ":  %s", format_bytes(mem.proc.vm_rss * 1024, buf, ARRAY_SIZE(buf)));
     mvprintat(s->win, y++, 29, subcol, "Virtual memory size");
     wprintw(s->win, ":  %s", format_bytes(mem.proc.vm_size * 1024, buf, ARRAY_SIZE(buf)));
+    print_mempool_stat(s, y);
+    y += NUM_POOLS + 2;
     if (cpustat[0][0].idle != 0 && cpustat[1][0].idle != 0) {
         int cx, cy;
         unsigned int load;
@@ -414,6 +462,30 @@ void print_hwstat(screen *s)
     doupdate();
 }
 
+void print_mempool_stat(screen *s, int y)
+{
+    static const char *names[NUM_POOLS] = {
+        [POOL_PERM] = "Long-lived",
+        [POOL_SHORT] = "Temporary",
+        [POOL_FRAME] = "Frames"
+    };
+    int subcol = get_theme_colour(SUBHEADER_TXT);
+    struct mempool_stat stat;
+    char buf[16];
+
+    y += 2;
+    mvprintat(s->win, y, 0, subcol, "%18s %10s %10s %10s %10s", "Memory pools",
+              "Used", "Reserved", "Chunks", "Huge");
+    for (int i = 0; i < NUM_POOLS; i++) {
+        mempool_stat(i, &stat);
+        mvprintat(s->win, ++y, 0, subcol, "%18s", names[i]);
+        wprintw(s->win, " %10s", format_bytes(stat.used, buf, ARRAY_SIZE(buf)));
+        wprintw(s->win, " %10s", format_bytes(stat.reserved, buf, ARRAY_SIZE(buf)));
+        wprintw(s->win, " %10zu %10zu", stat.chunks, stat.huge_chunks);
+    }
+    mvprintat(s->win, ++y, 0, subcol, "%18s Used does not include the chunks being filled", "");
+}
+
 void calculate_rate(void)
 {
     if (!rx.prev_bytes && !tx.prev_bytes) {
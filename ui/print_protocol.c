@@ -18,9 +18,10 @@
 #include "string.h"
 #include "misc.h"
 #include "decoder/host_analyzer.h"
+#include "decoder/summary.h"
 
 #define HOSTNAMELEN 255 /* maximum 255 according to rfc1035 */
-#define TBUFLEN 16
+#define TBUFLEN 32
 
 #define STR_HELPER(x) #x
 #define STR(x) STR_HELPER(x)
@@ -43,35 +44,35 @@
         PRINT_INFO(buffer, n, fmt, ## __VA_ARGS__);             \
     } while (0)
 
-static void print_error(char *buf, int size, struct packet *p);
+static void print_error(char *buf, int size, struct packet *p, char *time);
 
+/* The time is read from the packet summary, the rest from the decoded data */
 void write_to_buf(char *buf, int size, struct packet *p)
 {
     struct protocol_info *pinfo = NULL;
+    uint32_t i = summary_index(p->num);
+    char time[TBUFLEN];
 
+    /* a packet that is no longer stored is not in the summary */
+    format_timespec(i < summary.size ? &summary.time[i] : &p->time, time, TBUFLEN);
+    p = get_full_packet(p);
     if (p->root->next)
         pinfo = get_protocol(p->root->next->id);
     if (pinfo && p->root->next->data) {
-        char time[TBUFLEN];
-        struct timeval t = p->time;
-
-        format_timeval(&t, time, TBUFLEN);
         PRINT_NUMBER(buf, size, p->num);
         PRINT_TIME(buf, size, time);
         pinfo->print_pdu(buf, size, p);
     } else if (p->len - ETHER_HDR_LEN)
-        print_error(buf, size, p);
+        print_error(buf, size, p, time);
 }
 
-static void print_error(char *buf, int size, struct packet *p)
+static void print_error(char *buf, int size, struct packet *p, char *time)
 {
     char smac[HW_ADDRSTRLEN];
     char dmac[HW_ADDRSTRLEN];
-    char time[TBUFLEN];
 
     HW_ADDR_NTOP(smac, eth_src(p));
     HW_ADDR_NTOP(dmac, eth_dst(p));
-    format_timeval(&p->time, time, TBUFLEN);
     if (p->perr != NO_ERR && p->perr != UNK_PROTOCOL) {
         PRINT_LINE(buf, size, p->num, time, smac, dmac,
                    "ETH II", "Ethertype: 0x%x [decode error]", ethertype(p));
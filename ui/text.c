@@ -1,17 +1,23 @@
 #include <stdio.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include "ui.h"
 #include "print_protocol.h"
 #include "monitor.h"
-#include "vector.h"
+#include "svector.h"
 #include "decoder/packet.h"
 
-extern vector_t *packets;
+extern svector_t *packets;
 
+static void text_init(void);
+static void text_fini(void);
 static void text_draw(void);
 static void text_event(int);
 
 static struct ui text_ui = {
     .name = "text",
+    .init = text_init,
+    .fini = text_fini,
     .draw = text_draw,
     .event = text_event
 };
@@ -21,13 +27,40 @@ CONSTRUCTOR static void text_register(void)
     ui_register(&text_ui, false);
 }
 
+/* Print the capture statistics every second if requested */
+void text_init(void)
+{
+    if (ctx.opt.show_statistics && ctx.capturing)
+        alarm(1);
+}
+
+void text_fini(void)
+{
+    if (ctx.opt.load_file)
+        return;
+    fprintf(stderr, "%" PRIu64 " packets received by the kernel, %" PRIu64 " dropped\n",
+            ctx.stat.packets, ctx.stat.drops);
+    if (ctx.stat.backlog_drops)
+        fprintf(stderr, "%" PRIu64 " packets dropped as they could not be processed in time\n",
+                ctx.stat.backlog_drops);
+    if (ctx.stat.ring_size)
+        fprintf(stderr, "%" PRIu64 " queue freezes, %" PRIu64 " ring blocks with packet loss\n",
+                ctx.stat.freeze_q, ctx.stat.lost_blocks);
+}
+
 void text_event(int event)
 {
-    if (event == UI_NEW_DATA) {
+    if (event == UI_ALARM) {
+        fprintf(stderr, "Received: %" PRIu64 "  Dropped: %" PRIu64 "  Backlog drops: %"
+                PRIu64 "  Queue freezes: %" PRIu64 "  Lost blocks: %" PRIu64
+                "  Ring: %u/%u blocks\n",
+                ctx.stat.packets, ctx.stat.drops, ctx.stat.backlog_drops, ctx.stat.freeze_q,
+                ctx.stat.lost_blocks, ctx.stat.ring_fill, ctx.stat.ring_size);
+    } else if (event == UI_NEW_DATA) {
         char buf[MAXLINE];
         struct packet *p;
 
-        p = vector_back(packets);
+        p = svector_back(packets);
         write_to_buf(buf, MAXLINE, p);
         printf("%s\n", buf);
     }
@@ -35,10 +68,10 @@ void text_event(int event)
 
 void text_draw(void)
 {
-    for (int i = 0; i < vector_size(packets); i++) {
+    for (int i = 0; i < svector_size(packets); i++) {
         char buf[MAXLINE];
 
-        write_to_buf(buf, MAXLINE, vector_get(packets, i));
+        write_to_buf(buf, MAXLINE, svector_get(packets, i));
         printf("%s\n", buf);
     }
     finish(0);
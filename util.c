@@ -57,7 +57,7 @@ char *format_timeval(struct timeval *t, char *buf, int n)
 
     time = localtime(&t->tv_sec);
     strftime(buf, n, "%T", time);
-    snprintcat(buf, n, ".%ld", t->tv_usec);
+    snprintcat(buf, n, ".%06ld", (long) t->tv_usec);
     return buf;
 }
 
@@ -66,7 +66,8 @@ char *format_timespec(struct timespec *t, char *buf, int n)
     struct tm *time;
 
     time = localtime(&t->tv_sec);
-    strftime(buf, n - 1, "%T", time);
+    strftime(buf, n, "%T", time);
+    snprintcat(buf, n, ".%09ld", t->tv_nsec);
     return buf;
 }
 
@@ -30,6 +30,10 @@
 #define MAX(a, b) ({ typeof(a) _a = (a), _b = (b); _a > _b ? _a : _b; })
 #endif
 
+#ifndef MIN
+#define MIN(a, b) ({ typeof(a) _a = (a), _b = (b); _a < _b ? _a : _b; })
+#endif
+
 struct timeval;
 struct timespec;
 
@@ -58,10 +62,16 @@ struct tm_t get_time(uint32_t num_secs);
  */
 void time_ntop(struct tm_t *time, char *result, int len);
 
-/* TODO: format should be made configurable */
+/*
+ * Format the time of day with microsecond resolution, e.g. 12:01:59.000123
+ * TODO: format should be made configurable
+ */
 char *format_timeval(struct timeval *t, char *buf, int n);
 
-/* TODO: format should be made configurable */
+/*
+ * Format the time of day with nanosecond resolution, e.g. 12:01:59.000123456
+ * TODO: format should be made configurable
+ */
 char *format_timespec(struct timespec *t, char *buf, int n);
 
 /*
@@ -187,5 +197,16 @@ static inline unsigned int clp2(unsigned int x)
     return x + 1;
 }
 
+/* Computes the greatest power of two less than or equal to x, or 0 if x is 0 */
+static inline unsigned int flp2(unsigned int x)
+{
+    x = x | (x >> 1);
+    x = x | (x >> 2);
+    x = x | (x >> 4);
+    x = x | (x >> 8);
+    x = x | (x >> 16);
+    return x - (x >> 1);
+}
+
 
 #endif
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include "vector.h"
 
 #define FACTOR 1.5
@@ -7,8 +8,14 @@ typedef struct item {
     void *data;
 } item_t;
 
+/*
+ * The elements are stored in buf[base, c). Removing elements from the front
+ * only advances base, and the space in front of base is reclaimed when the
+ * buffer is full.
+ */
 struct vector {
     item_t *buf;
+    unsigned int base;
     unsigned int c;
     unsigned int size;
     vector_deallocate func;
@@ -20,6 +27,7 @@ vector_t *vector_init(int sz)
 
     vector = malloc(sizeof(vector_t));
     vector->size = sz;
+    vector->base = 0;
     vector->c = 0;
     vector->buf = (item_t *) malloc(vector->size * sizeof(struct item));
 
@@ -31,16 +39,22 @@ void vector_push_back(vector_t *vector, void *data)
     if (vector->c >= vector->size) {
         item_t *newbuf;
 
-        newbuf = (item_t *) realloc(vector->buf, vector->size * sizeof(struct item) * FACTOR);
-        vector->buf = newbuf;
-        vector->size = vector->size * FACTOR;
+        if (vector->base > 0 && vector->base >= vector->size / 2) {
+            vector->c -= vector->base;
+            memmove(vector->buf, vector->buf + vector->base, vector->c * sizeof(struct item));
+            vector->base = 0;
+        } else {
+            newbuf = (item_t *) realloc(vector->buf, vector->size * sizeof(struct item) * FACTOR);
+            vector->buf = newbuf;
+            vector->size = vector->size * FACTOR;
+        }
     }
     vector->buf[vector->c++].data = data;
 }
 
 void vector_pop_back(vector_t *vector, vector_deallocate func)
 {
-    if (vector->c) {
+    if (vector->c > vector->base) {
         if (func) {
             func(vector->buf[vector->c - 1].data);
         }
@@ -48,9 +62,23 @@ void vector_pop_back(vector_t *vector, vector_deallocate func)
     }
 }
 
+void vector_erase_front(vector_t *vector, int n, vector_deallocate func)
+{
+    if ((unsigned int) n > vector->c - vector->base)
+        n = vector->c - vector->base;
+    if (func) {
+        for (unsigned int i = vector->base; i < vector->base + n; i++) {
+            func(vector->buf[i].data);
+        }
+    }
+    vector->base += n;
+    if (vector->base == vector->c)
+        vector->base = vector->c = 0;
+}
+
 void *vector_back(vector_t *vector)
 {
-    if (vector->c) {
+    if (vector->c > vector->base) {
         return vector->buf[vector->c - 1].data;
     }
     return NULL;
@@ -58,29 +86,30 @@ void *vector_back(vector_t *vector)
 
 void *vector_get(vector_t *vector, int i)
 {
-    if ((unsigned int) i < vector->c) {
-        return vector->buf[i].data;
+    if ((unsigned int) i < vector->c - vector->base) {
+        return vector->buf[vector->base + i].data;
     }
     return NULL;
 }
 
 int vector_size(vector_t *vector)
 {
-    return vector->c;
+    return vector->c - vector->base;
 }
 
 void *vector_data(vector_t *vector)
 {
-    return (void *) vector->buf;
+    return (void *) (vector->buf + vector->base);
 }
 
 void vector_clear(vector_t *vector, vector_deallocate func)
 {
     if (func) {
-        for (unsigned int i = 0; i < vector->c; i++) {
+        for (unsigned int i = vector->base; i < vector->c; i++) {
             func(vector->buf[i].data);
         }
     }
+    vector->base = 0;
     vector->c = 0;
 }
 
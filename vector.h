@@ -13,6 +13,12 @@ void vector_push_back(vector_t *vector, void *data);
 /* Remove element at the end. Total capacity will not be reduced */
 void vector_pop_back(vector_t *vector, vector_deallocate func);
 
+/*
+ * Remove the first n elements. The remaining elements are not moved, so this
+ * is a constant time operation when func is NULL.
+ */
+void vector_erase_front(vector_t *vector, int n, vector_deallocate func);
+
 /* get data from end of vector */
 void *vector_back(vector_t *vector);
 